@@ -0,0 +1,92 @@
+#ifndef AFFINE_H_
+#define AFFINE_H_
+
+#include <math.h>
+
+#include "geometry.h"
+
+// 2D affine map p' = [a b; c d] p + [tx ty].
+struct affine {
+    grid_point apply(const grid_point& p) const {
+        grid_point r;
+        r.x = a * p.x + b * p.y + tx;
+        r.y = c * p.x + d * p.y + ty;
+        return r;
+    }
+
+    // This map followed by next.
+    affine then(const affine& next) const {
+        affine r;
+        r.a = next.a * a + next.b * c;
+        r.b = next.a * b + next.b * d;
+        r.c = next.c * a + next.d * c;
+        r.d = next.c * b + next.d * d;
+        r.tx = next.a * tx + next.b * ty + next.tx;
+        r.ty = next.c * tx + next.d * ty + next.ty;
+        return r;
+    }
+
+    double det() const { return a * d - b * c; }
+
+    // The map undoing this one; det() must not be 0.
+    affine inverse() const {
+        double s = 1.0 / det();
+        affine r;
+        r.a = d * s;
+        r.b = -b * s;
+        r.c = -c * s;
+        r.d = a * s;
+        r.tx = -(r.a * tx + r.b * ty);
+        r.ty = -(r.c * tx + r.d * ty);
+        return r;
+    }
+
+    bool operator==(const affine& o) const {
+        return a == o.a && b == o.b && c == o.c && d == o.d && tx == o.tx && ty == o.ty;
+    }
+
+    bool is_identity() const {
+        return a == 1.0 && b == 0.0 && c == 0.0 && d == 1.0 && tx == 0.0 && ty == 0.0;
+    }
+
+    double a, b, c, d;
+    double tx, ty;
+};
+
+inline affine affine_identity() {
+    affine t = { 1.0, 0.0, 0.0, 1.0, 0.0, 0.0 };
+    return t;
+}
+
+inline affine affine_translate(double dx, double dy) {
+    affine t = { 1.0, 0.0, 0.0, 1.0, dx, dy };
+    return t;
+}
+
+// Rotation by angle radians around center.
+inline affine affine_rotate(const grid_point& center, double angle) {
+    double cs = cos(angle);
+    double sn = sin(angle);
+    affine t = {
+        cs, -sn, sn, cs,
+        center.x - cs * center.x + sn * center.y,
+        center.y - sn * center.x - cs * center.y
+    };
+    return t;
+}
+
+// Mirror x values around center.x and/or y values around center.y.
+inline affine affine_mirror(const grid_point& center, bool mirror_x, bool mirror_y) {
+    affine t = affine_identity();
+    if (mirror_x) {
+        t.a = -1.0;
+        t.tx = 2.0 * center.x;
+    }
+    if (mirror_y) {
+        t.d = -1.0;
+        t.ty = 2.0 * center.y;
+    }
+    return t;
+}
+
+#endif // AFFINE_H_
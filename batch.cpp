@@ -0,0 +1,467 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "batch.h"
+#include "document.h"
+#include "raster.h"
+#include "shape_export.h"
+#include "thread_pool.h"
+#include "thumbnail.h"
+
+enum batch_op_kind {
+    BATCH_CENTER,
+    BATCH_SIMPLIFY,
+    BATCH_REDUCE,
+    BATCH_QUANTIZE,
+    BATCH_WINDING,
+    BATCH_CONVEX,
+    BATCH_EXPORT,
+    BATCH_HEADER,
+    BATCH_JSON,
+    BATCH_BINARY
+};
+
+struct batch_op {
+    batch_op_kind kind;
+    double value;
+};
+
+struct batch_totals {
+    int shapes;
+    long long vertices;
+    int pieces;
+    double convex_ms;
+};
+
+struct batch_options {
+    std::string out_dir;
+    std::vector<batch_op> ops;
+    int threads;
+    int thumbnail_size;     // 0 for no thumbnails
+    int sheet_columns;      // 0 for no contact sheets
+    bool png;
+    std::vector<const char*> files;
+    std::vector<std::string> names;     // output name of every file, unique
+};
+
+static void batch_usage() {
+
+    fprintf(stderr,
+        "usage: polyd --batch -o DIR [-p OPS] [-j THREADS] [-t SIZE] [-s COLUMNS] [-f FORMAT] FILE...\n"
+        "  -o DIR      output directory, created if missing\n"
+        "  -p OPS      comma separated pipeline, applied in order to every shape\n"
+        "              (default center,winding):\n"
+        "                center        move the centroid to the origin\n"
+        "                simplify[=T]  drop vertices within T of the outline\n"
+        "                              (Douglas-Peucker, default 0.01)\n"
+        "                reduce=N      keep at most N vertices (Visvalingam)\n"
+        "                quantize[=F]  round coordinates to 1/F (default 100)\n"
+        "                winding       make outlines counter-clockwise\n"
+        "                convex[=N]    write DIR/NAME.convex.txt with convex pieces\n"
+        "                              of at most N vertices (default 8)\n"
+        "                export        write DIR/NAME.txt with the shape listings and\n"
+        "                              their mass properties and hulls\n"
+        "                header[=D]    write DIR/NAME.h, constexpr arrays of the outlines\n"
+        "                              with area, centroid, bounds and triangles\n"
+        "                              precomputed, coordinates rounded to D decimals\n"
+        "                              (default 6)\n"
+        "                json[=D]      the same as DIR/NAME.json\n"
+        "                binary[=D]    the same as DIR/NAME.bin, float32 little-endian\n"
+        "  -j THREADS  worker threads, 0 for one per core (default 0)\n"
+        "  -t SIZE     write DIR/NAME-NNNN.FORMAT, a SIZE pixel thumbnail of every\n"
+        "              shape after the pipeline\n"
+        "  -s COLUMNS  write DIR/NAME.sheet-NN.FORMAT, contact sheets of COLUMNS by\n"
+        "              COLUMNS thumbnails (SIZE pixels, default 128)\n"
+        "  -f FORMAT   png or ppm (default png)\n"
+        "Each FILE is a shape library, or a legacy .poly file holding one shape,\n"
+        "and is written to DIR/NAME.polylib. NAME is the file name without its\n"
+        "extension; files with the same name get -2, -3 and so on appended.\n");
+}
+
+static bool parse_ops(const char* text, std::vector<batch_op>& ops) {
+
+    ops.clear();
+    std::string list(text);
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        size_t end = list.find(',', begin);
+        if (end == std::string::npos) end = list.size();
+        std::string name = list.substr(begin, end - begin);
+        begin = end + 1;
+
+        std::string arg;
+        size_t eq = name.find('=');
+        if (eq != std::string::npos) {
+            arg = name.substr(eq + 1);
+            name.erase(eq);
+        }
+
+        batch_op op;
+        op.value = 0.0;
+        bool takes_value = false;
+        if (name == "center") {
+            op.kind = BATCH_CENTER;
+        } else if (name == "simplify") {
+            op.kind = BATCH_SIMPLIFY;
+            op.value = arg.empty() ? 0.01 : atof(arg.c_str());
+            takes_value = true;
+        } else if (name == "reduce") {
+            op.kind = BATCH_REDUCE;
+            op.value = atoi(arg.c_str());
+            takes_value = true;
+        } else if (name == "quantize") {
+            op.kind = BATCH_QUANTIZE;
+            op.value = arg.empty() ? 100.0 : atof(arg.c_str());
+            takes_value = true;
+        } else if (name == "winding") {
+            op.kind = BATCH_WINDING;
+        } else if (name == "convex") {
+            op.kind = BATCH_CONVEX;
+            op.value = arg.empty() ? 8 : atoi(arg.c_str());
+            takes_value = true;
+        } else if (name == "export") {
+            op.kind = BATCH_EXPORT;
+        } else if (name == "header" || name == "json" || name == "binary") {
+            op.kind = name == "header" ? BATCH_HEADER : name == "json" ? BATCH_JSON : BATCH_BINARY;
+            op.value = arg.empty() ? EXPORT_DIGITS : atoi(arg.c_str());
+            takes_value = true;
+        } else {
+            fprintf(stderr, "Unknown operation '%s'\n", name.c_str());
+            return false;
+        }
+        if (!takes_value && !arg.empty()) {
+            fprintf(stderr, "%s takes no value\n", name.c_str());
+            return false;
+        }
+        if (takes_value && op.value <= 0.0) {
+            fprintf(stderr, "%s needs a positive value\n", name.c_str());
+            return false;
+        }
+        ops.push_back(op);
+    }
+    return true;
+}
+
+static bool parse_options(int argc, char** argv, batch_options& options) {
+
+    options.threads = 0;
+    options.thumbnail_size = 0;
+    options.sheet_columns = 0;
+    options.png = true;
+    parse_ops("center,winding", options.ops);
+
+    for (int i=1; i<argc; ++i) {
+        const char* arg = argv[i];
+        bool has_value = (i + 1 < argc);
+        if (strcmp(arg, "-o") == 0 && has_value) {
+            options.out_dir = argv[++i];
+        } else if (strcmp(arg, "-p") == 0 && has_value) {
+            if (!parse_ops(argv[++i], options.ops)) return false;
+        } else if (strcmp(arg, "-j") == 0 && has_value) {
+            options.threads = atoi(argv[++i]);
+        } else if (strcmp(arg, "-t") == 0 && has_value) {
+            options.thumbnail_size = atoi(argv[++i]);
+            if (options.thumbnail_size <= 0) return false;
+        } else if (strcmp(arg, "-s") == 0 && has_value) {
+            options.sheet_columns = atoi(argv[++i]);
+            if (options.sheet_columns <= 0) return false;
+        } else if (strcmp(arg, "-f") == 0 && has_value) {
+            const char* format = argv[++i];
+            if (strcmp(format, "png") != 0 && strcmp(format, "ppm") != 0) return false;
+            options.png = (strcmp(format, "png") == 0);
+        } else if (arg[0] == '-') {
+            return false;
+        } else {
+            options.files.push_back(arg);
+        }
+    }
+    return !options.out_dir.empty() && !options.files.empty();
+}
+
+static bool has_suffix(const char* text, const char* suffix) {
+
+    size_t n = strlen(text);
+    size_t m = strlen(suffix);
+    return n >= m && strcmp(text + n - m, suffix) == 0;
+}
+
+// File name without directory and extension.
+static std::string file_stem(const char* path) {
+
+    const char* name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    const char* dot = strrchr(name, '.');
+    return dot && dot != name ? std::string(name, dot) : std::string(name);
+}
+
+// Gives every file its output name. Files are processed concurrently, so
+// two files named alike in different directories must not share outputs.
+static void assign_names(batch_options& options) {
+
+    std::set<std::string> used;
+    options.names.clear();
+    for (size_t i=0; i<options.files.size(); ++i) {
+        std::string stem = file_stem(options.files[i]);
+        std::string name = stem;
+        for (int n=2; !used.insert(name).second; ++n) {
+            char suffix[32];
+            snprintf(suffix, sizeof(suffix), "-%d", n);
+            name = stem + suffix;
+        }
+        options.names.push_back(name);
+    }
+}
+
+static double now_ms() {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+// Shape listings with their mass properties, or with convex_limit set,
+// the convex pieces of every shape.
+static bool write_export(const document& doc, const std::string& path, int convex_limit, batch_totals* totals) {
+
+    std::string temp_path = path + ".tmp";
+    FILE *fSave = fopen(temp_path.c_str(), "w");
+    if (fSave == 0) return false;
+
+    convex_pieces pieces;
+    shape_properties properties;
+    for (int k=0; k<doc.shapes.shape_count(); ++k) {
+        if (convex_limit == 0) {
+            doc.export_shape(k, fSave);
+            doc.export_properties(k, properties.mass(doc.shapes, k), properties.hull(doc.shapes, k), fSave);
+            continue;
+        }
+        double start = now_ms();
+        doc.decompose(k, convex_limit, pieces);
+        totals->convex_ms += now_ms() - start;
+        totals->pieces += pieces.count();
+        doc.export_pieces(k, pieces, fSave);
+    }
+    bool ok = (ferror(fSave) == 0);
+    ok = (fclose(fSave) == 0) && ok;
+
+    if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+        remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+static bool process_file(const batch_options& options, const char* path, const std::string& stem,
+                         document& doc, batch_totals* totals) {
+
+    bool loaded = has_suffix(path, ".poly") ? doc.import_legacy(path, 0) : doc.load_library(path);
+    if (!loaded) {
+        fprintf(stderr, "%s: could not read\n", path);
+        return false;
+    }
+
+    std::string out = options.out_dir + "/" + stem;
+    int count = doc.shapes.shape_count();
+    for (size_t i=0; i<options.ops.size(); ++i) {
+        const batch_op& op = options.ops[i];
+        if (op.kind == BATCH_EXPORT || op.kind == BATCH_CONVEX) {
+            // Pieces are indices into the committed outlines.
+            for (int k=0; k<count; ++k) {
+                doc.shapes.apply_transform(k);
+            }
+            bool convex = (op.kind == BATCH_CONVEX);
+            std::string name = out + (convex ? ".convex.txt" : ".txt");
+            if (!write_export(doc, name, convex ? static_cast<int>(op.value) : 0, totals)) {
+                fprintf(stderr, "%s: could not write %s\n", path, name.c_str());
+                return false;
+            }
+            continue;
+        }
+        if (op.kind == BATCH_HEADER || op.kind == BATCH_JSON || op.kind == BATCH_BINARY) {
+            export_format format = EXPORT_HEADER;
+            std::string name = out + ".h";
+            if (op.kind == BATCH_JSON) {
+                format = EXPORT_JSON;
+                name = out + ".json";
+            } else if (op.kind == BATCH_BINARY) {
+                format = EXPORT_BINARY;
+                name = out + ".bin";
+            }
+            if (!export_shapes(name.c_str(), doc.shapes, format, stem.c_str(), static_cast<int>(op.value))) {
+                fprintf(stderr, "%s: could not write %s\n", path, name.c_str());
+                return false;
+            }
+            continue;
+        }
+        for (int k=0; k<count; ++k) {
+            switch (op.kind) {
+            case BATCH_CENTER: doc.move_to_center(k); break;
+            case BATCH_SIMPLIFY: doc.simplify(k, SIMPLIFY_DOUGLAS_PEUCKER, op.value, 0); break;
+            case BATCH_REDUCE: doc.simplify(k, SIMPLIFY_VISVALINGAM, 0.0, static_cast<int>(op.value)); break;
+            case BATCH_QUANTIZE: doc.quantize(k, op.value); break;
+            case BATCH_WINDING: doc.fix_winding(k); break;
+            default: break;
+            }
+        }
+    }
+
+    if (!doc.save_library((out + ".polylib").c_str())) {
+        fprintf(stderr, "%s: could not write %s.polylib\n", path, out.c_str());
+        return false;
+    }
+
+    totals->shapes += count;
+    for (int k=0; k<count; ++k) {
+        totals->vertices += doc.shapes.size(k);
+    }
+    return true;
+}
+
+static bool write_image(const batch_options& options, const raster_image& image, const std::string& name) {
+
+    std::string path = name + (options.png ? ".png" : ".ppm");
+    bool ok = options.png ? raster_write_png(image, path.c_str()) : raster_write_ppm(image, path.c_str());
+    if (!ok) {
+        fprintf(stderr, "Could not write %s\n", path.c_str());
+    }
+    return ok;
+}
+
+// Thumbnails and contact sheets of the processed documents. Every
+// thumbnail and every sheet cell is a task of its own, so a single big
+// library keeps all threads busy too. Sheets are filled one page at a
+// time, only one page is held in memory. Returns the images written.
+static int write_thumbnails(const batch_options& options, thread_pool& pool,
+                            const std::vector<document>& docs, const std::vector<char>& processed,
+                            std::atomic<int>& failed) {
+
+    int size = options.thumbnail_size > 0 ? options.thumbnail_size : 128;
+    std::atomic<int> written(0);
+
+    for (size_t f=0; f<docs.size(); ++f) {
+        if (!processed[f]) continue;
+
+        const shape_store& store = docs[f].shapes;
+        int count = store.shape_count();
+        std::string out = options.out_dir + "/" + options.names[f];
+
+        if (options.thumbnail_size > 0) {
+            pool.run(count, [&](int k) {
+                raster_canvas canvas(size, size);
+                draw_thumbnail(canvas, store, k);
+                raster_image image(size, size);
+                canvas.copy_to(image, 0, 0);
+
+                char suffix[32];
+                snprintf(suffix, sizeof(suffix), "-%04d", k);
+                if (write_image(options, image, out + suffix)) {
+                    written++;
+                } else {
+                    failed++;
+                }
+            });
+        }
+
+        int columns = options.sheet_columns;
+        if (columns == 0) continue;
+
+        int per_page = columns * columns;
+        for (int first=0, page=0; first<count; first+=per_page, ++page) {
+            int cells = std::min(per_page, count - first);
+            int rows = (cells + columns - 1) / columns;
+            raster_image sheet(columns * size, rows * size);
+            pool.run(cells, [&](int c) {
+                raster_canvas canvas(size, size);
+                draw_thumbnail(canvas, store, first + c);
+                // Cells framed like the editor's panels.
+                raster_color frame = { 1.0f, 1.0f, 1.0f };
+                double e = size - 0.5;
+                canvas.path_stroke(0.5, 0.5, e, 0.5, 1.0);
+                canvas.path_stroke(e, 0.5, e, e, 1.0);
+                canvas.path_stroke(e, e, 0.5, e, 1.0);
+                canvas.path_stroke(0.5, e, 0.5, 0.5, 1.0);
+                canvas.fill(frame, 0.3f);
+                canvas.copy_to(sheet, (c % columns) * size, (c / columns) * size);
+            });
+
+            char suffix[32];
+            snprintf(suffix, sizeof(suffix), ".sheet-%02d", page);
+            if (write_image(options, sheet, out + suffix)) {
+                written++;
+            } else {
+                failed++;
+            }
+        }
+    }
+    return written.load();
+}
+
+int batch_main(int argc, char** argv) {
+
+    batch_options options;
+    if (!parse_options(argc, argv, options)) {
+        batch_usage();
+        return 2;
+    }
+    assign_names(options);
+
+    if (mkdir(options.out_dir.c_str(), 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create %s: %s\n", options.out_dir.c_str(), strerror(errno));
+        return 1;
+    }
+
+    std::atomic<int> failed(0);
+    batch_totals totals = { 0, 0, 0, 0.0 };
+    std::mutex totals_mutex;
+
+    // Documents are kept for the thumbnails only.
+    bool thumbnails = options.thumbnail_size > 0 || options.sheet_columns > 0;
+    std::vector<document> docs(options.files.size());
+    std::vector<char> processed(options.files.size(), 0);
+
+    double start = now_ms();
+    thread_pool pool(options.threads);
+    pool.run(static_cast<int>(options.files.size()), [&](int i) {
+        batch_totals file = { 0, 0, 0, 0.0 };
+        bool ok = process_file(options, options.files[i], options.names[i], docs[i], &file);
+        if (!thumbnails) {
+            docs[i] = document();
+        }
+        if (!ok) {
+            failed++;
+            return;
+        }
+        std::lock_guard<std::mutex> lock(totals_mutex);
+        totals.shapes += file.shapes;
+        totals.vertices += file.vertices;
+        totals.pieces += file.pieces;
+        totals.convex_ms += file.convex_ms;
+        processed[i] = 1;
+    });
+    double elapsed = now_ms() - start;
+
+    if (thumbnails) {
+        double raster_start = now_ms();
+        int images = write_thumbnails(options, pool, docs, processed, failed);
+        printf("%d images in %.1f ms\n", images, now_ms() - raster_start);
+    }
+
+    printf("%d files, %d shapes, %lld vertices in %.1f ms on %d threads, %d failed\n",
+        static_cast<int>(options.files.size()), totals.shapes, totals.vertices,
+        elapsed, pool.size(), failed.load());
+    if (totals.pieces > 0) {
+        printf("%d convex pieces, %.1f ms decomposing\n", totals.pieces, totals.convex_ms);
+    }
+
+    return failed == 0 ? 0 : 1;
+}
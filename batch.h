@@ -0,0 +1,9 @@
+#ifndef BATCH_H_
+#define BATCH_H_
+
+// polyd --batch: runs a pipeline of document operations over many shape
+// files without opening a window. Takes the arguments after --batch and
+// returns the process exit code.
+int batch_main(int argc, char** argv);
+
+#endif // BATCH_H_
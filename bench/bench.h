@@ -0,0 +1,67 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <time.h>
+
+#include <functional>
+#include <vector>
+
+#include "shape_store.h"
+
+// Monotonic wall clock in seconds.
+inline double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Fills the store with circles of points_per_shape vertices laid out on a
+// square lattice, total_points vertices in all.
+void bench_make_shapes(shape_store& store, int total_points, int points_per_shape);
+// Noisy wobbly circle of n vertices and radius about 5 around cx, cy, the
+// size of a shape on the grid. The same n gives the same outline.
+void bench_make_wobbly(int n, double cx, double cy, std::vector<double>& x, std::vector<double>& y);
+
+// Command line settings.
+struct bench_settings {
+    int warmup;             // untimed repetitions before measuring
+    int repetitions;        // timed repetitions, the median is reported
+    int max_vertices;       // largest size of the measured benchmarks
+    const char* filter;     // only groups whose name contains it, 0 for all
+    const char* json_path;  // measured results as JSON, 0 for none
+};
+
+extern bench_settings bench_settings_;
+
+// Results go here so the compiler cannot drop the work producing them.
+extern double bench_sink_;
+
+bool bench_selected(const char* group);
+
+// Times body, which works over vertices vertices. Each repetition calls it
+// often enough to span at least BENCH_MIN_RUN seconds, so small sizes stay
+// above the clock resolution. Prints the median and the fastest repetition
+// in ns per vertex and keeps them for the JSON report.
+void bench_measure(const char* name, int vertices, const std::function<void()>& body);
+
+// Calls body with n vertices, n from min_vertices up to the --max-vertices
+// setting, growing 16 times per step.
+void bench_for_sizes(int min_vertices, const std::function<void(int)>& body);
+
+// Naive references that cost n * n are measured up to this size only.
+#define BENCH_QUADRATIC_MAX_VERTICES 4096
+
+void bench_hot_paths();
+void bench_spatial_index();
+void bench_crossings();
+void bench_mass_properties();
+void bench_transform_kernels();
+void bench_trace();
+void bench_thumbnails();
+void bench_export();
+void bench_journal();
+void bench_boolean();
+void bench_triangulate();
+void bench_selection();
+
+#endif // BENCH_H_
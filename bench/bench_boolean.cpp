@@ -0,0 +1,135 @@
+#include <math.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include "bench.h"
+#include "polygon_boolean.h"
+
+#define BENCH_BOOLEAN_MIN_VERTICES 16
+
+static void make_circle(int n, double cx, double cy, std::vector<double>& x, std::vector<double>& y) {
+
+    x.resize(n);
+    y.resize(n);
+    for (int i=0; i<n; ++i) {
+        double a = 2.0 * M_PI * i / n;
+        x[i] = cx + 4.0 * cos(a);
+        y[i] = cy + 4.0 * sin(a);
+    }
+}
+
+// Sutherland-Hodgman: clips the outline by each edge of the convex,
+// counter-clockwise clip outline in turn, every edge against every vertex.
+static void clip_naive(const std::vector<double>& x, const std::vector<double>& y,
+                       const std::vector<double>& cx, const std::vector<double>& cy,
+                       std::vector<double>& rx, std::vector<double>& ry) {
+
+    rx = x;
+    ry = y;
+    std::vector<double> in_x, in_y;
+    int m = static_cast<int>(cx.size());
+    for (int e=0; e<m && !rx.empty(); ++e) {
+        int f = (e + 1) % m;
+        in_x.swap(rx);
+        in_y.swap(ry);
+        rx.clear();
+        ry.clear();
+        int n = static_cast<int>(in_x.size());
+        for (int i=0, j=n-1; i<n; j=i++) {
+            double dj = (cx[f] - cx[e]) * (in_y[j] - cy[e]) - (cy[f] - cy[e]) * (in_x[j] - cx[e]);
+            double di = (cx[f] - cx[e]) * (in_y[i] - cy[e]) - (cy[f] - cy[e]) * (in_x[i] - cx[e]);
+            if ((dj >= 0.0) != (di >= 0.0)) {
+                double t = dj / (dj - di);
+                rx.push_back(in_x[j] + t * (in_x[i] - in_x[j]));
+                ry.push_back(in_y[j] + t * (in_y[i] - in_y[j]));
+            }
+            if (di >= 0.0) {
+                rx.push_back(in_x[i]);
+                ry.push_back(in_y[i]);
+            }
+        }
+    }
+}
+
+static double outline_area(const double* x, const double* y, int n) {
+
+    double area2 = 0.0;
+    for (int i=0, j=n-1; i<n; j=i++) {
+        area2 += x[j] * y[i] - x[i] * y[j];
+    }
+    return 0.5 * area2;
+}
+
+static double loops_area(const polygon_loops& loops) {
+
+    double area = 0.0;
+    for (int k=0; k<loops.count(); ++k) {
+        area += outline_area(&loops.x[loops.first[k]], &loops.y[loops.first[k]], loops.size(k));
+    }
+    return area;
+}
+
+// Both outlines have n vertices.
+static void bench_boolean_size(int n) {
+
+    std::vector<double> ax, ay, bx, by;
+    bench_make_wobbly(n, 0.0, 0.0, ax, ay);
+    bench_make_wobbly(n, 1.3, 0.7, bx, by);
+    polygon_loops loops;
+    char name[64];
+
+    static const boolean_op ops[] = { BOOLEAN_UNION, BOOLEAN_INTERSECTION, BOOLEAN_DIFFERENCE };
+    static const char* op_names[] = { "union", "intersection", "difference" };
+    double areas[3];
+    for (int k=0; k<3; ++k) {
+        snprintf(name, sizeof(name), "boolean/%s/%d", op_names[k], n);
+        bench_measure(name, 2 * n, [&]() {
+            polygon_boolean(ax.data(), ay.data(), n, bx.data(), by.data(), n, ops[k], loops);
+            bench_sink_ += loops.x.size();
+        });
+        areas[k] = loops_area(loops);
+    }
+
+    // area(A u B) + area(A n B) = area(A) + area(B), and
+    // area(A - B) = area(A) - area(A n B).
+    double a = outline_area(ax.data(), ay.data(), n);
+    double b = outline_area(bx.data(), by.data(), n);
+    double tolerance = 1e-9 * (fabs(a) + fabs(b));
+    if (fabs(areas[0] + areas[1] - (a + b)) > tolerance) {
+        fprintf(stderr, "boolean/%d: union %.12g + intersection %.12g, inputs %.12g + %.12g\n",
+            n, areas[0], areas[1], a, b);
+    }
+    if (fabs(areas[2] - (a - areas[1])) > tolerance) {
+        fprintf(stderr, "boolean/%d: difference %.12g, input %.12g - intersection %.12g\n",
+            n, areas[2], a, areas[1]);
+    }
+
+    // Against a convex outline, the one case the naive clip gets right.
+    std::vector<double> cx, cy;
+    make_circle(n, 1.3, 0.7, cx, cy);
+    snprintf(name, sizeof(name), "boolean/convex_clip/%d", n);
+    bench_measure(name, 2 * n, [&]() {
+        polygon_boolean(ax.data(), ay.data(), n, cx.data(), cy.data(), n, BOOLEAN_INTERSECTION, loops);
+        bench_sink_ += loops.x.size();
+    });
+    if (n > BENCH_QUADRATIC_MAX_VERTICES) return;
+
+    std::vector<double> rx, ry;
+    snprintf(name, sizeof(name), "boolean/convex_clip_naive/%d", n);
+    bench_measure(name, 2 * n, [&]() {
+        clip_naive(ax, ay, cx, cy, rx, ry);
+        bench_sink_ += rx.size();
+    });
+
+    double naive = outline_area(rx.data(), ry.data(), static_cast<int>(rx.size()));
+    double swept = loops_area(loops);
+    if (fabs(naive - swept) > 1e-9 * fabs(naive)) {
+        fprintf(stderr, "boolean/convex_clip/%d: area %.12g, naive clip %.12g\n", n, swept, naive);
+    }
+}
+
+void bench_boolean() {
+
+    bench_for_sizes(BENCH_BOOLEAN_MIN_VERTICES, bench_boolean_size);
+}
@@ -0,0 +1,65 @@
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include "bench.h"
+#include "self_intersection.h"
+
+#define BENCH_DRAG_MOVES 10000
+
+// Star outline, every other vertex pulled in. Simple until a vertex is
+// dragged across it.
+static void make_star(int n, std::vector<double>& x, std::vector<double>& y) {
+
+    x.resize(n);
+    y.resize(n);
+    for (int i=0; i<n; ++i) {
+        double a = 2.0 * M_PI * i / n;
+        double r = (i % 2) ? 5.0 : 4.0;
+        x[i] = r * cos(a);
+        y[i] = r * sin(a);
+    }
+}
+
+static void run(int n) {
+
+    std::vector<double> x, y;
+    make_star(n, x, y);
+
+    crossing_checker checker;
+    double t0 = bench_now();
+    checker.check(x.data(), y.data(), n);
+    double check_time = bench_now() - t0;
+
+    // Drag one vertex in and out across the outline, the way motion() does.
+    int v = n / 3;
+    double base = 2.0 * M_PI * v / n;
+    std::vector<double> moves(BENCH_DRAG_MOVES);
+    t0 = bench_now();
+    for (int m=0; m<BENCH_DRAG_MOVES; ++m) {
+        double a = base + 0.3 * sin(m * 0.01);
+        double r = 4.5 + 3.0 * sin(m * 0.003);
+        x[v] = r * cos(a);
+        y[v] = r * sin(a);
+        double s = bench_now();
+        checker.move_vertex(x.data(), y.data(), n, v);
+        moves[m] = bench_now() - s;
+    }
+    double drag_time = bench_now() - t0;
+    std::sort(moves.begin(), moves.end());
+
+    printf("crossings %8d edges: full check %8.2f ms, drag %8.1f us/move avg, %8.1f us p99, %8.1f us max\n",
+        n,
+        check_time * 1e3,
+        drag_time * 1e6 / BENCH_DRAG_MOVES,
+        moves[BENCH_DRAG_MOVES * 99 / 100] * 1e6,
+        moves.back() * 1e6);
+}
+
+void bench_crossings() {
+
+    run(1000);
+    run(10000);
+    run(100000);
+}
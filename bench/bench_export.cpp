@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "document.h"
+#include "shape_export.h"
+
+#define BENCH_EXPORT_SHAPES 100000
+#define BENCH_EXPORT_VERTICES 16
+
+// A library of BENCH_EXPORT_SHAPES shapes through every export format,
+// next to the per-vertex fprintf listing write_shape() prints.
+void bench_export() {
+
+    char path[] = "/tmp/polyd_bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot create a temporary export\n");
+        return;
+    }
+    close(fd);
+
+    document doc;
+    bench_make_shapes(doc.shapes, BENCH_EXPORT_SHAPES * BENCH_EXPORT_VERTICES, BENCH_EXPORT_VERTICES);
+    int n = BENCH_EXPORT_SHAPES * BENCH_EXPORT_VERTICES;
+
+    bench_measure("export/listing", n, [&]() {
+        FILE *fSave = fopen(path, "w");
+        if (fSave == 0) return;
+        for (int k=0; k<doc.shapes.shape_count(); ++k) {
+            doc.export_shape(k, fSave);
+        }
+        fclose(fSave);
+    });
+
+    static const export_format formats[] = { EXPORT_HEADER, EXPORT_JSON, EXPORT_BINARY };
+    static const char* format_names[] = { "export/header", "export/json", "export/binary" };
+    for (int f=0; f<3; ++f) {
+        bench_measure(format_names[f], n, [&]() {
+            if (!export_shapes(path, doc.shapes, formats[f], "bench", EXPORT_DIGITS)) {
+                fprintf(stderr, "Cannot write %s\n", path);
+            }
+        });
+    }
+
+    unlink(path);
+}
@@ -0,0 +1,187 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "affine.h"
+#include "bench.h"
+#include "document.h"
+#include "mass_properties.h"
+#include "shape_library.h"
+#include "spatial_index.h"
+
+// What the editor does per event, taken out of main.cpp and measured on
+// shapes of BENCH_MIN_VERTICES and more. Each benchmark mirrors the editor
+// function it is named after.
+#define BENCH_MIN_VERTICES 16
+#define BENCH_SELECT_DISTANCE_SQ 0.04
+#define BENCH_INDEX_CELL_SIZE 0.5
+#define BENCH_QUERIES 4096
+#define BENCH_TOLERANCE 0.01
+
+static void make_outline(shape_store& store, int n) {
+
+    std::vector<double> x, y;
+    bench_make_wobbly(n, 0.0, 0.0, x, y);
+    int s = store.add_shape();
+    store.reserve(s, n);
+    for (int i=0; i<n; ++i) {
+        grid_point p = { x[i], y[i] };
+        store.append_point(s, p);
+    }
+}
+
+static void bench_update_center(int n) {
+
+    document doc;
+    make_outline(doc.shapes, n);
+
+    // A vertex drag: move one vertex, then read area and centroid back.
+    std::vector<grid_point> from(n);
+    for (int i=0; i<n; ++i) {
+        from[i] = doc.shapes.point(0, i);
+    }
+    int i = 0;
+    bench_measure("update_center/drag", n, [&]() {
+        grid_point p = { from[i].x + 0.01, from[i].y - 0.01 };
+        doc.shapes.set_point(0, i, p);
+        doc.shapes.set_point(0, i, from[i]);
+        bench_sink_ += doc.shapes.area(0) + doc.shapes.centroid(0).x;
+        i = (i + 1) % n;
+    });
+
+    // After a bulk edit the sums are re-summed over every vertex.
+    bench_measure("update_center/resum", n, [&]() {
+        doc.shapes.touch(0);
+        bench_sink_ += doc.shapes.area(0) + doc.shapes.centroid(0).x;
+    });
+}
+
+static void bench_find_selected_point(int n) {
+
+    shape_store store;
+    bench_make_shapes(store, n, std::min(n, 256));
+    vertex_index index(BENCH_INDEX_CELL_SIZE);
+    index.build(store);
+
+    // Clicks spread over the lattice, many of them near an outline.
+    double extent = 1.5 * ceil(sqrt(static_cast<double>(store.shape_count())));
+    std::vector<grid_point> queries(BENCH_QUERIES);
+    srand(1);
+    for (size_t q=0; q<queries.size(); ++q) {
+        queries[q].x = extent * rand() / RAND_MAX - 0.5;
+        queries[q].y = extent * rand() / RAND_MAX - 0.5;
+    }
+
+    size_t q = 0;
+    bench_measure("find_selected_point", n, [&]() {
+        int shape, point;
+        if (index.nearest(queries[q], BENCH_SELECT_DISTANCE_SQ, 0, &shape, &point)) {
+            bench_sink_ += point;
+        }
+        q = (q + 1) % queries.size();
+    });
+}
+
+static void bench_preview_simplified_shape(int n) {
+
+    document doc;
+    make_outline(doc.shapes, n);
+
+    std::vector<double> x;
+    std::vector<double> y;
+    static const simplify_method methods[] = { SIMPLIFY_VISVALINGAM, SIMPLIFY_DOUGLAS_PEUCKER };
+    static const char* method_names[] = { "visvalingam", "douglas_peucker" };
+    for (int m=0; m<2; ++m) {
+        char name[64];
+        snprintf(name, sizeof(name), "preview_simplified_shape/%s", method_names[m]);
+        bench_measure(name, n, [&]() {
+            doc.simplified(0, methods[m], BENCH_TOLERANCE, 0, x, y);
+            bench_sink_ += x.size();
+        });
+    }
+}
+
+static void bench_rotate_shape_with_mouse(int n) {
+
+    shape_store store;
+    make_outline(store, n);
+    vertex_index index(BENCH_INDEX_CELL_SIZE);
+    index.build(store);
+
+    // The gesture only replaces the pending transform.
+    grid_point center = store.centroid(0);
+    double angle = 0.0;
+    bench_measure("rotate_shape_with_mouse/gesture", n, [&]() {
+        angle += 0.001;
+        store.set_transform(0, affine_rotate(center, angle));
+        bench_sink_ += store.area(0) + store.centroid(0).x;
+    });
+
+    // Releasing the button commits it, see commit_transform().
+    bench_measure("rotate_shape_with_mouse/commit", n, [&]() {
+        store.set_transform(0, affine_rotate(center, 0.001));
+        store.apply_transform(0);
+        index.update_shape(store, 0);
+    });
+}
+
+static void bench_write_read_shape(int n, const char* path) {
+
+    document doc;
+    make_outline(doc.shapes, n);
+
+    // The listing goes to stdout in the editor, the null device here.
+    FILE *fNull = fopen("/dev/null", "w");
+    shape_properties properties;
+    bench_measure("write_shape/export", n, [&]() {
+        doc.shapes.touch(0);
+        doc.export_shape(0, fNull);
+        doc.export_properties(0, properties.mass(doc.shapes, 0), properties.hull(doc.shapes, 0), fNull);
+    });
+    fclose(fNull);
+
+    // What the library writer thread does per save, sync included.
+    bench_measure("write_shape/library", n, [&]() {
+        if (!library_write(path, doc.shapes)) {
+            fprintf(stderr, "Cannot write %s\n", path);
+        }
+    });
+
+    shape_library library;
+    shape_store store;
+    store.add_shape();
+    bench_measure("read_shape", n, [&]() {
+        const double* x;
+        const double* y;
+        int count;
+        if (library.open(path) && library.shape(0, &x, &y, &count)) {
+            store.assign(0, x, y, count);
+        }
+        bench_sink_ += store.size(0);
+    });
+}
+
+void bench_hot_paths() {
+
+    char path[] = "/tmp/polyd_bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot create a temporary library\n");
+        return;
+    }
+    close(fd);
+
+    bench_for_sizes(BENCH_MIN_VERTICES, [&](int n) {
+        bench_update_center(n);
+        bench_find_selected_point(n);
+        bench_preview_simplified_shape(n);
+        bench_rotate_shape_with_mouse(n);
+        bench_write_read_shape(n, path);
+    });
+
+    unlink(path);
+}
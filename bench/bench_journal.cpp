@@ -0,0 +1,66 @@
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "affine.h"
+#include "bench.h"
+#include "journal.h"
+
+#define BENCH_JOURNAL_MIN_VERTICES 16
+#define BENCH_JOURNAL_VERTICES_PER_SHAPE 1024
+#define BENCH_JOURNAL_MAX_BYTES (64 << 20)
+
+// Undo and redo on a document of n vertices. A vertex move costs the same
+// at every size, per call; an insert or a rotation touches the one shape it
+// changed.
+static void bench_journal_size(int n) {
+
+    shape_store store;
+    bench_make_shapes(store, n, std::min(n, BENCH_JOURNAL_VERTICES_PER_SHAPE));
+    journal history(BENCH_JOURNAL_MAX_BYTES);
+    int shape = store.shape_count() / 2;
+    char name[64];
+
+    // A drag: every motion event moves the vertex a little further.
+    grid_point from = store.point(shape, 0);
+    double offset = 0.0;
+    snprintf(name, sizeof(name), "journal/drag/%d", n);
+    bench_measure(name, n, [&]() {
+        offset += 1e-3;
+        grid_point to = { from.x + offset, from.y };
+        history.record_move(shape, 0, store.point(shape, 0), to);
+        store.set_point(shape, 0, to);
+    });
+    history.close();
+
+    snprintf(name, sizeof(name), "journal/undo_move/%d", n);
+    bench_measure(name, n, [&]() {
+        bench_sink_ += history.undo(store).count;
+        bench_sink_ += history.redo(store).count;
+    });
+
+    // Undo and redo of an inserted vertex move the shape's tail only.
+    grid_point inserted = { from.x, from.y + 1e-3 };
+    history.record_insert(shape, 1, inserted);
+    store.insert_point(shape, 1, inserted);
+    snprintf(name, sizeof(name), "journal/undo_insert/%d", n);
+    bench_measure(name, n, [&]() {
+        bench_sink_ += history.undo(store).delta;
+        bench_sink_ += history.redo(store).delta;
+    });
+
+    store.set_transform(shape, affine_rotate(from, 0.3));
+    history.record_transform(shape, store.pending_transform(shape));
+    store.apply_transform(shape);
+    snprintf(name, sizeof(name), "journal/undo_rotate/%d", n);
+    bench_measure(name, n, [&]() {
+        bench_sink_ += history.undo(store).count;
+        bench_sink_ += history.redo(store).count;
+    });
+}
+
+void bench_journal() {
+
+    bench_for_sizes(BENCH_JOURNAL_MIN_VERTICES, bench_journal_size);
+}
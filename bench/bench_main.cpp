@@ -0,0 +1,199 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+
+void bench_make_shapes(shape_store& store, int total_points, int points_per_shape) {
+
+    int shape_count = total_points / points_per_shape;
+    int side = static_cast<int>(ceil(sqrt(static_cast<double>(shape_count))));
+    for (int k=0; k<shape_count; ++k) {
+        int s = store.add_shape();
+        double cx = 1.5 * (k % side);
+        double cy = 1.5 * (k / side);
+        store.reserve(s, points_per_shape);
+        for (int i=0; i<points_per_shape; ++i) {
+            double a = 2.0 * M_PI * i / points_per_shape;
+            grid_point p;
+            p.x = cx + 0.5 * cos(a);
+            p.y = cy + 0.5 * sin(a);
+            store.append_point(s, p);
+        }
+    }
+}
+
+void bench_make_wobbly(int n, double cx, double cy, std::vector<double>& x, std::vector<double>& y) {
+
+    x.resize(n);
+    y.resize(n);
+    srand(n);
+    for (int i=0; i<n; ++i) {
+        double a = 2.0 * M_PI * i / n;
+        double r = 5.0 * (1.0 + 0.1 * sin(9.0 * a)) + 0.02 * rand() / RAND_MAX;
+        x[i] = cx + r * cos(a);
+        y[i] = cy + r * sin(a);
+    }
+}
+
+#define BENCH_MIN_RUN 1e-3
+
+bench_settings bench_settings_ = { 2, 10, 1 << 20, 0, 0 };
+double bench_sink_ = 0.0;
+
+struct bench_result {
+    std::string name;
+    int vertices;
+    long calls;             // per repetition
+    double median_ns;       // per call
+    double min_ns;
+};
+
+static std::vector<bench_result> results_;
+
+bool bench_selected(const char* group) {
+
+    return bench_settings_.filter == 0 || strstr(group, bench_settings_.filter) != 0;
+}
+
+void bench_measure(const char* name, int vertices, const std::function<void()>& body) {
+
+    // Double the calls until a batch spans BENCH_MIN_RUN, which also warms
+    // up caches and branch predictors.
+    long calls = 1;
+    for (;;) {
+        double t0 = bench_now();
+        for (long c=0; c<calls; ++c) {
+            body();
+        }
+        if (bench_now() - t0 >= BENCH_MIN_RUN) break;
+        calls *= 2;
+    }
+
+    for (int r=0; r<bench_settings_.warmup; ++r) {
+        for (long c=0; c<calls; ++c) {
+            body();
+        }
+    }
+
+    std::vector<double> times(std::max(bench_settings_.repetitions, 1));
+    for (size_t r=0; r<times.size(); ++r) {
+        double t0 = bench_now();
+        for (long c=0; c<calls; ++c) {
+            body();
+        }
+        times[r] = (bench_now() - t0) * 1e9 / calls;
+    }
+    std::sort(times.begin(), times.end());
+
+    bench_result result;
+    result.name = name;
+    result.vertices = vertices;
+    result.calls = calls;
+    result.median_ns = times[times.size() / 2];
+    result.min_ns = times[0];
+    results_.push_back(result);
+
+    printf("%-40s %8d vertices: %10.3f ns/vertex (min %10.3f), %12.1f ns/call\n",
+        name, vertices, result.median_ns / vertices, result.min_ns / vertices, result.median_ns);
+}
+
+void bench_for_sizes(int min_vertices, const std::function<void(int)>& body) {
+
+    for (int n=min_vertices; n<=bench_settings_.max_vertices; n*=16) {
+        body(n);
+    }
+}
+
+static bool write_json(const char* path) {
+
+    FILE *fSave = fopen(path, "w");
+    if (fSave == 0) return false;
+
+#ifdef __OPTIMIZE__
+    bool optimized = true;
+#else
+    bool optimized = false;
+#endif
+    fprintf(fSave, "{\n  \"optimized\": %s,\n  \"warmup\": %d,\n  \"repetitions\": %d,\n  \"results\": [",
+        optimized ? "true" : "false", bench_settings_.warmup, bench_settings_.repetitions);
+    for (size_t k=0; k<results_.size(); ++k) {
+        const bench_result& r = results_[k];
+        fprintf(fSave, "%s\n    {\"name\": \"%s\", \"vertices\": %d, \"calls\": %ld, "
+            "\"ns_per_vertex\": %.6g, \"min_ns_per_vertex\": %.6g, \"ns_per_call\": %.6g}",
+            k == 0 ? "" : ",", r.name.c_str(), r.vertices, r.calls,
+            r.median_ns / r.vertices, r.min_ns / r.vertices, r.median_ns);
+    }
+    fprintf(fSave, "\n  ]\n}\n");
+
+    return fclose(fSave) == 0;
+}
+
+static void bench_usage() {
+
+    fprintf(stderr,
+        "usage: polyd_bench [-w WARMUP] [-r REPETITIONS] [-n MAX_VERTICES] [-f FILTER] [-o FILE]\n"
+        "  -w WARMUP        untimed repetitions before measuring (default 2)\n"
+        "  -r REPETITIONS   timed repetitions, the median is reported (default 10)\n"
+        "  -n MAX_VERTICES  largest hot path size (default 1048576)\n"
+        "  -f FILTER        only run groups whose name contains FILTER:\n"
+        "                   hot_paths, spatial_index, crossings, mass_properties,\n"
+        "                   transform_kernels, trace, thumbnails, export, journal,\n"
+        "                   boolean, triangulate, selection\n"
+        "  -o FILE          write the measured results to FILE as JSON\n"
+        "Build the optimized variant, release/polyd_bench, for numbers worth keeping.\n");
+}
+
+static bool parse_options(int argc, char** argv) {
+
+    for (int i=1; i<argc; ++i) {
+        const char* arg = argv[i];
+        bool has_value = (i + 1 < argc);
+        if (strcmp(arg, "-w") == 0 && has_value) {
+            bench_settings_.warmup = atoi(argv[++i]);
+        } else if (strcmp(arg, "-r") == 0 && has_value) {
+            bench_settings_.repetitions = atoi(argv[++i]);
+        } else if (strcmp(arg, "-n") == 0 && has_value) {
+            bench_settings_.max_vertices = atoi(argv[++i]);
+        } else if (strcmp(arg, "-f") == 0 && has_value) {
+            bench_settings_.filter = argv[++i];
+        } else if (strcmp(arg, "-o") == 0 && has_value) {
+            bench_settings_.json_path = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    return bench_settings_.warmup >= 0 && bench_settings_.repetitions > 0;
+}
+
+int main(int argc, char** argv) {
+
+    if (!parse_options(argc, argv)) {
+        bench_usage();
+        return 2;
+    }
+
+    if (bench_selected("hot_paths")) bench_hot_paths();
+    if (bench_selected("spatial_index")) bench_spatial_index();
+    if (bench_selected("crossings")) bench_crossings();
+    if (bench_selected("mass_properties")) bench_mass_properties();
+    if (bench_selected("transform_kernels")) bench_transform_kernels();
+    if (bench_selected("trace")) bench_trace();
+    if (bench_selected("thumbnails")) bench_thumbnails();
+    if (bench_selected("export")) bench_export();
+    if (bench_selected("journal")) bench_journal();
+    if (bench_selected("boolean")) bench_boolean();
+    if (bench_selected("triangulate")) bench_triangulate();
+    if (bench_selected("selection")) bench_selection();
+
+    if (bench_settings_.json_path && !write_json(bench_settings_.json_path)) {
+        fprintf(stderr, "Cannot write %s\n", bench_settings_.json_path);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "bench.h"
+#include "mass_properties.h"
+
+#define BENCH_MASS_PASSES 10
+
+// The same results from one pass per quantity, as a separate tool would
+// compute them.
+static void separate_passes(const double* x, const double* y, int n, mass_properties& m) {
+
+    double a2 = 0.0, cx = 0.0, cy = 0.0;
+    for (int i=0, j=n-1; i<n; j=i++) {
+        double c = x[j] * y[i] - x[i] * y[j];
+        a2 += c;
+        cx += (x[j] + x[i]) * c;
+        cy += (y[j] + y[i]) * c;
+    }
+    m.area = 0.5 * a2;
+    m.centroid.x = cx / (3.0 * a2);
+    m.centroid.y = cy / (3.0 * a2);
+
+    double xx = 0.0, yy = 0.0, xy = 0.0;
+    for (int i=0, j=n-1; i<n; j=i++) {
+        double px = x[j] - m.centroid.x, py = y[j] - m.centroid.y;
+        double qx = x[i] - m.centroid.x, qy = y[i] - m.centroid.y;
+        double c = px * qy - qx * py;
+        xx += (px * px + px * qx + qx * qx) * c;
+        yy += (py * py + py * qy + qy * qy) * c;
+        xy += (px * qy + 2.0 * (px * py + qx * qy) + qx * py) * c;
+    }
+    m.xx = xx / 12.0;
+    m.yy = yy / 12.0;
+    m.xy = xy / 24.0;
+
+    m.min.x = m.max.x = x[0];
+    m.min.y = m.max.y = y[0];
+    for (int i=1; i<n; ++i) {
+        if (x[i] < m.min.x) m.min.x = x[i];
+        if (x[i] > m.max.x) m.max.x = x[i];
+        if (y[i] < m.min.y) m.min.y = y[i];
+        if (y[i] > m.max.y) m.max.y = y[i];
+    }
+}
+
+// Largest difference between the two, which also keeps the compiler from
+// dropping results nobody looks at.
+static double difference(const mass_properties& a, const mass_properties& b) {
+
+    double d[] = {
+        a.area - b.area, a.centroid.x - b.centroid.x, a.centroid.y - b.centroid.y,
+        a.xx - b.xx, a.yy - b.yy, a.xy - b.xy,
+        a.min.x - b.min.x, a.min.y - b.min.y, a.max.x - b.max.x, a.max.y - b.max.y
+    };
+    double worst = 0.0;
+    for (size_t k=0; k<sizeof(d) / sizeof(d[0]); ++k) {
+        worst = fmax(worst, fabs(d[k]));
+    }
+    return worst;
+}
+
+static void run(int n) {
+
+    // Wobbly circle, so the hull keeps only part of the vertices.
+    std::vector<double> x(n), y(n);
+    srand(1);
+    for (int i=0; i<n; ++i) {
+        double a = 2.0 * M_PI * i / n;
+        double r = 1.0 + 0.01 * rand() / RAND_MAX;
+        x[i] = 100.0 + r * cos(a);
+        y[i] = 50.0 + r * sin(a);
+    }
+
+    // Best of the passes, the first one warms up the caches.
+    mass_properties fused, separate;
+    double fused_time = HUGE_VAL;
+    double separate_time = HUGE_VAL;
+    for (int p=0; p<BENCH_MASS_PASSES; ++p) {
+        double t0 = bench_now();
+        compute_mass_properties(x.data(), y.data(), n, fused);
+        double t1 = bench_now();
+        separate_passes(x.data(), y.data(), n, separate);
+        double t2 = bench_now();
+        if (t1 - t0 < fused_time) fused_time = t1 - t0;
+        if (t2 - t1 < separate_time) separate_time = t2 - t1;
+    }
+
+    std::vector<int> hull;
+    double t0 = bench_now();
+    convex_hull(x.data(), y.data(), n, hull);
+    double hull_time = bench_now() - t0;
+
+    printf("mass_properties %8d vertices: fused %6.2f ns/vertex, separate %6.2f ns/vertex, "
+           "hull %7.2f ns/vertex (%zu kept), difference %.1e\n",
+        n,
+        fused_time * 1e9 / n,
+        separate_time * 1e9 / n,
+        hull_time * 1e9 / n, hull.size(),
+        difference(fused, separate));
+}
+
+void bench_mass_properties() {
+
+    run(1000);
+    run(100000);
+    run(1000000);
+}
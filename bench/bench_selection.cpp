@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "affine.h"
+#include "bench.h"
+#include "document.h"
+#include "thread_pool.h"
+
+#define BENCH_SELECTION_MIN_VERTICES 4096
+#define BENCH_SELECTION_VERTICES_PER_SHAPE 64
+
+static std::vector<int> select_all(const shape_store& store) {
+
+    std::vector<int> picked(store.shape_count());
+    for (int k=0; k<store.shape_count(); ++k) {
+        picked[k] = k;
+    }
+    return picked;
+}
+
+static bool same_vertices(const shape_store& a, const shape_store& b) {
+
+    return a.x.size() == b.x.size()
+        && memcmp(a.x.data(), b.x.data(), a.x.size() * sizeof(double)) == 0
+        && memcmp(a.y.data(), b.y.data(), a.y.size() * sizeof(double)) == 0;
+}
+
+// Every shape of a document of n vertices, picked at once. A drag sets one
+// transform per shape, a rotation or simplification goes over all vertices,
+// on the calling thread and on the pool.
+static void bench_selection_size(int n, thread_pool& pool) {
+
+    document doc;
+    bench_make_shapes(doc.shapes, n, BENCH_SELECTION_VERTICES_PER_SHAPE);
+    std::vector<int> picked = select_all(doc.shapes);
+    char name[64];
+
+    double offset = 0.0;
+    snprintf(name, sizeof(name), "selection/drag/%d", n);
+    bench_measure(name, n, [&]() {
+        offset += 1e-3;
+        affine t = affine_translate(offset, 0.0);
+        for (size_t i=0; i<picked.size(); ++i) {
+            doc.shapes.set_transform(picked[i], t);
+        }
+    });
+    doc.apply_transforms(picked, &pool);
+
+    snprintf(name, sizeof(name), "selection/rotate_serial/%d", n);
+    bench_measure(name, n, [&]() {
+        doc.rotate(picked, 0.1, 0);
+        doc.apply_transforms(picked, 0);
+    });
+    snprintf(name, sizeof(name), "selection/rotate_pool/%d", n);
+    bench_measure(name, n, [&]() {
+        doc.rotate(picked, 0.1, &pool);
+        doc.apply_transforms(picked, &pool);
+    });
+
+    std::vector<std::vector<double> > x, y;
+    snprintf(name, sizeof(name), "selection/simplify_serial/%d", n);
+    bench_measure(name, n, [&]() {
+        doc.simplified(picked, SIMPLIFY_DOUGLAS_PEUCKER, 0.01, 0, x, y, 0);
+        bench_sink_ += x[0].size();
+    });
+    snprintf(name, sizeof(name), "selection/simplify_pool/%d", n);
+    bench_measure(name, n, [&]() {
+        doc.simplified(picked, SIMPLIFY_DOUGLAS_PEUCKER, 0.01, 0, x, y, &pool);
+        bench_sink_ += x[0].size();
+    });
+
+    // The pool has to give exactly what one thread gives.
+    document serial;
+    document pooled;
+    bench_make_shapes(serial.shapes, n, BENCH_SELECTION_VERTICES_PER_SHAPE);
+    bench_make_shapes(pooled.shapes, n, BENCH_SELECTION_VERTICES_PER_SHAPE);
+    serial.rotate(picked, 0.7, 0);
+    serial.apply_transforms(picked, 0);
+    serial.mirror(picked, true, false, 0);
+    serial.apply_transforms(picked, 0);
+    pooled.rotate(picked, 0.7, &pool);
+    pooled.apply_transforms(picked, &pool);
+    pooled.mirror(picked, true, false, &pool);
+    pooled.apply_transforms(picked, &pool);
+    if (!same_vertices(serial.shapes, pooled.shapes)) {
+        fprintf(stderr, "selection/%d: pooled transforms differ from serial ones\n", n);
+    }
+}
+
+void bench_selection() {
+
+    thread_pool pool;
+    bench_for_sizes(BENCH_SELECTION_MIN_VERTICES, [&](int n) {
+        bench_selection_size(n, pool);
+    });
+}
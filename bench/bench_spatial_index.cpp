@@ -0,0 +1,116 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "spatial_index.h"
+
+#define BENCH_SELECT_DISTANCE_SQ 0.04
+#define BENCH_QUERIES 20000
+// Picking reaches SELECT_DISTANCE_PIXELS around the cursor, whatever the
+// zoom, as main.cpp does.
+#define BENCH_SELECT_PIXELS 16.0
+#define BENCH_ZOOMED_QUERIES 200
+
+// Linear scan over every vertex of the document, the way hit-testing
+// across all shapes has to work without an index.
+static bool linear_nearest(const shape_store& store, const grid_point& p, double radius_sq, int* shape, int* index) {
+
+    bool found = false;
+    double best_d2 = 0.0;
+    for (int k=0; k<store.shape_count(); ++k) {
+        const double* px = store.xs(k);
+        const double* py = store.ys(k);
+        int n = store.size(k);
+        for (int i=0; i<n; ++i) {
+            double dx = px[i] - p.x;
+            double dy = py[i] - p.y;
+            double d2 = dx*dx + dy*dy;
+            if (d2 <= radius_sq && (!found || d2 < best_d2)) {
+                found = true;
+                best_d2 = d2;
+                *shape = k;
+                *index = i;
+            }
+        }
+    }
+    return found;
+}
+
+static void run(int total_points) {
+
+    shape_store store;
+    bench_make_shapes(store, total_points, 100);
+
+    double t0 = bench_now();
+    vertex_index index(0.5);
+    index.build(store);
+    double build_time = bench_now() - t0;
+
+    // Query around the shape outlines so a good share of queries hit.
+    double extent = 1.5 * ceil(sqrt(total_points / 100.0));
+    std::vector<grid_point> queries(BENCH_QUERIES);
+    srand(1);
+    for (size_t q=0; q<queries.size(); ++q) {
+        queries[q].x = extent * rand() / RAND_MAX;
+        queries[q].y = extent * rand() / RAND_MAX;
+    }
+
+    int hits = 0;
+    int shape, point;
+    t0 = bench_now();
+    for (size_t q=0; q<queries.size(); ++q) {
+        if (index.nearest(queries[q], BENCH_SELECT_DISTANCE_SQ, -1, &shape, &point)) hits++;
+    }
+    double index_time = bench_now() - t0;
+
+    // The scan is slow at large sizes, sample fewer queries.
+    size_t linear_queries = queries.size();
+    if (total_points >= 1000000) linear_queries = 200;
+    int linear_hits = 0;
+    t0 = bench_now();
+    for (size_t q=0; q<linear_queries; ++q) {
+        if (linear_nearest(store, queries[q], BENCH_SELECT_DISTANCE_SQ, &shape, &point)) linear_hits++;
+    }
+    double linear_time = bench_now() - t0;
+
+    printf("spatial_index %8d vertices: build %8.2f ms, index %10.1f ns/query (%d hits), linear %12.1f ns/query (%d hits of %zu)\n",
+        total_points,
+        build_time * 1e3,
+        index_time * 1e9 / queries.size(), hits,
+        linear_time * 1e9 / linear_queries, linear_hits, linear_queries);
+}
+
+// Picking on a zoomed out view, where the radius spans many cells.
+static void run_zoomed(int total_points) {
+
+    shape_store store;
+    bench_make_shapes(store, total_points, 100);
+    vertex_index index(0.5);
+    index.build(store);
+
+    double extent = 1.5 * ceil(sqrt(total_points / 100.0));
+    const double pixel_sizes[] = { 0.01, 1.0, 10.0, 50.0, 1e4 };
+    for (size_t s=0; s<sizeof(pixel_sizes)/sizeof(pixel_sizes[0]); ++s) {
+        double radius = BENCH_SELECT_PIXELS * pixel_sizes[s];
+        srand(1);
+        int hits = 0;
+        int shape, point;
+        double t0 = bench_now();
+        for (int q=0; q<BENCH_ZOOMED_QUERIES; ++q) {
+            grid_point p = { extent * rand() / RAND_MAX, extent * rand() / RAND_MAX };
+            if (index.nearest(p, radius * radius, 0, &shape, &point)) hits++;
+        }
+        double time = bench_now() - t0;
+
+        printf("spatial_index %8d vertices, pixel size %8.2f: %12.1f ns/query (%d hits of %d)\n",
+            total_points, pixel_sizes[s], time * 1e9 / BENCH_ZOOMED_QUERIES, hits, BENCH_ZOOMED_QUERIES);
+    }
+}
+
+void bench_spatial_index() {
+
+    run(10000);
+    run(1000000);
+    run_zoomed(1000000);
+}
@@ -0,0 +1,41 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "raster.h"
+#include "thread_pool.h"
+#include "thumbnail.h"
+
+#define BENCH_THUMBNAIL_SIZE 128
+#define BENCH_THUMBNAIL_COUNT 10000
+#define BENCH_THUMBNAIL_VERTICES 64
+
+// Drawing cost by outline size, then what polyd --batch -t does for a
+// library of BENCH_THUMBNAIL_COUNT shapes, PNG encoding included.
+void bench_thumbnails() {
+
+    raster_canvas canvas(BENCH_THUMBNAIL_SIZE, BENCH_THUMBNAIL_SIZE);
+    for (int n=16; n<=bench_settings_.max_vertices && n<=65536; n*=16) {
+        shape_store store;
+        bench_make_shapes(store, n, n);
+        bench_measure("thumbnail/draw", n, [&]() {
+            draw_thumbnail(canvas, store, 0);
+        });
+    }
+
+    shape_store store;
+    bench_make_shapes(store, BENCH_THUMBNAIL_COUNT * BENCH_THUMBNAIL_VERTICES, BENCH_THUMBNAIL_VERTICES);
+    thread_pool pool;
+    double t0 = bench_now();
+    pool.run(store.shape_count(), [&](int k) {
+        raster_canvas c(BENCH_THUMBNAIL_SIZE, BENCH_THUMBNAIL_SIZE);
+        draw_thumbnail(c, store, k);
+        raster_image image(BENCH_THUMBNAIL_SIZE, BENCH_THUMBNAIL_SIZE);
+        c.copy_to(image, 0, 0);
+        raster_write_png(image, "/dev/null");
+    });
+    double elapsed = bench_now() - t0;
+
+    printf("thumbnails %d of %d vertices at %d px: %8.1f ms on %d threads, %8.0f thumbnails/s\n",
+        store.shape_count(), BENCH_THUMBNAIL_VERTICES, BENCH_THUMBNAIL_SIZE,
+        elapsed * 1e3, pool.size(), store.shape_count() / elapsed);
+}
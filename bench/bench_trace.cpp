@@ -0,0 +1,22 @@
+#include "bench.h"
+#include "trace.h"
+
+// Cost of one scope, per call, with tracing off and on.
+void bench_trace() {
+
+    bool was_enabled = trace_enabled_.load();
+
+    trace_enable(false);
+    bench_measure("trace/scope_off", 1, []() {
+        TRACE_SCOPE("bench");
+        bench_sink_ += 1.0;
+    });
+
+    trace_enable(true);
+    bench_measure("trace/scope_on", 1, []() {
+        TRACE_SCOPE("bench");
+        bench_sink_ += 1.0;
+    });
+
+    trace_enable(was_enabled);
+}
@@ -0,0 +1,96 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "bench.h"
+#include "transform_kernels.h"
+
+#define BENCH_KERNEL_POINTS 1000000
+#define BENCH_KERNEL_PASSES 20
+
+enum kernel_op {
+    OP_TRANSLATE = 0,
+    OP_ROTATE,
+    OP_SCALE,
+    OP_MIRROR,
+    OP_QUANTIZE,
+    OP_COUNT
+};
+
+static const char* op_names[OP_COUNT] = {
+    "translate", "rotate", "scale", "mirror", "quantize"
+};
+
+static void run_op(int op, const std::vector<double>& sx, const std::vector<double>& sy,
+                   std::vector<double>& dx, std::vector<double>& dy) {
+
+    int n = static_cast<int>(sx.size());
+    grid_point c;
+    c.x = 0.25;
+    c.y = -0.5;
+    switch (op) {
+    case OP_TRANSLATE:
+        kernel_translate(sx.data(), sy.data(), dx.data(), dy.data(), n, 0.125, -3.0);
+        break;
+    case OP_ROTATE:
+        kernel_affine(sx.data(), sy.data(), dx.data(), dy.data(), n, affine_rotate(c, 0.3));
+        break;
+    case OP_SCALE: {
+        affine t = { 1.5, 0.0, 0.0, 0.75, c.x - 1.5 * c.x, c.y - 0.75 * c.y };
+        kernel_affine(sx.data(), sy.data(), dx.data(), dy.data(), n, t);
+        break;
+    }
+    case OP_MIRROR:
+        kernel_affine(sx.data(), sy.data(), dx.data(), dy.data(), n, affine_mirror(c, true, true));
+        break;
+    case OP_QUANTIZE:
+        kernel_quantize(sx.data(), sy.data(), dx.data(), dy.data(), n, 10.0);
+        break;
+    }
+}
+
+void bench_transform_kernels() {
+
+    int n = BENCH_KERNEL_POINTS;
+    std::vector<double> sx(n), sy(n);
+    srand(1);
+    for (int i=0; i<n; ++i) {
+        sx[i] = 20.0 * rand() / RAND_MAX - 10.0;
+        sy[i] = 20.0 * rand() / RAND_MAX - 10.0;
+    }
+    // Exact ties for the rounding path.
+    for (int i=0; i<n; i+=97) {
+        sx[i] = (i % 2 ? -0.25 : 0.35);
+    }
+
+    kernel_isa best = kernel_selected();
+    std::vector<double> ref_x(n), ref_y(n), dx(n), dy(n);
+
+    for (int op=0; op<OP_COUNT; ++op) {
+        kernel_select(KERNEL_SCALAR);
+        run_op(op, sx, sy, ref_x, ref_y);
+
+        for (int isa=KERNEL_SCALAR; isa<=best; ++isa) {
+            kernel_select(static_cast<kernel_isa>(isa));
+
+            run_op(op, sx, sy, dx, dy);
+            bool identical = memcmp(dx.data(), ref_x.data(), n * sizeof(double)) == 0
+                          && memcmp(dy.data(), ref_y.data(), n * sizeof(double)) == 0;
+
+            double t0 = bench_now();
+            for (int pass=0; pass<BENCH_KERNEL_PASSES; ++pass) {
+                run_op(op, sx, sy, dx, dy);
+            }
+            double elapsed = bench_now() - t0;
+
+            printf("kernel %-9s %-6s %8d vertices: %8.1f Mvertices/s, %s scalar\n",
+                op_names[op], kernel_isa_name(static_cast<kernel_isa>(isa)), n,
+                BENCH_KERNEL_PASSES * n / elapsed * 1e-6,
+                identical ? "identical to" : "DIFFERS from");
+        }
+    }
+
+    kernel_select(best);
+}
@@ -0,0 +1,79 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "bench.h"
+#include "convex_decompose.h"
+#include "triangulate.h"
+
+#define BENCH_TRIANGULATE_MIN_VERTICES 16
+
+// Star with a spike every other vertex and a noisy radius, so about half
+// the vertices are reflex.
+static void make_concave(int n, std::vector<double>& x, std::vector<double>& y) {
+
+    x.resize(n);
+    y.resize(n);
+    srand(n);
+    for (int i=0; i<n; ++i) {
+        double a = 2.0 * M_PI * i / n;
+        double r = (i % 2 == 0 ? 5.0 : 3.0) * (1.0 + 0.2 * sin(7.0 * a)) + 0.5 * rand() / RAND_MAX;
+        x[i] = r * cos(a);
+        y[i] = r * sin(a);
+    }
+}
+
+static double triangles_area(const std::vector<double>& x, const std::vector<double>& y,
+                             const std::vector<int>& triangles) {
+
+    double area2 = 0.0;
+    for (size_t k=0; k<triangles.size(); k+=3) {
+        int a = triangles[k];
+        int b = triangles[k + 1];
+        int c = triangles[k + 2];
+        area2 += (x[b] - x[a]) * (y[c] - y[a]) - (x[c] - x[a]) * (y[b] - y[a]);
+    }
+    return 0.5 * area2;
+}
+
+static void bench_triangulate_size(int n) {
+
+    std::vector<double> x, y;
+    make_concave(n, x, y);
+    std::vector<int> triangles;
+    char name[64];
+
+    snprintf(name, sizeof(name), "triangulate/monotone/%d", n);
+    bench_measure(name, n, [&]() {
+        triangulate_monotone(x.data(), y.data(), n, triangles);
+        bench_sink_ += triangles.size();
+    });
+    double monotone = triangles_area(x, y, triangles);
+
+    // The convex piece overlay, at the editor's default piece size.
+    convex_pieces pieces;
+    snprintf(name, sizeof(name), "triangulate/convex_decompose/%d", n);
+    bench_measure(name, n, [&]() {
+        convex_decompose(x.data(), y.data(), n, 8, pieces);
+        bench_sink_ += pieces.count();
+    });
+    if (n > BENCH_QUADRATIC_MAX_VERTICES) return;
+
+    snprintf(name, sizeof(name), "triangulate/ears/%d", n);
+    bench_measure(name, n, [&]() {
+        triangulate_ears(x.data(), y.data(), n, triangles);
+        bench_sink_ += triangles.size();
+    });
+
+    double ears = triangles_area(x, y, triangles);
+    if (fabs(monotone - ears) > 1e-9 * fabs(ears)) {
+        fprintf(stderr, "triangulate/%d: area %.12g, ear clipping %.12g\n", n, monotone, ears);
+    }
+}
+
+void bench_triangulate() {
+
+    bench_for_sizes(BENCH_TRIANGULATE_MIN_VERTICES, bench_triangulate_size);
+}
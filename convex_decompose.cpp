@@ -0,0 +1,134 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "convex_decompose.h"
+#include "triangulate.h"
+
+// A diagonal as its two half-edges, one in each piece it separates.
+struct diagonal {
+    double length_sq;
+    int edge;
+    int twin;
+};
+
+static bool longer(const diagonal& l, const diagonal& r) {
+
+    return l.length_sq > r.length_sq;
+}
+
+static uint64_t edge_key(int a, int b) {
+
+    return (static_cast<uint64_t>(static_cast<uint32_t>(a)) << 32) | static_cast<uint32_t>(b);
+}
+
+static bool convex_corner(const double* x, const double* y, int a, int b, int c) {
+
+    return (x[b] - x[a]) * (y[c] - y[a]) - (x[c] - x[a]) * (y[b] - y[a]) >= 0.0;
+}
+
+static int find_root(std::vector<int>& parent, int t) {
+
+    while (parent[t] != t) {
+        parent[t] = parent[parent[t]];
+        t = parent[t];
+    }
+    return t;
+}
+
+bool convex_decompose(const double* x, const double* y, int n, int max_vertices, convex_pieces& pieces) {
+
+    pieces.first.clear();
+    pieces.indices.clear();
+
+    std::vector<int> triangles;
+    bool simple = triangulate_monotone(x, y, n, triangles);
+
+    // Half-edge h of triangle h / 3 starts at triangles[h]. Pieces are rings
+    // of half-edges linked through next and prev; removing a diagonal splices
+    // the two rings on either side of it into one.
+    int edges = static_cast<int>(triangles.size());
+    std::vector<int> next(edges), prev(edges), twin(edges, -1);
+    std::unordered_map<uint64_t, int> start;
+    start.reserve(edges);
+    for (int h=0; h<edges; ++h) {
+        int t = h - h % 3;
+        next[h] = t + (h + 1) % 3;
+        prev[h] = t + (h + 2) % 3;
+        start[edge_key(triangles[h], triangles[next[h]])] = h;
+    }
+
+    // Edges that are there in both directions are diagonals.
+    std::vector<diagonal> diagonals;
+    for (int h=0; h<edges; ++h) {
+        int a = triangles[h];
+        int b = triangles[next[h]];
+        std::unordered_map<uint64_t, int>::const_iterator it = start.find(edge_key(b, a));
+        if (it == start.end()) continue;
+
+        twin[h] = it->second;
+        if (a < b) {
+            double dx = x[b] - x[a];
+            double dy = y[b] - y[a];
+            diagonal d = { dx * dx + dy * dy, h, it->second };
+            diagonals.push_back(d);
+        }
+    }
+    std::sort(diagonals.begin(), diagonals.end(), longer);
+
+    // Pieces are sets of triangles, with the vertex count at their root.
+    int count = edges / 3;
+    std::vector<int> parent(count), size(count, 3);
+    for (int t=0; t<count; ++t) {
+        parent[t] = t;
+    }
+
+    std::vector<bool> removed(edges, false);
+    for (size_t i=0; i<diagonals.size(); ++i) {
+        // h runs a -> b in piece p, g runs b -> a in piece q.
+        int h = diagonals[i].edge;
+        int g = diagonals[i].twin;
+        int p = find_root(parent, h / 3);
+        int q = find_root(parent, g / 3);
+        int merged = size[p] + size[q] - 2;
+        if (p == q || (max_vertices > 0 && merged > max_vertices)) continue;
+
+        // Only the corners at a and b change.
+        int a = triangles[h];
+        int b = triangles[g];
+        int before_a = triangles[prev[h]];
+        int after_a = triangles[next[next[g]]];
+        int before_b = triangles[prev[g]];
+        int after_b = triangles[next[next[h]]];
+        if (!convex_corner(x, y, before_a, a, after_a) || !convex_corner(x, y, before_b, b, after_b)) continue;
+
+        next[prev[h]] = next[g];
+        prev[next[g]] = prev[h];
+        next[prev[g]] = next[h];
+        prev[next[h]] = prev[g];
+        removed[h] = true;
+        removed[g] = true;
+
+        parent[q] = p;
+        size[p] = merged;
+    }
+
+    // Each piece is written out once, from the first half-edge left in it.
+    std::vector<bool> written(count, false);
+    pieces.first.push_back(0);
+    for (int h=0; h<edges; ++h) {
+        if (removed[h]) continue;
+        int p = find_root(parent, h / 3);
+        if (written[p]) continue;
+        written[p] = true;
+
+        int e = h;
+        do {
+            pieces.indices.push_back(triangles[e]);
+            e = next[e];
+        } while (e != h);
+        pieces.first.push_back(static_cast<int>(pieces.indices.size()));
+    }
+    return simple;
+}
@@ -0,0 +1,26 @@
+#ifndef CONVEX_DECOMPOSE_H_
+#define CONVEX_DECOMPOSE_H_
+
+#include <vector>
+
+// Convex pieces of one outline, as vertex indices into it. Piece k is
+// indices[first[k]] .. indices[first[k+1] - 1], counter-clockwise.
+struct convex_pieces {
+    int count() const { return first.empty() ? 0 : static_cast<int>(first.size()) - 1; }
+    int size(int piece) const { return first[piece + 1] - first[piece]; }
+
+    std::vector<int> first;
+    std::vector<int> indices;
+};
+
+// Hertel-Mehlhorn: triangulates the outline, then removes diagonals, longest
+// first, as long as both pieces they separate merge into a convex piece of
+// at most max_vertices vertices (0 for no limit). Without a limit the
+// result has at most four times as many pieces as the fewest possible.
+// Triangulating takes O(n log n), each removal O(1) on linked half-edges.
+//
+// Returns false if the outline is not simple; the pieces are then only a
+// best effort.
+bool convex_decompose(const double* x, const double* y, int n, int max_vertices, convex_pieces& pieces);
+
+#endif // CONVEX_DECOMPOSE_H_
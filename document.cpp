@@ -0,0 +1,273 @@
+#include <algorithm>
+
+#include "affine.h"
+#include "document.h"
+#include "shape_library.h"
+#include "transform_kernels.h"
+
+// Record layout of the old design-NN.poly files, a raw dump of the former
+// in-memory shape array. They are only read, to import them into the
+// library; invalid records are skipped.
+struct legacy_shape_point {
+    bool valid;
+    grid_point point;
+};
+
+bool document::load_library(const char* path) {
+
+    shape_library library;
+    if (!library.open(path)) return false;
+
+    for (int k=0; k<library.shape_count(); ++k) {
+        const double* x;
+        const double* y;
+        int n;
+        if (!library.shape(k, &x, &y, &n)) {
+            fprintf(stderr, "Shape %d in %s fails its checksum, skipped\n", k, path);
+            continue;
+        }
+        while (k >= shapes.shape_count()) {
+            shapes.add_shape();
+        }
+        shapes.assign(k, x, y, n);
+    }
+    return true;
+}
+
+bool document::import_legacy(const char* path, int shape) {
+
+    FILE *fLoad = fopen(path, "rb");
+    if (fLoad == 0) return false;
+
+    while (shape >= shapes.shape_count()) {
+        shapes.add_shape();
+    }
+
+    shapes.clear_shape(shape);
+    legacy_shape_point record;
+    while (fread(&record, sizeof(legacy_shape_point), 1, fLoad) == 1) {
+        if (record.valid) {
+            shapes.append_point(shape, record.point);
+        }
+    }
+    fclose(fLoad);
+
+    return true;
+}
+
+bool document::save_library(const char* path) {
+
+    return library_write(path, shapes);
+}
+
+// Shapes without area have no centroid; operations around it leave them
+// alone.
+static bool shape_center(const shape_store& shapes, int shape, grid_point* c) {
+
+    if (shapes.area(shape) == 0.0) return false;
+
+    *c = shapes.centroid(shape);
+    return true;
+}
+
+void document::move_to_center(int shape) {
+
+    grid_point c;
+    if (!shape_center(shapes, shape, &c)) return;
+
+    shapes.transform(shape, affine_translate(-c.x, -c.y));
+}
+
+void document::mirror(int shape, bool mirror_x, bool mirror_y) {
+
+    grid_point c;
+    if (!shape_center(shapes, shape, &c)) return;
+
+    shapes.transform(shape, affine_mirror(c, mirror_x, mirror_y));
+}
+
+void document::rotate(int shape, double angle) {
+
+    grid_point c;
+    if (!shape_center(shapes, shape, &c)) return;
+
+    shapes.transform(shape, affine_rotate(c, angle));
+}
+
+void document::paste(int dst, int src, bool at_target) {
+
+    if (dst == src) return;
+
+    double ox = 0.0;
+    double oy = 0.0;
+    grid_point to, from;
+    if (at_target && shape_center(shapes, dst, &to) && shape_center(shapes, src, &from)) {
+        ox = to.x - from.x;
+        oy = to.y - from.y;
+    }
+    shapes.copy_shape(dst, src, ox, oy);
+}
+
+void document::quantize(int shape, double factor) {
+
+    double* px = shapes.xs(shape);
+    double* py = shapes.ys(shape);
+    kernel_quantize(px, py, px, py, shapes.size(shape), factor);
+    shapes.touch(shape);
+}
+
+void document::simplified(int shape, simplify_method method, double tolerance, int target,
+                          std::vector<double>& x, std::vector<double>& y) {
+
+    const double* px = shapes.xs(shape);
+    const double* py = shapes.ys(shape);
+    std::vector<int> keep;
+    simplify_outline(method, px, py, shapes.size(shape), tolerance, target, keep);
+
+    x.resize(keep.size());
+    y.resize(keep.size());
+    for (size_t i=0; i<keep.size(); ++i) {
+        x[i] = px[keep[i]];
+        y[i] = py[keep[i]];
+    }
+}
+
+void document::simplify(int shape, simplify_method method, double tolerance, int target) {
+
+    std::vector<double> x;
+    std::vector<double> y;
+    simplified(shape, method, tolerance, target, x, y);
+    shapes.assign(shape, x.data(), y.data(), static_cast<int>(x.size()));
+}
+
+void document::for_each_shape(const std::vector<int>& selection, thread_pool* pool,
+                              const std::function<void(int)>& job) {
+
+    int count = static_cast<int>(selection.size());
+    long long total = 0;
+    for (int i=0; i<count; ++i) {
+        total += shapes.size(selection[i]);
+    }
+    if (pool == 0 || pool->size() == 1 || total < DOCUMENT_PARALLEL_MIN_VERTICES) {
+        for (int i=0; i<count; ++i) {
+            job(i);
+        }
+        return;
+    }
+
+    // Run r ends where the vertices so far first reach r + 1 shares.
+    int runs = std::min(count, pool->size() * DOCUMENT_RUNS_PER_THREAD);
+    std::vector<int> ends(runs, count);
+    long long sum = 0;
+    int r = 0;
+    for (int i=0; i<count && r<runs; ++i) {
+        sum += shapes.size(selection[i]);
+        while (r < runs && sum * runs >= total * (r + 1)) {
+            ends[r++] = i + 1;
+        }
+    }
+    ends[runs - 1] = count;
+    pool->run(runs, [&](int run) {
+        for (int i=(run == 0 ? 0 : ends[run - 1]); i<ends[run]; ++i) {
+            job(i);
+        }
+    });
+}
+
+void document::move_to_center(const std::vector<int>& selection, thread_pool* pool) {
+
+    for_each_shape(selection, pool, [&](int i) { move_to_center(selection[i]); });
+}
+
+void document::mirror(const std::vector<int>& selection, bool mirror_x, bool mirror_y, thread_pool* pool) {
+
+    for_each_shape(selection, pool, [&](int i) { mirror(selection[i], mirror_x, mirror_y); });
+}
+
+void document::rotate(const std::vector<int>& selection, double angle, thread_pool* pool) {
+
+    for_each_shape(selection, pool, [&](int i) { rotate(selection[i], angle); });
+}
+
+void document::apply_transforms(const std::vector<int>& selection, thread_pool* pool) {
+
+    for_each_shape(selection, pool, [&](int i) { shapes.apply_transform(selection[i]); });
+}
+
+void document::simplified(const std::vector<int>& selection, simplify_method method, double tolerance, int target,
+                          std::vector<std::vector<double> >& x, std::vector<std::vector<double> >& y,
+                          thread_pool* pool) {
+
+    x.resize(selection.size());
+    y.resize(selection.size());
+    for_each_shape(selection, pool, [&](int i) {
+        simplified(selection[i], method, tolerance, target, x[i], y[i]);
+    });
+}
+
+bool document::fix_winding(int shape) {
+
+    if (shapes.area(shape) >= 0.0) return false;
+
+    double* px = shapes.xs(shape);
+    double* py = shapes.ys(shape);
+    int n = shapes.size(shape);
+    std::reverse(px, px + n);
+    std::reverse(py, py + n);
+    shapes.touch(shape);
+
+    return true;
+}
+
+bool document::decompose(int shape, int max_vertices, convex_pieces& pieces) const {
+
+    return convex_decompose(shapes.xs(shape), shapes.ys(shape), shapes.size(shape), max_vertices, pieces);
+}
+
+void document::combine(int shape, int other, boolean_op op, polygon_loops& loops) const {
+
+    polygon_boolean(shapes.xs(shape), shapes.ys(shape), shapes.size(shape),
+                    shapes.xs(other), shapes.ys(other), shapes.size(other), op, loops);
+}
+
+void document::export_shape(int shape, FILE* out) const {
+
+    int n = shapes.size(shape);
+    for(int i=0; i<n; ++i) {
+        grid_point p = shapes.point(shape, i);
+        if (i == 0) {
+            fprintf(out, "\n{");
+        } else {
+            fputs(",\n", out);
+        }
+        fprintf(out, "{%.3f, %.3f}", p.x, p.y);
+    }
+    if (n > 0) fputs("}\n", out);
+}
+
+void document::export_pieces(int shape, const convex_pieces& pieces, FILE* out) const {
+
+    for (int k=0; k<pieces.count(); ++k) {
+        fputs(k == 0 ? "\n{" : ",\n", out);
+        for (int i=pieces.first[k]; i<pieces.first[k + 1]; ++i) {
+            grid_point p = shapes.point(shape, pieces.indices[i]);
+            fprintf(out, "%s{%.3f, %.3f}", i == pieces.first[k] ? "{" : ", ", p.x, p.y);
+        }
+        fputc('}', out);
+    }
+    if (pieces.count() > 0) fputs("}\n", out);
+}
+
+void document::export_properties(int shape, const mass_properties& mass, const std::vector<int>& hull, FILE* out) const {
+
+    if (shapes.size(shape) == 0) return;
+
+    fprintf(out, "\n{%.6g, {%.3f, %.3f}, %.6g,\n{{%.3f, %.3f}, {%.3f, %.3f}},\n{",
+        mass.area, mass.centroid.x, mass.centroid.y, mass.polar_inertia(),
+        mass.min.x, mass.min.y, mass.max.x, mass.max.y);
+    for (size_t k=0; k<hull.size(); ++k) {
+        grid_point p = shapes.point(shape, hull[k]);
+        fprintf(out, "%s{%.3f, %.3f}", k == 0 ? "" : ", ", p.x, p.y);
+    }
+    fputs("}}\n", out);
+}
@@ -0,0 +1,92 @@
+#ifndef DOCUMENT_H_
+#define DOCUMENT_H_
+
+#include <stdio.h>
+#include <functional>
+#include <vector>
+
+#include "convex_decompose.h"
+#include "geometry.h"
+#include "mass_properties.h"
+#include "polygon_boolean.h"
+#include "shape_store.h"
+#include "simplify.h"
+#include "thread_pool.h"
+
+// Selections with fewer vertices in all run on the calling thread, a pool
+// would cost more than it saves.
+#define DOCUMENT_PARALLEL_MIN_VERTICES 65536
+// Runs a selection is cut into per pool thread, so threads that finish
+// early can steal from the others.
+#define DOCUMENT_RUNS_PER_THREAD 4
+
+// The shapes being edited and the operations on them. Nothing here touches
+// GL or GLUT, so the editor and the batch mode run the same code.
+//
+// Operations that move a shape as a whole leave their transform pending in
+// the store; shapes.apply_transform() commits it, saving commits all.
+struct document {
+    // Library files replace the contents from shape 0 on, legacy
+    // design-NN.poly files fill one shape. Slots are added as needed.
+    bool load_library(const char* path);
+    bool import_legacy(const char* path, int shape);
+    bool save_library(const char* path);
+
+    // Centroid to the origin.
+    void move_to_center(int shape);
+    // Around the centroid.
+    void mirror(int shape, bool mirror_x, bool mirror_y);
+    void rotate(int shape, double angle);
+    // The source shape as a new outline of dst, placed over dst's centroid
+    // or at its original position.
+    void paste(int dst, int src, bool at_target);
+
+    // Coordinates rounded to 1/factor.
+    void quantize(int shape, double factor);
+    // Outline with fewer vertices, see simplify_outline().
+    void simplified(int shape, simplify_method method, double tolerance, int target,
+                    std::vector<double>& x, std::vector<double>& y);
+    void simplify(int shape, simplify_method method, double tolerance, int target);
+
+    // Calls job(i) for every shape selection[i]. Large selections are cut
+    // into runs of about equal vertex counts, spread over pool; pool 0 runs
+    // them all here. Shapes must not repeat, and job must only touch its
+    // own shape without adding vertices or shapes; the result is then the
+    // same however the runs fall.
+    void for_each_shape(const std::vector<int>& selection, thread_pool* pool,
+                        const std::function<void(int)>& job);
+    // The single-shape operations above on every selected shape, each
+    // around its own centroid.
+    void move_to_center(const std::vector<int>& selection, thread_pool* pool);
+    void mirror(const std::vector<int>& selection, bool mirror_x, bool mirror_y, thread_pool* pool);
+    void rotate(const std::vector<int>& selection, double angle, thread_pool* pool);
+    // Commits the pending transforms of the selection.
+    void apply_transforms(const std::vector<int>& selection, thread_pool* pool);
+    // Simplified outline of selection[i] in x[i], y[i].
+    void simplified(const std::vector<int>& selection, simplify_method method, double tolerance, int target,
+                    std::vector<std::vector<double> >& x, std::vector<std::vector<double> >& y,
+                    thread_pool* pool);
+
+    // Reverses clockwise outlines so every shape winds counter-clockwise.
+    // Returns true if the shape was reversed.
+    bool fix_winding(int shape);
+
+    // Convex pieces of the committed outline, see convex_decompose(). They
+    // are vertex indices, so they follow a pending transform.
+    bool decompose(int shape, int max_vertices, convex_pieces& pieces) const;
+    // Shape combined with other by op, see polygon_boolean(). Both are
+    // taken as committed, without their pending transforms.
+    void combine(int shape, int other, boolean_op op, polygon_loops& loops) const;
+
+    // {{x, y},...} listing, pending transform included.
+    void export_shape(int shape, FILE* out) const;
+    // {{{x, y},...},...} listing of the pieces.
+    void export_pieces(int shape, const convex_pieces& pieces, FILE* out) const;
+    // {area, {cx, cy}, polar inertia, {{min}, {max}}, {{x, y},...}} with the
+    // hull last, as shape_properties has them.
+    void export_properties(int shape, const mass_properties& mass, const std::vector<int>& hull, FILE* out) const;
+
+    shape_store shapes;
+};
+
+#endif // DOCUMENT_H_
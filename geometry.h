@@ -0,0 +1,28 @@
+#ifndef GEOMETRY_H_
+#define GEOMETRY_H_
+
+struct grid_point {
+    double distance_square(const grid_point& cursor) const {
+        double dx = x - cursor.x;
+        double dy = y - cursor.y;
+        return (dx*dx + dy*dy);
+    }
+    double x;
+    double y;
+};
+
+// Axis-aligned box, min <= max.
+struct grid_box {
+    bool overlaps(const grid_box& other) const {
+        return min.x <= other.max.x && other.min.x <= max.x
+            && min.y <= other.max.y && other.min.y <= max.y;
+    }
+    bool contains(const grid_box& other) const {
+        return min.x <= other.min.x && other.max.x <= max.x
+            && min.y <= other.min.y && other.max.y <= max.y;
+    }
+    grid_point min;
+    grid_point max;
+};
+
+#endif // GEOMETRY_H_
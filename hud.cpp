@@ -0,0 +1,45 @@
+#include <GL/glut.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include "hud.h"
+
+struct hud_line {
+    GLuint list;
+    std::string text;
+};
+
+static std::unordered_map<uint64_t, hud_line> lines_;
+static int rebuild_count_ = 0;
+
+void hud_print(int x, int y, const char* text) {
+
+    uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+    hud_line& line = lines_[key];
+
+    if (line.list == 0 || line.text != text) {
+        if (line.list == 0) {
+            line.list = glGenLists(1);
+        }
+        line.text = text;
+
+        void* font = GLUT_BITMAP_9_BY_15;
+
+        glNewList(line.list, GL_COMPILE);
+        glRasterPos2i(x, y);
+        for (size_t i=0; i<line.text.size(); ++i) {
+            glutBitmapCharacter(font, line.text[i]);
+        }
+        glEndList();
+
+        rebuild_count_++;
+    }
+
+    glCallList(line.list);
+}
+
+int hud_rebuild_count() {
+
+    return rebuild_count_;
+}
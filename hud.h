@@ -0,0 +1,13 @@
+#ifndef HUD_H_
+#define HUD_H_
+
+// Bitmap text for the HUD panels. Every line, keyed by its position, is
+// compiled into a display list the first time it is drawn and recompiled
+// only when its text changes, so an unchanged panel costs one glCallList
+// per line instead of a glBitmap per character.
+void hud_print(int x, int y, const char* text);
+
+// Display lists compiled so far, for the debug panel.
+int hud_rebuild_count();
+
+#endif // HUD_H_
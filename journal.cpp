@@ -0,0 +1,330 @@
+#include <algorithm>
+
+#include "journal.h"
+
+journal::journal(size_t max_bytes)
+: next_(0)
+, bytes_(0)
+, max_bytes_(max_bytes)
+, group_size_(-1)
+, rewrite_shape_(-1)
+{
+}
+
+size_t journal::entry_bytes(const entry& e) {
+
+    return sizeof(entry) + sizeof(double) * (e.before_x.size() + e.before_y.size()
+                                             + e.after_x.size() + e.after_y.size())
+        + sizeof(int) * e.runs.size();
+}
+
+journal::entry& journal::push(entry_kind kind, int shape) {
+
+    // What was undone cannot be redone once something new happened.
+    while (entries_.size() > next_) {
+        bytes_ -= entry_bytes(entries_.back());
+        entries_.pop_back();
+    }
+    close();
+
+    entries_.push_back(entry());
+    entry& e = entries_.back();
+    e.kind = kind;
+    e.shape = shape;
+    e.open = false;
+    e.joined = group_size_ > 0;
+    e.first = 0;
+    e.t = affine_identity();
+    next_++;
+    if (group_size_ >= 0) group_size_++;
+    return e;
+}
+
+void journal::trim() {
+
+    while (bytes_ > max_bytes_ && !entries_.empty()) {
+        if (next_ == 0) {
+            // Only redo entries are left, and they need the ones before.
+            entries_.clear();
+            bytes_ = 0;
+            break;
+        }
+        bytes_ -= entry_bytes(entries_.front());
+        entries_.pop_front();
+        next_--;
+    }
+}
+
+void journal::set_max_bytes(size_t max_bytes) {
+
+    max_bytes_ = max_bytes;
+    trim();
+}
+
+void journal::record_insert(int shape, int i, const grid_point& p) {
+
+    entry& e = push(JOURNAL_SPLICE, shape);
+    e.first = i;
+    e.after_x.assign(1, p.x);
+    e.after_y.assign(1, p.y);
+    bytes_ += entry_bytes(e);
+    trim();
+}
+
+void journal::record_erase(int shape, int i, const grid_point& p) {
+
+    entry& e = push(JOURNAL_SPLICE, shape);
+    e.first = i;
+    e.before_x.assign(1, p.x);
+    e.before_y.assign(1, p.y);
+    bytes_ += entry_bytes(e);
+    trim();
+}
+
+void journal::record_move(int shape, int i, const grid_point& from, const grid_point& to) {
+
+    if (next_ > 0 && next_ == entries_.size()) {
+        entry& last = entries_.back();
+        if (last.open && last.shape == shape && last.first == i) {
+            last.after_x[0] = to.x;
+            last.after_y[0] = to.y;
+            return;
+        }
+    }
+
+    entry& e = push(JOURNAL_SPLICE, shape);
+    e.open = true;
+    e.first = i;
+    e.before_x.assign(1, from.x);
+    e.before_y.assign(1, from.y);
+    e.after_x.assign(1, to.x);
+    e.after_y.assign(1, to.y);
+    bytes_ += entry_bytes(e);
+    trim();
+}
+
+void journal::record_transform(int shape, const affine& t) {
+
+    entry& e = push(JOURNAL_TRANSFORM, shape);
+    e.t = t;
+    bytes_ += entry_bytes(e);
+    trim();
+}
+
+static void copy_outline(const shape_store& store, int shape, std::vector<double>& x, std::vector<double>& y) {
+
+    int n = store.size(shape);
+    x.resize(n);
+    y.resize(n);
+    for (int i=0; i<n; ++i) {
+        grid_point p = store.point(shape, i);
+        x[i] = p.x;
+        y[i] = p.y;
+    }
+}
+
+void journal::begin_rewrite(const shape_store& store, int shape) {
+
+    rewrite_shape_ = shape;
+    copy_outline(store, shape, rewrite_x_, rewrite_y_);
+}
+
+void journal::end_rewrite(const shape_store& store, int shape) {
+
+    if (rewrite_shape_ != shape) return;
+    rewrite_shape_ = -1;
+
+    std::vector<double> x, y;
+    copy_outline(store, shape, x, y);
+    const std::vector<double>& bx = rewrite_x_;
+    const std::vector<double>& by = rewrite_y_;
+
+    // Only what lies between the common start and the common end changed.
+    int nb = static_cast<int>(bx.size());
+    int na = static_cast<int>(x.size());
+    int head = 0;
+    while (head < nb && head < na && bx[head] == x[head] && by[head] == y[head]) {
+        head++;
+    }
+    int tail = 0;
+    while (tail < nb - head && tail < na - head
+           && bx[nb - 1 - tail] == x[na - 1 - tail] && by[nb - 1 - tail] == y[na - 1 - tail]) {
+        tail++;
+    }
+    if (head == nb && head == na) return;
+
+    // Whether the vertices left are some of the old ones, in order.
+    std::vector<int> runs;
+    int j = head;
+    for (int i=head; i<nb - tail; ++i) {
+        if (j < na - tail && bx[i] == x[j] && by[i] == y[j]) {
+            j++;
+        } else if (!runs.empty() && runs[runs.size() - 2] + runs.back() == i) {
+            runs.back()++;
+        } else {
+            runs.push_back(i);
+            runs.push_back(1);
+        }
+    }
+
+    if (j == na - tail) {
+        entry& e = push(JOURNAL_REMOVE, shape);
+        e.runs.swap(runs);
+        for (size_t r=0; r<e.runs.size(); r+=2) {
+            e.before_x.insert(e.before_x.end(), bx.begin() + e.runs[r], bx.begin() + e.runs[r] + e.runs[r + 1]);
+            e.before_y.insert(e.before_y.end(), by.begin() + e.runs[r], by.begin() + e.runs[r] + e.runs[r + 1]);
+        }
+    } else {
+        entry& e = push(JOURNAL_SPLICE, shape);
+        e.first = head;
+        e.before_x.assign(bx.begin() + head, bx.end() - tail);
+        e.before_y.assign(by.begin() + head, by.end() - tail);
+        e.after_x.assign(x.begin() + head, x.end() - tail);
+        e.after_y.assign(y.begin() + head, y.end() - tail);
+    }
+    bytes_ += entry_bytes(entries_.back());
+    trim();
+
+    std::vector<double>().swap(rewrite_x_);
+    std::vector<double>().swap(rewrite_y_);
+}
+
+void journal::close() {
+
+    if (!entries_.empty()) entries_.back().open = false;
+}
+
+void journal::begin_group() {
+
+    close();
+    group_size_ = 0;
+}
+
+void journal::end_group() {
+
+    group_size_ = -1;
+}
+
+// Vertices [first, first + count) of the shape become x, y. The common
+// part is moved in place, which keeps the store's incremental sums, and a
+// vertex more or less is inserted or erased. Anything bigger shifts the
+// tail once, through a whole new outline.
+static journal_change splice(shape_store& store, int shape, int first, int count,
+                             const std::vector<double>& x, const std::vector<double>& y) {
+
+    int n = static_cast<int>(x.size());
+    int common = std::min(count, n);
+    journal_change change = { shape, first, common, n - count, false };
+    if (n - count > 1 || count - n > 1) {
+        std::vector<double> ox, oy;
+        copy_outline(store, shape, ox, oy);
+        ox.erase(ox.begin() + first, ox.begin() + first + count);
+        oy.erase(oy.begin() + first, oy.begin() + first + count);
+        ox.insert(ox.begin() + first, x.begin(), x.end());
+        oy.insert(oy.begin() + first, y.begin(), y.end());
+        store.assign(shape, ox.data(), oy.data(), static_cast<int>(ox.size()));
+        change.first = 0;
+        change.count = -1;
+        change.delta = 0;
+        return change;
+    }
+
+    for (int i=0; i<common; ++i) {
+        grid_point p = { x[i], y[i] };
+        store.set_point(shape, first + i, p);
+    }
+    if (count > n) {
+        store.erase_point(shape, first + common);
+    } else if (n > count) {
+        grid_point p = { x[common], y[common] };
+        store.insert_point(shape, first + common, p);
+    }
+    return change;
+}
+
+// Drops runs from the shape, or with restore set puts the removed vertices
+// back into them. Either way every vertex after the first run shifts, so
+// the shape is rewritten as a whole.
+static journal_change remove_runs(shape_store& store, int shape, const std::vector<int>& runs,
+                                  const std::vector<double>& removed_x, const std::vector<double>& removed_y,
+                                  bool restore) {
+
+    std::vector<double> ox, oy;
+    copy_outline(store, shape, ox, oy);
+    std::vector<double> x, y;
+    size_t kept = 0;
+    size_t removed = 0;
+    int i = 0;
+    for (size_t r=0; r<runs.size(); r+=2) {
+        // Vertices before the run are kept, i counts the old outline.
+        int before = runs[r] - i;
+        if (restore) {
+            x.insert(x.end(), ox.begin() + kept, ox.begin() + kept + before);
+            y.insert(y.end(), oy.begin() + kept, oy.begin() + kept + before);
+            x.insert(x.end(), removed_x.begin() + removed, removed_x.begin() + removed + runs[r + 1]);
+            y.insert(y.end(), removed_y.begin() + removed, removed_y.begin() + removed + runs[r + 1]);
+            kept += before;
+        } else {
+            x.insert(x.end(), ox.begin() + i, ox.begin() + runs[r]);
+            y.insert(y.end(), oy.begin() + i, oy.begin() + runs[r]);
+        }
+        removed += runs[r + 1];
+        i = runs[r] + runs[r + 1];
+    }
+    size_t rest = restore ? kept : static_cast<size_t>(i);
+    x.insert(x.end(), ox.begin() + rest, ox.end());
+    y.insert(y.end(), oy.begin() + rest, oy.end());
+
+    store.assign(shape, x.data(), y.data(), static_cast<int>(x.size()));
+    journal_change change = { shape, 0, -1, 0, false };
+    return change;
+}
+
+static journal_change transform(shape_store& store, int shape, const affine& t) {
+
+    store.transform(shape, t);
+    store.apply_transform(shape);
+    journal_change change = { shape, 0, -1, 0, false };
+    return change;
+}
+
+journal_change journal::undo(shape_store& store) {
+
+    if (next_ == 0) {
+        journal_change none = { -1, 0, 0, 0, false };
+        return none;
+    }
+
+    entry& e = entries_[--next_];
+    e.open = false;
+    journal_change change;
+    if (e.kind == JOURNAL_TRANSFORM) {
+        change = transform(store, e.shape, e.t.inverse());
+    } else if (e.kind == JOURNAL_REMOVE) {
+        change = remove_runs(store, e.shape, e.runs, e.before_x, e.before_y, true);
+    } else {
+        change = splice(store, e.shape, e.first, static_cast<int>(e.after_x.size()), e.before_x, e.before_y);
+    }
+    change.joined = e.joined && next_ > 0;
+    return change;
+}
+
+journal_change journal::redo(shape_store& store) {
+
+    if (next_ == entries_.size()) {
+        journal_change none = { -1, 0, 0, 0, false };
+        return none;
+    }
+
+    entry& e = entries_[next_++];
+    journal_change change;
+    if (e.kind == JOURNAL_TRANSFORM) {
+        change = transform(store, e.shape, e.t);
+    } else if (e.kind == JOURNAL_REMOVE) {
+        change = remove_runs(store, e.shape, e.runs, e.before_x, e.before_y, false);
+    } else {
+        change = splice(store, e.shape, e.first, static_cast<int>(e.before_x.size()), e.after_x, e.after_y);
+    }
+    change.joined = next_ < entries_.size() && entries_[next_].joined;
+    return change;
+}
@@ -0,0 +1,105 @@
+#ifndef JOURNAL_H_
+#define JOURNAL_H_
+
+#include <stddef.h>
+#include <deque>
+#include <vector>
+
+#include "affine.h"
+#include "geometry.h"
+#include "shape_store.h"
+
+// What an undo or redo changed: vertices [first, first + count) of shape
+// moved, then delta vertices were inserted at first + count, or -delta
+// erased there. With count -1 the shape changed as a whole. shape is -1
+// when there was nothing to undo or redo. joined is set when the step goes
+// on: the next undo or redo belongs to the same group.
+struct journal_change {
+    int shape;
+    int first;
+    int count;
+    int delta;
+    bool joined;
+};
+
+// Undo and redo of shape edits. Entries are deltas, not snapshots: a
+// splice keeps the vertex range it replaced and what replaced it, a
+// removal keeps the vertices it dropped and where they were, a transform
+// keeps the map, whose inverse undoes it. Undoing or redoing an entry
+// touches only the vertices it changed, however big the document.
+//
+// Rewrites are stored by what differs: the outlines before and after are
+// trimmed to the range between their common start and end, and an outline
+// that only lost vertices, as simplifying does, becomes a removal.
+//
+// Edits are recorded by whoever makes them, as they make them.
+// Consecutive moves of the same vertex coalesce into one entry until
+// close() is called, so a whole drag is one step. Entries recorded between
+// begin_group() and end_group() are undone and redone together. Entries past the
+// undo position are dropped by the next record, and the oldest ones go
+// when the journal holds more than its byte limit.
+struct journal {
+    explicit journal(size_t max_bytes);
+
+    // Vertex i of shape was inserted, was erased (its old position in p),
+    // or moved from one position to another.
+    void record_insert(int shape, int i, const grid_point& p);
+    void record_erase(int shape, int i, const grid_point& p);
+    void record_move(int shape, int i, const grid_point& from, const grid_point& to);
+    // The shape went through t, as shape_store::apply_transform() does.
+    void record_transform(int shape, const affine& t);
+    // For edits that rewrite a shape as a whole: begin before, end after.
+    void begin_rewrite(const shape_store& store, int shape);
+    void end_rewrite(const shape_store& store, int shape);
+    // Ends coalescing, the next move starts an entry of its own.
+    void close();
+    void begin_group();
+    void end_group();
+
+    journal_change undo(shape_store& store);
+    journal_change redo(shape_store& store);
+
+    void set_max_bytes(size_t max_bytes);
+    int undo_count() const { return static_cast<int>(next_); }
+    int redo_count() const { return static_cast<int>(entries_.size() - next_); }
+    size_t bytes() const { return bytes_; }
+
+private:
+    enum entry_kind {
+        JOURNAL_SPLICE,
+        JOURNAL_REMOVE,
+        JOURNAL_TRANSFORM
+    };
+
+    struct entry {
+        entry_kind kind;
+        int shape;
+        bool open;              // a drag still moving this vertex
+        bool joined;            // same group as the entry before
+        // Splice: vertices [first, first + before) became after.
+        // Removal: before holds the vertices dropped from runs, pairs of
+        // first vertex and count in the outline as it was.
+        int first;
+        std::vector<double> before_x, before_y;
+        std::vector<double> after_x, after_y;
+        std::vector<int> runs;
+        // Transform.
+        affine t;
+    };
+
+    entry& push(entry_kind kind, int shape);
+    void trim();
+    static size_t entry_bytes(const entry& e);
+
+    std::deque<entry> entries_;
+    size_t next_;               // entries before it are applied
+    size_t bytes_;
+    size_t max_bytes_;
+    // Entries recorded since begin_group(), -1 outside a group.
+    int group_size_;
+    // Outline saved by begin_rewrite().
+    int rewrite_shape_;
+    std::vector<double> rewrite_x_, rewrite_y_;
+};
+
+#endif // JOURNAL_H_
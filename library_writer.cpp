@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "library_writer.h"
+#include "shape_library.h"
+
+static double now_ms() {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+library_writer::library_writer()
+: running_(false)
+, stopping_(false)
+, shape_count_(0)
+, submitted_batches_(0)
+, written_batches_(0)
+{
+    stats_.saves = 0;
+    stats_.failures = 0;
+    stats_.bytes_written = 0.0;
+    stats_.last_flush_ms = 0.0;
+    stats_.max_flush_ms = 0.0;
+}
+
+library_writer::~library_writer() {
+
+    stop();
+}
+
+void library_writer::start(const char* path, const shape_store& store, bool saved) {
+
+    if (running_) return;
+
+    path_ = path;
+    if (saved) {
+        shape_count_ = store.shape_count();
+        submitted_versions_.resize(shape_count_);
+        for (int k=0; k<shape_count_; ++k) {
+            shadow_.add_shape();
+            shadow_.assign(k, store.xs(k), store.ys(k), store.size(k));
+            submitted_versions_[k] = store.version(k);
+        }
+    }
+
+    running_ = true;
+    stopping_ = false;
+    thread_ = std::thread(&library_writer::run, this);
+}
+
+int library_writer::submit(const shape_store& store) {
+
+    if (!running_) return 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    int count = store.shape_count();
+    int known = static_cast<int>(submitted_versions_.size());
+    submitted_versions_.resize(count);
+
+    int dirty = 0;
+    for (int k=0; k<count; ++k) {
+        if (k < known && store.version(k) == submitted_versions_[k]) continue;
+
+        int n = store.size(k);
+        pending_shape& s = pending_[k];
+        s.x.assign(store.xs(k), store.xs(k) + n);
+        s.y.assign(store.ys(k), store.ys(k) + n);
+        submitted_versions_[k] = store.version(k);
+        dirty++;
+    }
+
+    // A failed save is retried with the next submit, even without changes.
+    if (dirty == 0 && count == shape_count_ && stats_.failures == 0) return 0;
+
+    shape_count_ = count;
+    submitted_batches_++;
+    wake_.notify_one();
+    return dirty;
+}
+
+void library_writer::flush() {
+
+    if (!running_) return;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return written_batches_ == submitted_batches_; });
+}
+
+void library_writer::stop() {
+
+    if (!running_) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+    running_ = false;
+}
+
+library_writer_stats library_writer::stats() {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void library_writer::run() {
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stopping_ || written_batches_ != submitted_batches_; });
+        // Whatever was submitted before stop() still gets written.
+        if (written_batches_ == submitted_batches_) break;
+
+        std::map<int, pending_shape> batch;
+        batch.swap(pending_);
+        int count = shape_count_;
+        unsigned long batch_id = submitted_batches_;
+        lock.unlock();
+
+        while (shadow_.shape_count() < count) {
+            shadow_.add_shape();
+        }
+        for (std::map<int, pending_shape>::const_iterator it = batch.begin(); it != batch.end(); ++it) {
+            const pending_shape& s = it->second;
+            shadow_.assign(it->first, s.x.data(), s.y.data(), static_cast<int>(s.x.size()));
+        }
+
+        double vertices = 0.0;
+        for (int k=0; k<count; ++k) {
+            vertices += shadow_.size(k);
+        }
+
+        double start = now_ms();
+        bool ok = library_write(path_.c_str(), shadow_);
+        double elapsed = now_ms() - start;
+        if (!ok) {
+            fprintf(stderr, "Could not write %s\n", path_.c_str());
+        }
+
+        lock.lock();
+        if (ok) {
+            stats_.saves++;
+            stats_.failures = 0;
+            stats_.bytes_written += sizeof(library_header) + count * sizeof(library_entry)
+                + 2.0 * vertices * sizeof(double);
+            stats_.last_flush_ms = elapsed;
+            if (elapsed > stats_.max_flush_ms) stats_.max_flush_ms = elapsed;
+        } else {
+            stats_.failures++;
+        }
+        written_batches_ = batch_id;
+        done_.notify_all();
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef LIBRARY_WRITER_H_
+#define LIBRARY_WRITER_H_
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shape_store.h"
+
+struct library_writer_stats {
+    int saves;
+    int failures;           // since the last successful save
+    double bytes_written;
+    double last_flush_ms;
+    double max_flush_ms;
+};
+
+// Saves the library on a background thread. The UI thread hands over the
+// shapes whose version changed since the last submit; copying those is all
+// it pays. The writer keeps its own copy of the whole document, merges the
+// handed over shapes into it and rewrites the library file through a
+// temporary file and a rename. Submits that arrive while a save is running
+// are merged into the next one.
+struct library_writer {
+    library_writer();
+    ~library_writer();
+
+    // With saved set, the current store contents count as already on disk;
+    // otherwise the first submit writes every shape.
+    void start(const char* path, const shape_store& store, bool saved);
+    // Queues changed shapes, returns how many. Pending transforms are not
+    // part of the committed coordinates and are picked up once applied.
+    int submit(const shape_store& store);
+    // Blocks until everything submitted so far is on disk.
+    void flush();
+    void stop();
+
+    library_writer_stats stats();
+
+    library_writer(const library_writer&) = delete;
+    library_writer& operator=(const library_writer&) = delete;
+
+private:
+    struct pending_shape {
+        std::vector<double> x;
+        std::vector<double> y;
+    };
+
+    void run();
+
+    std::string path_;
+    std::vector<unsigned> submitted_versions_;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    bool running_;
+    bool stopping_;
+    std::map<int, pending_shape> pending_;
+    int shape_count_;
+    unsigned long submitted_batches_;
+    unsigned long written_batches_;
+    library_writer_stats stats_;
+
+    // Writer thread only.
+    shape_store shadow_;
+};
+
+#endif // LIBRARY_WRITER_H_
@@ -3,13 +3,51 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <time.h>
 #include <GL/glut.h>
 
-#define SELECT_DISTANCE_SQ 0.04
-#define MAX_SHAPE_POINTS 16
+#include <algorithm>
+#include <vector>
+
+#include "affine.h"
+#include "batch.h"
+#include "document.h"
+#include "geometry.h"
+#include "hud.h"
+#include "journal.h"
+#include "library_writer.h"
+#include "mass_properties.h"
+#include "redraw.h"
+#include "render_cache.h"
+#include "selection.h"
+#include "self_intersection.h"
+#include "shape_library.h"
+#include "shape_store.h"
+#include "spatial_index.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "triangulate.h"
+#include "viewport.h"
+
+// Vertices are picked within this many pixels of the cursor.
+#define SELECT_DISTANCE_PIXELS 16.0
+#define INDEX_CELL_SIZE 0.5
+// The view starts out showing +-GRID_SIZE on a SCREEN_SIZE window.
 #define GRID_SIZE 10.0
 #define SCREEN_SIZE 1600
-#define MAX_SHAPES 16
+// Minor grid lines stay at least this many pixels apart, every tenth
+// line is a major one.
+#define GRID_MIN_PIXELS 12.0
+// View scale per wheel step or +/- key.
+#define VIEW_ZOOM_STEP 1.25
+#define MIN_SHAPES 16
+#define LIBRARY_FILE "shapes.polylib"
+#define AUTOSAVE_INTERVAL 2000
+#define TRACE_FILE "polyd-trace.json"
+// Undo history kept, in bytes.
+#define JOURNAL_MAX_BYTES (64 << 20)
+// Frame time at the top of the frame graph.
+#define FRAME_GRAPH_MS 33.3
 
 uint8_t move_and_rotate_mode_ = 0;
 bool move_shape_enable_ = false;
@@ -21,110 +59,196 @@ uint16_t dash_patterns_[kDashMax] = {
     0xf0f0, 0x7878, 0x3c3c, 0x1e1e, 0x0f0f, 0x8787, 0xc3c3, 0xe1e1
 };
 
-const uint8_t kMaxGridScaleIndex = 4;
-uint8_t grid_scale_index_ = 0;
-double grid_scale_factors_[kMaxGridScaleIndex] = {
-    1.0, 0.5, 0.2, 2.0
-};
+viewport view_(SCREEN_SIZE, SCREEN_SIZE, 2.0 * GRID_SIZE / SCREEN_SIZE);
+// The view the grid buffer was built for, minor lines first.
+grid_box grid_built_box_;
+double grid_built_spacing_ = 0.0;
+int grid_minor_count_ = 0;
 
 uint8_t debug_enable_ = 0;
 
-struct grid_point {
-    double distance_square(const grid_point& cursor) {
-        double dx = x - cursor.x;
-        double dy = y - cursor.y;
-        return (dx*dx + dy*dy);
-    }
-    double x;
-    double y;
-} cursor_on_grid;
+grid_point cursor_on_grid;
 
 struct screen_point {
     int x;
     int y;
 } cursor_on_screen;
 
-struct shape_point {
-    shape_point() : valid(false) {}
-    bool valid;
-    grid_point point;
-};
+// Middle button drags pan the view.
+bool pan_enable_ = false;
+screen_point pan_last_;
 
 int copy_shape_index_ = -1;
 int shape_index_ = 0;
-int shape_point_index = 0;
-shape_point shape[MAX_SHAPES][MAX_SHAPE_POINTS];
+document document_;
+shape_store& shapes_ = document_.shapes;
+shape_library library_;
+library_writer library_writer_;
+bool autosave_armed_ = false;
+vertex_index vertex_index_(INDEX_CELL_SIZE);
+journal journal_(JOURNAL_MAX_BYTES);
+int selected_shape_index_ = -1;
 int selected_point_index = -1;
+shape_buffers shape_buffers_;
+// The scene as last drawn, put back by frames that only change the HUD.
+frame_copy scene_copy_;
+vertex_buffer grid_buffer_;
 int move_point_index = -1;
 
 // 0 - none,
-// 1 - 1.00
-// 2 - 0.10
-// 3 - 0.01
+// 1 - Visvalingam, tolerance
+// 2 - Douglas-Peucker, tolerance
+// 3 - Visvalingam, target vertex count
 const uint8_t kSimplifyMax = 4;
+const int kSimplifyTargetMax = 1 << 24;
 uint8_t simplify_mode_ = 0;
-shape_point simplified_shape[MAX_SHAPE_POINTS];
-
-double area_[MAX_SHAPES] = {0};
-grid_point shape_center[MAX_SHAPES];
-int final_shape_size = 0;
-grid_point final_shape[MAX_SHAPE_POINTS];
-
-void render();
-void idle();
+double simplify_tolerance_ = 0.01;
+int simplify_target_ = 32;
+// Shape and version the preview was made from.
+int simplified_shape_ = -1;
+unsigned simplified_version_ = 0;
+std::vector<double> simplified_x_;
+std::vector<double> simplified_y_;
+vertex_buffer simplified_buffer_;
+
+// Convex pieces of the current shape, rebuilt when the shape, its version
+// or the vertex limit changes.
+const int kConvexLimitMin = 3;
+const int kConvexLimitMax = 16;
+bool convex_enable_ = false;
+int convex_limit_ = 8;
+convex_pieces convex_pieces_;
+int convex_shape_ = -1;
+unsigned convex_version_ = 0;
+int convex_built_limit_ = 0;
+bool convex_simple_ = true;
+double convex_ms_ = 0.0;
+vertex_buffer convex_buffer_;
+
+// Translucent fill of every shape from its cached triangles.
+bool fill_enable_ = false;
+shape_triangles shape_triangles_;
+
+// Edges of the current shape crossing other edges. A full sweep runs when
+// the shape or its version changed, dragging a vertex re-tests its edges.
+crossing_checker crossing_checker_;
+int crossing_shape_ = -1;
+unsigned crossing_version_ = 0;
+double crossing_ms_ = 0.0;
+
+std::vector<double> area_;
+std::vector<grid_point> shape_center;
+// Inertia, bounds and hull for the debug panel and export.
+shape_properties shape_properties_;
+
+// Shapes picked with shift-clicks and shift-drags. While any are picked,
+// moves, rotations, flips, centering and simplifying act on all of them
+// instead of the current shape, spread over pool_ when there is enough
+// work. Each commit of theirs is one undo step.
+shape_selection selection_;
+thread_pool pool_;
+double selection_ms_ = 0.0;
+// Shift-drag rubber band, from band_start_ to the cursor.
+bool band_enable_ = false;
+grid_point band_start_;
+
+void render(unsigned layers);
+void render_scene();
+void update_convex_pieces();
+void update_crossings();
+void move_crossing_vertex(int i);
+void advance_dash();
+void update_animation();
 void mouse(int button, int state, int x, int y);
 void motion(int x, int y);
+void process_motion();
 void keyboard(unsigned char key, int x, int y);
+int add_shape();
+void sync_shape_slots();
+void clear_selection();
+void focus_selected_shape();
+void shape_modified(int shape);
+void build_grid_buffer();
+void zoom_view(int x, int y, double factor);
+void reset_view();
 void add_point_to_current_shape();
 void update_center();
 void move_shape_to_center();
 void preview_simplified_shape();
 void simplify_shape();
+void adjust_simplify(bool coarser);
 void write_shape();
 void read_shape();
+void undo_edit(bool redo);
+void save_library();
+void schedule_autosave();
 void quit_application();
+void toggle_tracing();
+void dump_trace();
+void render_frame_graph();
 void load_shapes();
 void flip_x_values();
 void flip_y_values();
 void paste_copied_shape(bool at_target);
+void combine_with_copied_shape(boolean_op op);
 void move_shape_with_mouse();
 void rotate_shape_with_mouse();
 void rotate_shape_by(double angle);
+int shape_at(const grid_point& p);
+void finish_selection_band();
+void commit_selection();
+void simplify_selection();
 
 double start_angle_ = 0.0;
 double rotate_angle_ = 0.0;
 void rotate_shape_start_angle();
 
+// Shape being moved or rotated with the mouse, and its center when the
+// gesture started. The gesture only sets the shape's pending transform.
+// Picked shapes move together instead, all with the same transform, from
+// where the cursor was and around the middle of their bounds.
+int gesture_shape_ = -1;
+bool gesture_selection_ = false;
+grid_point gesture_center_;
+grid_point gesture_anchor_;
+void begin_shape_gesture();
+void end_shape_gesture();
+void commit_transform(int shape);
+
 #define MAX_TEXT_BUFFER 256
 char text_buffer[MAX_TEXT_BUFFER];
 void text_print(int x, int y, const char* format, ...) {
-    memset(text_buffer, 0, MAX_TEXT_BUFFER);
     va_list args;
     va_start(args, format);
     vsnprintf(text_buffer, MAX_TEXT_BUFFER, format, args);
     va_end(args);
 
-    void* font = GLUT_BITMAP_9_BY_15;
-
-    glRasterPos2i(x, y);
-    for (unsigned int i=0; i<sizeof(text_buffer); ++i) {
-        glutBitmapCharacter(font, text_buffer[i]);
-    }
+    hud_print(x, y, text_buffer);
 }
 
 void display(void) {
 
+    uint64_t frame_begin = trace_clock_ns();
+
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	render();
+    // Motion first, so its damage counts for this frame.
+    process_motion();
+    unsigned layers = redraw_begin_frame();
+
+	render(layers);
 
+    // Swapping may wait for the display, which is not work of the frame.
+    trace_frame(frame_begin, trace_clock_ns());
+    TRACE_SCOPE("swap");
 	glutSwapBuffers();
-	glutPostRedisplay();
 }
 
 void reshape(int width, int height) {
 
 	glViewport(0, 0, width, height);
+    view_.resize(width, height);
+    scene_copy_.invalidate();
 }
 
 void init(void) {
@@ -140,20 +264,15 @@ void init(void) {
     glutMotionFunc(motion);
     glutPassiveMotionFunc(motion);
 	glutReshapeFunc(reshape);
-	glutIdleFunc(idle);
 
 	glClearColor(0.0, 0.0, 0.0, 0.0);
 }
 
 void grid_mode() {
+    grid_box b = view_.visible();
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    glOrtho(
-        -grid_scale_factors_[grid_scale_index_] * GRID_SIZE,
-        +grid_scale_factors_[grid_scale_index_] * GRID_SIZE,
-        -grid_scale_factors_[grid_scale_index_] * GRID_SIZE,
-        +grid_scale_factors_[grid_scale_index_] * GRID_SIZE,
-        -1.0, 1.0);
+    glOrtho(b.min.x, b.max.x, b.min.y, b.max.y, -1.0, 1.0);
     glMatrixMode(GL_MODELVIEW);
 }
 
@@ -166,6 +285,11 @@ void ui_mode() {
 
 int main(int argc, char** argv) {
 
+    // Batch runs need no display, so they go before GLUT is touched.
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+        return batch_main(argc - 1, argv + 1);
+    }
+
     int screen_size = SCREEN_SIZE;
 
 	glutInit(&argc, argv);
@@ -194,30 +318,64 @@ void render_axes() {
     } else {
         glColor3f(0.0, 0.0, 1.0);
     }
+    grid_box b = view_.visible();
     glBegin(GL_LINES);
-        glVertex2d(-GRID_SIZE, 0.0);
-        glVertex2d( GRID_SIZE, 0.0);
-        glVertex2d( 0.0, -GRID_SIZE);
-        glVertex2d( 0.0,  GRID_SIZE);
+        glVertex2d(b.min.x, 0.0);
+        glVertex2d(b.max.x, 0.0);
+        glVertex2d(0.0, b.min.y);
+        glVertex2d(0.0, b.max.y);
     glEnd();
 }
 
 void render_grid() {
 
+    TRACE_SCOPE("render_grid");
+
+    build_grid_buffer();
+
+    // Major lines over the minor ones, each tenth line is both.
+    float r = edit_mode_ != 0 ? 1.0f : 0.0f;
+    float b = edit_mode_ != 0 ? 0.0f : 1.0f;
     glLineWidth(1.0);
-    if (edit_mode_ != 0) {
-        glColor4f(1.0, 0.0, 0.0, 0.4);
-    } else {
-        glColor4f(0.0, 0.0, 1.0, 0.4);
+    grid_buffer_.bind();
+    glColor4f(r, 0.0f, b, 0.2f);
+    glDrawArrays(GL_LINES, 0, grid_minor_count_);
+    glColor4f(r, 0.0f, b, 0.4f);
+    glDrawArrays(GL_LINES, grid_minor_count_, grid_buffer_.size() - grid_minor_count_);
+    grid_buffer_.unbind();
+}
+
+// Lines at multiples of spacing across the box.
+static void add_grid_lines(const grid_box& b, double spacing, std::vector<double>& x, std::vector<double>& y) {
+
+    for (double s=ceil(b.min.y / spacing); s*spacing<=b.max.y; s+=1.0) {
+        x.push_back(b.min.x); y.push_back(s * spacing);
+        x.push_back(b.max.x); y.push_back(s * spacing);
     }
-    glBegin(GL_LINES);
-    for (double s=-GRID_SIZE; s<=GRID_SIZE; s+=1.0) {
-        glVertex2d(-GRID_SIZE, s);
-        glVertex2d( GRID_SIZE, s);
-        glVertex2d( s, -GRID_SIZE);
-        glVertex2d( s,  GRID_SIZE);
+    for (double s=ceil(b.min.x / spacing); s*spacing<=b.max.x; s+=1.0) {
+        x.push_back(s * spacing); y.push_back(b.min.y);
+        x.push_back(s * spacing); y.push_back(b.max.y);
     }
-    glEnd();
+}
+
+// Rebuilt when the view moved. The spacing follows the zoom, so there are
+// never more than the window size over GRID_MIN_PIXELS lines per axis.
+void build_grid_buffer() {
+
+    grid_box b = view_.visible();
+    double spacing = grid_spacing(view_.pixel_size(), GRID_MIN_PIXELS);
+    if (spacing == grid_built_spacing_ && b.min.x == grid_built_box_.min.x && b.min.y == grid_built_box_.min.y
+        && b.max.x == grid_built_box_.max.x && b.max.y == grid_built_box_.max.y) return;
+
+    std::vector<double> x;
+    std::vector<double> y;
+    add_grid_lines(b, spacing, x, y);
+    grid_minor_count_ = static_cast<int>(x.size());
+    add_grid_lines(b, 10.0 * spacing, x, y);
+    grid_buffer_.upload(x.data(), y.data(), static_cast<int>(x.size()));
+
+    grid_built_box_ = b;
+    grid_built_spacing_ = spacing;
 }
 
 void render_panel_frame(int top, int left, int width, int height) {
@@ -253,6 +411,8 @@ void render_shape_index() {
 
 void render_cursor_position() {
 
+    TRACE_SCOPE("render_cursor_position");
+
     // Background color
     glColor4f(0.0, 0.0, 0.0, 0.8);
     glPushAttrib(GL_COLOR_BUFFER_BIT);
@@ -289,21 +449,58 @@ void render_vertice_position() {
     glPushAttrib(GL_COLOR_BUFFER_BIT);
     render_panel_frame(10, (SCREEN_SIZE>>1) - 90, 180, 40);
 
-    grid_point* sp = &shape[shape_index_][selected_point_index].point;
+    grid_point sp = shapes_.point(selected_shape_index_, selected_point_index);
     glColor3f(0.8, 1.0, 0.8);
-    text_print((SCREEN_SIZE>>1) - 90, 30, "%+8.4f, %+8.4f", sp->x, sp->y);
+    text_print((SCREEN_SIZE>>1) - 90, 30, "%+8.4f, %+8.4f", sp.x, sp.y);
 }
 
 void render_debug_panel() {
 
     if (debug_enable_ == 0) return;
 
+    TRACE_SCOPE("render_debug_panel");
+
     // Background color
     glColor4f(0.0, 0.0, 1.0, 0.5);
     glPushAttrib(GL_COLOR_BUFFER_BIT);
-    render_panel_frame(SCREEN_SIZE - 110, 10, 400, 100);
+    render_panel_frame(SCREEN_SIZE - 330, 10, 400, 320);
 
+    library_writer_stats saved = library_writer_.stats();
+    const mass_properties& mass = shape_properties_.mass(shapes_, shape_index_);
+    const shape_draw_stats& drawn = shape_buffers_.stats();
     glColor3f(1.0, 1.0, 1.0);
+    text_print(20, SCREEN_SIZE - 310, "Select  : %d shapes, %.2f ms last commit, %d threads",
+        selection_.count(), selection_ms_, pool_.size());
+    if (fill_enable_) {
+        text_print(20, SCREEN_SIZE - 290, "Fill    : %d triangles%s",
+            static_cast<int>(shape_triangles_.triangles(shapes_, shape_index_).size() / 3),
+            shape_triangles_.simple(shapes_, shape_index_) ? "" : ", not simple");
+    } else {
+        text_print(20, SCREEN_SIZE - 290, "Fill    : off");
+    }
+    text_print(20, SCREEN_SIZE - 270, "Motion  : %3d/s received, %3d/s processed",
+        redraw_motion_received_per_second(), redraw_motion_processed_per_second());
+    text_print(20, SCREEN_SIZE - 250, "Undo    : %d steps, %d redo, %.2f MB",
+        journal_.undo_count(), journal_.redo_count(), journal_.bytes() / (1024.0 * 1024.0));
+    text_print(20, SCREEN_SIZE - 230, "View    : %.3g/px, grid %g; %d drawn, %d culled, %d decimated",
+        view_.pixel_size(), grid_built_spacing_, drawn.drawn, drawn.culled, drawn.decimated);
+    text_print(20, SCREEN_SIZE - 210, "Inertia : %10.4f, hull of %d",
+        mass.polar_inertia(), static_cast<int>(shape_properties_.hull(shapes_, shape_index_).size()));
+    text_print(20, SCREEN_SIZE - 190, "Bounds  : %+10.4f %+10.4f .. %+10.4f %+10.4f",
+        mass.min.x, mass.min.y, mass.max.x, mass.max.y);
+    text_print(20, SCREEN_SIZE - 170, "Crossing: %d of %d edges, %.3f ms",
+        crossing_checker_.crossing_count(), crossing_checker_.edge_count(), crossing_ms_);
+    if (convex_enable_) {
+        text_print(20, SCREEN_SIZE - 150, "Convex  : %d pieces of <= %d, %.2f ms%s",
+            convex_pieces_.count(), convex_built_limit_, convex_ms_, convex_simple_ ? "" : ", not simple");
+    } else {
+        text_print(20, SCREEN_SIZE - 150, "Convex  : off");
+    }
+    text_print(20, SCREEN_SIZE - 130, "Saves   : %d, %.2f MB, %.1f ms last, %.1f ms max",
+        saved.saves, saved.bytes_written / (1024.0 * 1024.0), saved.last_flush_ms, saved.max_flush_ms);
+    text_print(20, SCREEN_SIZE - 110, "Frames  : %3d/s, %3d/s skipped, %3d/s coalesced, %d text builds",
+        redraw_frames_per_second(), redraw_skipped_per_second(), redraw_coalesced_per_second(),
+        hud_rebuild_count());
     if (selected_point_index != -1) {
         text_print(20, SCREEN_SIZE - 90, "Selected: %d", selected_point_index);
     } else {
@@ -313,35 +510,73 @@ void render_debug_panel() {
     text_print(20, SCREEN_SIZE - 70, "Area    : %10.4f", area_[shape_index_]);
     text_print(20, SCREEN_SIZE - 50, "Center  : %+10.4f %+10.4f", shape_center[shape_index_].x, shape_center[shape_index_].y);
     text_print(20, SCREEN_SIZE - 30, "Rotation: %6.1f", rotate_angle_ * 180.0 / M_PI);
+
+    render_frame_graph();
 }
 
-void render_shape() {
+// Work time of recent frames above the debug panel, one bar per frame, the
+// newest on the right. The line marks a 60 Hz frame.
+void render_frame_graph() {
 
-    glLineWidth(3.0);
+    glColor4f(0.0, 0.0, 1.0, 0.5);
+    glPushAttrib(GL_COLOR_BUFFER_BIT);
+    render_panel_frame(SCREEN_SIZE - 430, 10, 400, 90);
 
-    for (int k=0; k<MAX_SHAPES; ++k) {
-        if (k == shape_index_) continue;
+    float ms[TRACE_FRAMES];
+    int count = trace_frame_times(ms, TRACE_FRAMES);
+    float worst = 0.0f;
+    for (int k=0; k<count; ++k) {
+        worst = std::max(worst, ms[k]);
+    }
+    glColor3f(1.0, 1.0, 1.0);
+    text_print(20, SCREEN_SIZE - 410, "Frame   : %6.2f ms, %6.2f ms max; trace %s, %llu events",
+        count > 0 ? ms[count - 1] : 0.0f, worst, trace_enabled_.load() ? "on" : "off",
+        static_cast<unsigned long long>(trace_event_count()));
 
-        if (copy_shape_index_ == k) {
-            glEnable(GL_LINE_STIPPLE);
-            glLineStipple(1, dash_patterns_[dash_index_]);
-        }
-        else {
-            glDisable(GL_LINE_STIPPLE);
+    int base = SCREEN_SIZE - 345;
+    double scale = 55.0 / FRAME_GRAPH_MS;
+    int left = 20 + 3 * (TRACE_FRAMES - count);
+    glLineWidth(2.0);
+    glBegin(GL_LINES);
+    for (int k=0; k<count; ++k) {
+        if (ms[k] > FRAME_GRAPH_MS / 2) {
+            glColor3f(1.0, 0.3, 0.3);
+        } else {
+            glColor3f(0.3, 1.0, 0.3);
         }
+        double height = std::min(static_cast<double>(ms[k]), FRAME_GRAPH_MS) * scale;
+        glVertex2d(left + 3 * k, base);
+        glVertex2d(left + 3 * k, base - height);
+    }
+    glColor4f(1.0, 1.0, 1.0, 0.5);
+    glVertex2d(20, base - FRAME_GRAPH_MS / 2 * scale);
+    glVertex2d(20 + 3 * TRACE_FRAMES, base - FRAME_GRAPH_MS / 2 * scale);
+    glEnd();
+}
 
-        glColor3f(0.5, 0.5, 0.5);
-        glBegin(GL_LINE_LOOP);
-        for (int i=0; i<MAX_SHAPE_POINTS; ++i) {
-            if (shape[k][i].valid) {
-                glVertex2d(shape[k][i].point.x, shape[k][i].point.y);
-            }
-        }
-        glEnd();
+void render_shape() {
 
-        if (copy_shape_index_ == k) {
-            glDisable(GL_LINE_STIPPLE);
-        }
+    TRACE_SCOPE("render_shape");
+
+    shape_buffers_.sync(shapes_);
+
+    glLineWidth(3.0);
+
+    // Every other shape in one go, the copy source is drawn on its own.
+    glDisable(GL_LINE_STIPPLE);
+    glColor3f(0.5, 0.5, 0.5);
+    shape_buffers_.draw_loops(shapes_, shape_index_, copy_shape_index_, view_.visible(), view_.pixel_size());
+
+    if (!selection_.empty()) {
+        glColor3f(1.0, 0.8, 0.2);
+        shape_buffers_.draw_loops(shapes_, selection_.shapes(), view_.visible(), view_.pixel_size());
+    }
+
+    if (copy_shape_index_ != -1 && copy_shape_index_ != shape_index_) {
+        glEnable(GL_LINE_STIPPLE);
+        glLineStipple(1, dash_patterns_[dash_index_]);
+        shape_buffers_.draw_loop(shapes_, copy_shape_index_);
+        glDisable(GL_LINE_STIPPLE);
     }
 
     if (copy_shape_index_ == shape_index_) {
@@ -352,14 +587,9 @@ void render_shape() {
         glDisable(GL_LINE_STIPPLE);
     }
 
+    int n = shapes_.size(shape_index_);
     glColor3f(1.0, 1.0, 1.0);
-    glBegin(GL_LINE_LOOP);
-    for (int i=0; i<MAX_SHAPE_POINTS; ++i) {
-        if (shape[shape_index_][i].valid) {
-            glVertex2d(shape[shape_index_][i].point.x, shape[shape_index_][i].point.y);
-        }
-    }
-    glEnd();
+    shape_buffers_.draw_loop(shapes_, shape_index_);
 
     if (copy_shape_index_ == shape_index_) {
          glDisable(GL_LINE_STIPPLE);
@@ -367,46 +597,197 @@ void render_shape() {
 
     if (edit_mode_ == 0) return;
 
-    bool first_vertice = false;
-    for (int i=0; i<MAX_SHAPE_POINTS; ++i) {
-        if (shape[shape_index_][i].valid) {
-            if (!first_vertice) {
-                first_vertice = true;
-                glPointSize(10.0);
-                glColor3f(0.0, 1.0, 1.0);
-            } else {
-                glPointSize(10.0);
-                glColor3f(0.0, 0.5, 1.0);
-            }
-            if (selected_point_index == i) {
-                glPointSize(15.0);
-                glColor3f(1.0, 0.0, 1.0);
-            }
+    glPointSize(10.0);
+    glColor3f(0.0, 0.5, 1.0);
+    shape_buffers_.draw_points(shapes_, shape_index_, 1, n - 1);
+    glColor3f(0.0, 1.0, 1.0);
+    shape_buffers_.draw_points(shapes_, shape_index_, 0, n > 0 ? 1 : 0);
 
-            glBegin(GL_POINTS);
-            glVertex2d(shape[shape_index_][i].point.x, shape[shape_index_][i].point.y);
-            glEnd();
-        }
+    if (selected_point_index != -1) {
+        glPointSize(15.0);
+        glColor3f(1.0, 0.0, 1.0);
+        shape_buffers_.draw_points(shapes_, selected_shape_index_, selected_point_index, 1);
     }
 }
-void render_simplified_shape() {
+
+void render_simplify_status() {
 
     if (simplify_mode_ == 0) return;
 
+    TRACE_SCOPE("render_simplify_status");
+
+    // Background color
+    glColor4f(0.0, 0.4, 0.0, 0.8);
+    glPushAttrib(GL_COLOR_BUFFER_BIT);
+    render_panel_frame(10, SCREEN_SIZE - 370, 360, 40);
+
+    glColor3f(0.8, 1.0, 0.8);
+    int n = shapes_.size(shape_index_);
+    int kept = static_cast<int>(simplified_x_.size());
+    if (simplify_mode_ == 3) {
+        text_print(SCREEN_SIZE - 360, 35, "Visvalingam to %d: %d -> %d", simplify_target_, n, kept);
+    } else {
+        simplify_method method = (simplify_mode_ == 2) ? SIMPLIFY_DOUGLAS_PEUCKER : SIMPLIFY_VISVALINGAM;
+        text_print(SCREEN_SIZE - 360, 35, "%s %.4g: %d -> %d",
+            simplify_method_name(method), simplify_tolerance_, n, kept);
+    }
+}
+
+static double now_ms() {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+void update_convex_pieces() {
+
+    TRACE_SCOPE("update_convex_pieces");
+
+    if (convex_shape_ == shape_index_ && convex_version_ == shapes_.version(shape_index_)
+        && convex_built_limit_ == convex_limit_) return;
+
+    double start = now_ms();
+    convex_simple_ = document_.decompose(shape_index_, convex_limit_, convex_pieces_);
+    convex_ms_ = now_ms() - start;
+
+    convex_shape_ = shape_index_;
+    convex_version_ = shapes_.version(shape_index_);
+    convex_built_limit_ = convex_limit_;
+
+    // Committed coordinates, piece after piece.
+    const shape_store& store = shapes_;
+    const double* px = store.xs(shape_index_);
+    const double* py = store.ys(shape_index_);
+    std::vector<double> x(convex_pieces_.indices.size());
+    std::vector<double> y(convex_pieces_.indices.size());
+    for (size_t i=0; i<x.size(); ++i) {
+        x[i] = px[convex_pieces_.indices[i]];
+        y[i] = py[convex_pieces_.indices[i]];
+    }
+    convex_buffer_.upload(x.data(), y.data(), static_cast<int>(x.size()));
+}
+
+void update_crossings() {
+
+    if (crossing_shape_ == shape_index_ && crossing_version_ == shapes_.version(shape_index_)) return;
+
+    TRACE_SCOPE("update_crossings");
+
+    const shape_store& store = shapes_;
+    double start = now_ms();
+    crossing_checker_.check(store.xs(shape_index_), store.ys(shape_index_), store.size(shape_index_));
+    crossing_ms_ = now_ms() - start;
+
+    crossing_shape_ = shape_index_;
+    crossing_version_ = shapes_.version(shape_index_);
+}
+
+// Vertex i of the current shape was just dragged.
+void move_crossing_vertex(int i) {
+
+    TRACE_SCOPE("move_crossing_vertex");
+
+    const shape_store& store = shapes_;
+    double start = now_ms();
+    crossing_checker_.move_vertex(store.xs(shape_index_), store.ys(shape_index_), store.size(shape_index_), i);
+    crossing_ms_ = now_ms() - start;
+
+    crossing_version_ = shapes_.version(shape_index_);
+}
+
+void render_convex_pieces() {
+
+    if (!convex_enable_) return;
+
+    TRACE_SCOPE("render_convex_pieces");
+
+    update_convex_pieces();
+
     glLineWidth(1.0);
-    glColor3f(0.0, 1.0, 0.0);
+    push_shape_transform(shapes_, shape_index_);
+    convex_buffer_.bind();
+    for (int k=0; k<convex_pieces_.count(); ++k) {
+        float shade = (k % 3) * 0.25f;
+        glColor4f(1.0f - shade, 0.5f, shade, 0.25f);
+        glDrawArrays(GL_TRIANGLE_FAN, convex_pieces_.first[k], convex_pieces_.size(k));
+        glColor4f(1.0f - shade, 0.5f, shade, 0.8f);
+        glDrawArrays(GL_LINE_LOOP, convex_pieces_.first[k], convex_pieces_.size(k));
+    }
+    convex_buffer_.unbind();
+    glPopMatrix();
+}
+
+void render_shape_fills() {
+
+    if (!fill_enable_) return;
+
+    TRACE_SCOPE("render_shape_fills");
+
+    shape_buffers_.sync(shapes_);
+    glColor4f(0.3f, 0.6f, 1.0f, 0.25f);
+    shape_buffers_.draw_fills(shapes_, shape_triangles_, view_.visible());
+}
+
+void render_selection_band() {
+
+    if (!band_enable_) return;
+
+    glLineWidth(1.0);
+    glEnable(GL_LINE_STIPPLE);
+    glLineStipple(1, 0xf0f0);
+    glColor3f(1.0, 0.8, 0.2);
     glBegin(GL_LINE_LOOP);
-    for (int i=0; i<MAX_SHAPE_POINTS; ++i) {
-        if (simplified_shape[i].valid) {
-            glVertex2d(simplified_shape[i].point.x, simplified_shape[i].point.y);
-        }
+        glVertex2d(band_start_.x, band_start_.y);
+        glVertex2d(cursor_on_grid.x, band_start_.y);
+        glVertex2d(cursor_on_grid.x, cursor_on_grid.y);
+        glVertex2d(band_start_.x, cursor_on_grid.y);
+    glEnd();
+    glDisable(GL_LINE_STIPPLE);
+}
+
+void render_crossing_edges() {
+
+    TRACE_SCOPE("render_crossing_edges");
+
+    update_crossings();
+    if (crossing_checker_.simple()) return;
+
+    const shape_store& store = shapes_;
+    const double* px = store.xs(shape_index_);
+    const double* py = store.ys(shape_index_);
+    int n = store.size(shape_index_);
+
+    glLineWidth(5.0);
+    glColor4f(1.0, 0.0, 0.0, 0.8);
+    push_shape_transform(shapes_, shape_index_);
+    glBegin(GL_LINES);
+    for (int i=0; i<n; ++i) {
+        if (!crossing_checker_.crossing(i)) continue;
+        int j = (i + 1) % n;
+        glVertex2d(px[i], py[i]);
+        glVertex2d(px[j], py[j]);
     }
     glEnd();
+    glPopMatrix();
+}
+
+void render_simplified_shape() {
+
+    if (simplify_mode_ == 0) return;
+
+    TRACE_SCOPE("render_simplified_shape");
+
+    glLineWidth(1.0);
+    glColor3f(0.0, 1.0, 0.0);
+    simplified_buffer_.bind();
+    glDrawArrays(GL_LINE_LOOP, 0, simplified_buffer_.size());
+    simplified_buffer_.unbind();
 }
 
 void render_shape_center() {
 
-    if (final_shape_size < 3) return;
+    if (shapes_.size(shape_index_) < 3) return;
 
     const double c_size = 0.25;
     glLineWidth(1.0);
@@ -440,8 +821,13 @@ void render_vertice_order() {
 
     double a = 0.0;
     double da = 0.0;
+    // A crossing outline has no single winding, the arrow turns red.
     glLineWidth(2.0);
-    glColor3f(0.0, 0.7, 0.0);
+    if (crossing_checker_.simple()) {
+        glColor3f(0.0, 0.7, 0.0);
+    } else {
+        glColor3f(1.0, 0.0, 0.0);
+    }
     glBegin(GL_LINE_STRIP);
     for (a=0.25*M_PI; a<=0.75*M_PI; a+=0.1) {
         glVertex2d(c->x + 0.2 * cos(a), c->y + 0.2 * sin(a));
@@ -462,34 +848,79 @@ void render_vertice_order() {
     glEnd();
 }
 
-void render() {
+// Frames that damaged neither the scene nor its animation, such as the
+// cursor moving over empty grid, copy the last scene back and only draw
+// the HUD over it.
+void render(unsigned layers) {
+
+    if ((layers & (REDRAW_SCENE | REDRAW_ANIMATION)) != 0
+        || !scene_copy_.restore(view_.width(), view_.height())) {
+        render_scene();
+        scene_copy_.save(view_.width(), view_.height());
+    }
+
+    ui_mode();
+
+    TRACE_SCOPE("render_hud");
+    render_cursor_position();
+    render_debug_panel();
+    render_vertice_position();
+    render_simplify_status();
+    render_operation_mode();
+    render_shape_index();
+}
+
+void render_scene() {
+
+    TRACE_SCOPE("render_scene");
 
     grid_mode();
 
     render_axes();
     render_grid();
+    render_convex_pieces();
+    render_shape_fills();
     render_shape();
+    render_selection_band();
+    render_crossing_edges();
     render_simplified_shape();
     render_shape_center();
     render_rotation_guide();
     render_vertice_order();
-
-    ui_mode();
-
-    render_cursor_position();
-    render_debug_panel();
-    render_vertice_position();
-    render_operation_mode();
-    render_shape_index();
 }
 
 void mouse(int button, int state, int x, int y) {
 
+    // A click acts where the cursor is now, not where the last frame saw it.
+    process_motion();
+
+    // The wheel reports as buttons 3 and 4, pressed and released.
+    if ((button == 3 || button == 4) && state == GLUT_DOWN) {
+        zoom_view(x, y, button == 3 ? VIEW_ZOOM_STEP : 1.0 / VIEW_ZOOM_STEP);
+        return;
+    }
+    if (button == GLUT_MIDDLE_BUTTON) {
+        pan_enable_ = (state == GLUT_DOWN);
+        pan_last_.x = x;
+        pan_last_.y = y;
+        return;
+    }
+
     if (edit_mode_ == 0) return;
 
+    TRACE_SCOPE("mouse");
+
+    redraw_request(REDRAW_SCENE | REDRAW_HUD);
+
     if (button == GLUT_LEFT_BUTTON) {
         if (state == GLUT_DOWN) {
-            if (move_and_rotate_mode_) {
+            if (glutGetModifiers() & GLUT_ACTIVE_SHIFT) {
+                // Shift picks shapes, by a click or a band dragged around them.
+                band_enable_ = true;
+                band_start_ = cursor_on_grid;
+            }
+            else if (move_and_rotate_mode_) {
+                begin_shape_gesture();
                 move_shape_enable_ = true;
                 rotate_shape_enable_ = false;
             }
@@ -500,104 +931,223 @@ void mouse(int button, int state, int x, int y) {
                 }
                 else {
                     // Move point, if one is selected.
+                    focus_selected_shape();
                     move_point_index = selected_point_index;
                 }
             }
         }
         else if (state == GLUT_UP) {
-            if (move_and_rotate_mode_) {
+            if (band_enable_) {
+                finish_selection_band();
+            }
+            else if (move_and_rotate_mode_) {
+                end_shape_gesture();
                 move_shape_enable_ = false;
                 rotate_shape_enable_ = false;
                 move_and_rotate_mode_ = 0;
             }
             else {
                 move_point_index = -1;
+                journal_.close();
             }
         }
     }
     else if (button == GLUT_RIGHT_BUTTON) {
         if (state == GLUT_DOWN) {
             if (move_and_rotate_mode_) {
+                begin_shape_gesture();
                 rotate_shape_start_angle();
                 rotate_shape_enable_ = true;
                 move_shape_enable_ = false;
             }
             else {
-                // Delete (disable) selected point, if any.
+                // Delete selected point, if any.
                 if (selected_point_index != -1) {
-                    shape[shape_index_][selected_point_index].valid = false;
+                    focus_selected_shape();
+                    journal_.record_erase(shape_index_, selected_point_index,
+                                          shapes_.point(shape_index_, selected_point_index));
+                    shapes_.erase_point(shape_index_, selected_point_index);
+                    vertex_index_.erase_point(shape_index_, selected_point_index);
+                    clear_selection();
                     update_center();
                 }
             }
         }
         else if (state == GLUT_UP) {
             if (move_and_rotate_mode_) {
+                end_shape_gesture();
                 rotate_shape_enable_ = false;
                 move_shape_enable_ = false;
                 move_and_rotate_mode_ = 0;
             }
         }
     }
+
+    update_animation();
+    schedule_autosave();
 }
 
 void calculate_cursor_on_grid() {
 
-    cursor_on_grid.x = 2.0 * GRID_SIZE * cursor_on_screen.x / SCREEN_SIZE - GRID_SIZE;
-    cursor_on_grid.y = -2.0 * GRID_SIZE * cursor_on_screen.y / SCREEN_SIZE + GRID_SIZE;
+    cursor_on_grid = view_.to_grid(cursor_on_screen.x, cursor_on_screen.y);
+}
+
+void zoom_view(int x, int y, double factor) {
 
-    cursor_on_grid.x *= grid_scale_factors_[grid_scale_index_];
-    cursor_on_grid.y *= grid_scale_factors_[grid_scale_index_];
+    view_.zoom_at(x, y, factor);
+    calculate_cursor_on_grid();
+    redraw_request(REDRAW_SCENE | REDRAW_HUD);
+}
+
+void reset_view() {
+
+    view_.reset(2.0 * GRID_SIZE / SCREEN_SIZE);
+    calculate_cursor_on_grid();
 }
 
 void find_selected_point() {
 
-    selected_point_index = -1;
-    for (int i=0; i<MAX_SHAPE_POINTS; ++i) {
-        if (shape[shape_index_][i].valid == false) continue;
-        double r2 = shape[shape_index_][i].point.distance_square(cursor_on_grid);
-        double sc2 = grid_scale_factors_[grid_scale_index_];
-        sc2 *= sc2;
-        if (r2 <= SELECT_DISTANCE_SQ * sc2) {
-            selected_point_index = i;
-            break;
-        }
+    TRACE_SCOPE("find_selected_point");
+
+    double radius = SELECT_DISTANCE_PIXELS * view_.pixel_size();
+    if (!vertex_index_.nearest(cursor_on_grid, radius * radius, shape_index_,
+                               &selected_shape_index_, &selected_point_index)) {
+        selected_shape_index_ = -1;
+        selected_point_index = -1;
     }
 }
 
+// Mice can report several positions per displayed frame. Only the latest
+// is handled, once, when the frame is drawn; drags place the vertex or
+// shape by where the cursor is, not by how far it moved, so dropping the
+// positions in between changes nothing.
 void motion(int x, int y) {
 
+    if (!pan_enable_ && edit_mode_ == 0) return;
+
+    redraw_queue_motion(x, y);
+    redraw_request(REDRAW_HUD);
+}
+
+void process_motion() {
+
+    int x, y;
+    if (!redraw_take_motion(&x, &y)) return;
+
+    if (pan_enable_) {
+        view_.pan(x - pan_last_.x, y - pan_last_.y);
+        pan_last_.x = x;
+        pan_last_.y = y;
+        cursor_on_screen.x = x;
+        cursor_on_screen.y = y;
+        calculate_cursor_on_grid();
+        redraw_request(REDRAW_SCENE | REDRAW_HUD);
+        return;
+    }
+
     if (edit_mode_ == 0) return;
 
+    TRACE_SCOPE("process_motion");
+
     cursor_on_screen.x = x;
     cursor_on_screen.y = y;
 
     calculate_cursor_on_grid();
 
+    // The cursor position panel follows the mouse.
+    unsigned damage = REDRAW_HUD;
+
+    if (band_enable_) {
+        redraw_request(damage | REDRAW_SCENE);
+        return;
+    }
+
     if (move_and_rotate_mode_ != 0) {
         if (move_shape_enable_) {
             move_shape_with_mouse();
+            damage |= REDRAW_SCENE;
         } else if (rotate_shape_enable_) {
             rotate_shape_with_mouse();
+            damage |= REDRAW_SCENE;
         }
     } else {
 
         if (move_point_index != -1) {
-            shape[shape_index_][move_point_index].point = cursor_on_grid;
+            // The checker can follow the drag if it saw the shape as it was.
+            bool checked = crossing_shape_ == shape_index_
+                && crossing_version_ == shapes_.version(shape_index_)
+                && !shapes_.has_transform(shape_index_);
+
+            journal_.record_move(shape_index_, move_point_index,
+                                 shapes_.point(shape_index_, move_point_index), cursor_on_grid);
+            shapes_.set_point(shape_index_, move_point_index, cursor_on_grid);
+            vertex_index_.move_point(shape_index_, move_point_index, cursor_on_grid);
+            if (checked) {
+                move_crossing_vertex(move_point_index);
+            }
 
             update_center();
+            damage |= REDRAW_SCENE;
         }
         else {
+            int last_shape = selected_shape_index_;
+            int last_point = selected_point_index;
 
             find_selected_point();
+
+            if (last_shape != selected_shape_index_ || last_point != selected_point_index) {
+                damage |= REDRAW_SCENE;
+            }
         }
     }
+
+    redraw_request(damage);
+}
+
+int add_shape() {
+
+    int k = shapes_.add_shape();
+    sync_shape_slots();
+
+    return k;
+}
+
+// Per-shape editor state for shapes the document added.
+void sync_shape_slots() {
+
+    grid_point origin = { 0.0, 0.0 };
+    area_.resize(shapes_.shape_count(), 0.0);
+    shape_center.resize(shapes_.shape_count(), origin);
+}
+
+void clear_selection() {
+
+    selected_shape_index_ = -1;
+    selected_point_index = -1;
+    move_point_index = -1;
+}
+
+void shape_modified(int shape) {
+
+    shapes_.touch(shape);
+    vertex_index_.update_shape(shapes_, shape);
+}
+
+void focus_selected_shape() {
+
+    // Vertices of other shapes can be picked, editing them makes their
+    // shape the current one.
+    if (selected_shape_index_ != -1 && selected_shape_index_ != shape_index_) {
+        shape_index_ = selected_shape_index_;
+        update_center();
+    }
 }
 
 void add_point_to_current_shape() {
 
-    shape[shape_index_][shape_point_index].point = cursor_on_grid;
-    shape[shape_index_][shape_point_index].valid = true;
-    shape_point_index = (shape_point_index+1) % MAX_SHAPE_POINTS;
+    journal_.record_insert(shape_index_, shapes_.size(shape_index_), cursor_on_grid);
+    shapes_.append_point(shape_index_, cursor_on_grid);
+    vertex_index_.insert_point(shapes_, shape_index_, shapes_.size(shape_index_) - 1);
 
     update_center();
 }
@@ -606,8 +1156,22 @@ void process_view_keys(unsigned char key) {
     switch(key) {
         case 'd':
             debug_enable_ ^= 1; break;
+        case 'k':
+            toggle_tracing(); break;
+        case 'K':
+            dump_trace(); break;
         case 'z':
-            grid_scale_index_ = (grid_scale_index_ + 1) % kMaxGridScaleIndex;
+            reset_view();
+            break;
+        case '+':
+        case '=':
+            zoom_view(view_.width() / 2, view_.height() / 2, VIEW_ZOOM_STEP);
+            break;
+        case '-':
+            zoom_view(view_.width() / 2, view_.height() / 2, 1.0 / VIEW_ZOOM_STEP);
+            break;
+        case 'f':
+            fill_enable_ = !fill_enable_;
             break;
         case 'e':
             edit_mode_ ^= 1; break;
@@ -621,6 +1185,10 @@ void process_edit_keys(unsigned char key) {
 	switch(key) {
         case 'd':
             debug_enable_ ^= 1; break;
+        case 'k':
+            toggle_tracing(); break;
+        case 'K':
+            dump_trace(); break;
         case 'o':
             // move shape center to origin.
             move_shape_to_center();
@@ -633,15 +1201,41 @@ void process_edit_keys(unsigned char key) {
         case 'a':
             simplify_shape();
             break;
+        case 'x':
+            convex_enable_ = !convex_enable_;
+            break;
+        case 'X':
+            convex_limit_ = (convex_limit_ >= kConvexLimitMax) ? kConvexLimitMin : convex_limit_ + 1;
+            break;
+        case '[':
+            adjust_simplify(false);
+            break;
+        case ']':
+            adjust_simplify(true);
+            break;
         case 'c':
             copy_shape_index_ = shape_index_; break;
         case 'p':
             paste_copied_shape(true); break;
         case 'P':
             paste_copied_shape(false); break;
+        case '|':
+            combine_with_copied_shape(BOOLEAN_UNION); break;
+        case '&':
+            combine_with_copied_shape(BOOLEAN_INTERSECTION); break;
+        case '\\':
+            combine_with_copied_shape(BOOLEAN_DIFFERENCE); break;
         case 'w':
             write_shape();
             break;
+        case 'u':
+        case 26:    // ^Z
+            undo_edit(false);
+            break;
+        case 'U':
+        case 25:    // ^Y
+            undo_edit(true);
+            break;
         case 'r':
             read_shape();
             break;
@@ -659,12 +1253,30 @@ void process_edit_keys(unsigned char key) {
         case 'v':
             flip_y_values(); break;
         case 'z':
-            grid_scale_index_ = (grid_scale_index_ + 1) % kMaxGridScaleIndex;
+            reset_view();
+            break;
+        case '+':
+        case '=':
+            zoom_view(view_.width() / 2, view_.height() / 2, VIEW_ZOOM_STEP);
+            break;
+        case '-':
+            zoom_view(view_.width() / 2, view_.height() / 2, 1.0 / VIEW_ZOOM_STEP);
             break;
         case 'n':
-            shape_index_ = (shape_index_ + 1) % MAX_SHAPES;
+            // Past the last shape, open a new one unless that one is empty.
+            if (shape_index_ + 1 < shapes_.shape_count()) {
+                shape_index_++;
+            } else if (shapes_.size(shape_index_) > 0) {
+                shape_index_ = add_shape();
+            } else {
+                shape_index_ = 0;
+            }
+            clear_selection();
             update_center();
             break;
+        case 'f':
+            fill_enable_ = !fill_enable_;
+            break;
         case 'e':
             edit_mode_ ^= 1; break;
 		case 27:
@@ -675,252 +1287,588 @@ void process_edit_keys(unsigned char key) {
 
 void keyboard(unsigned char key, int x, int y) {
 
+    TRACE_SCOPE("keyboard");
+
+    process_motion();
+
     if (edit_mode_ != 0) {
         process_edit_keys(key);
     } else {
         process_view_keys(key);
     }
 
+    redraw_request(REDRAW_SCENE | REDRAW_HUD);
+    update_animation();
+    if (edit_mode_ != 0) schedule_autosave();
 }
 
-void idle() {
+void advance_dash() {
     dash_index_ = (dash_index_ + 1) % kDashMax;
-    usleep(20000);
+}
+
+void update_animation() {
+    // Only the stippled copy source and rotation guide move on their own.
+    bool copy_visible = (copy_shape_index_ != -1);
+    bool guide_visible = (move_and_rotate_mode_ != 0 && rotate_shape_enable_);
+    redraw_animate(copy_visible || guide_visible, advance_dash, 20);
 }
 
 void preview_simplified_shape() {
 
     if (simplify_mode_ == 0) return;
 
-    double s_factor;
-    switch (simplify_mode_) {
-    case 1: s_factor = 1.0; break;
-    case 2: s_factor = 10.0; break;
-    case 3: s_factor = 100.0; break;
-    default:
-        return;
-    }
+    TRACE_SCOPE("preview_simplified_shape");
 
-    for (int i=0; i<MAX_SHAPE_POINTS; ++i) {
-        simplified_shape[i].valid = shape[shape_index_][i].valid;
-        simplified_shape[i].point.x = round(shape[shape_index_][i].point.x * s_factor) / s_factor;
-        simplified_shape[i].point.y = round(shape[shape_index_][i].point.y * s_factor) / s_factor;
-    }
+    simplify_method method = (simplify_mode_ == 2) ? SIMPLIFY_DOUGLAS_PEUCKER : SIMPLIFY_VISVALINGAM;
+    int target = (simplify_mode_ == 3) ? simplify_target_ : 0;
+    document_.simplified(shape_index_, method, simplify_tolerance_, target, simplified_x_, simplified_y_);
+    simplified_buffer_.upload(simplified_x_.data(), simplified_y_.data(), static_cast<int>(simplified_x_.size()));
+
+    simplified_shape_ = shape_index_;
+    simplified_version_ = shapes_.version(shape_index_);
 }
 
 void simplify_shape() {
 
-    if (simplify_mode_ != 0) {
-
+    if (simplify_mode_ != 0 && !selection_.empty()) {
+        simplify_selection();
         simplify_mode_ = 0;
+        clear_selection();
+        update_center();
+    }
+    else if (simplify_mode_ != 0) {
 
-        for (int i=0; i<MAX_SHAPE_POINTS; ++i) {
-            shape[shape_index_][i] = simplified_shape[i];
+        // The preview may show another shape, or an older outline.
+        if (simplified_shape_ != shape_index_ || simplified_version_ != shapes_.version(shape_index_)) {
+            preview_simplified_shape();
         }
 
+        simplify_mode_ = 0;
+
+        journal_.begin_rewrite(shapes_, shape_index_);
+        shapes_.assign(shape_index_, simplified_x_.data(), simplified_y_.data(), static_cast<int>(simplified_x_.size()));
+        journal_.end_rewrite(shapes_, shape_index_);
+        shape_modified(shape_index_);
+        clear_selection();
+
         update_center();
     }
 }
 
-void update_center() {
+void adjust_simplify(bool coarser) {
 
-    int final_shape_index = 0;
-    for (int i=0; i<MAX_SHAPE_POINTS; ++i) {
-        if (shape[shape_index_][i].valid) {
-            final_shape[final_shape_index] = shape[shape_index_][i].point;
-            final_shape_index++;
-        }
-    }
-    final_shape_size = final_shape_index;
+    if (simplify_mode_ == 0) return;
 
-    area_[shape_index_] = 0.0;
-    for (int i=0; i<final_shape_size; ++i) {
-        int j = (i+1) % final_shape_size;
-        area_[shape_index_] += 0.5 * (final_shape[i].x * final_shape[j].y - final_shape[j].x * final_shape[i].y);
+    if (simplify_mode_ == 3) {
+        simplify_target_ = coarser ? simplify_target_ / 2 : simplify_target_ * 2;
+        if (simplify_target_ < 3) simplify_target_ = 3;
+        if (simplify_target_ > kSimplifyTargetMax) simplify_target_ = kSimplifyTargetMax;
+    } else {
+        simplify_tolerance_ *= coarser ? 2.0 : 0.5;
     }
+    preview_simplified_shape();
+}
 
-    shape_center[shape_index_].x = 0.0;
-    shape_center[shape_index_].y = 0.0;
-    for (int i=0; i<final_shape_size; ++i) {
-        int j = (i+1) % final_shape_size;
-        double common = (final_shape[i].x * final_shape[j].y - final_shape[j].x * final_shape[i].y);
-        shape_center[shape_index_].x += (final_shape[i].x + final_shape[j].x) * common;
-        shape_center[shape_index_].y += (final_shape[i].y + final_shape[j].y) * common;
-    }
-    shape_center[shape_index_].x /= 6.0 * area_[shape_index_];
-    shape_center[shape_index_].y /= 6.0 * area_[shape_index_];
+void update_center() {
+
+    TRACE_SCOPE("update_center");
+
+    area_[shape_index_] = shapes_.area(shape_index_);
+    shape_center[shape_index_] = shapes_.centroid(shape_index_);
 }
 
 void move_shape_to_center() {
 
-    for (int i=0; i<MAX_SHAPE_POINTS; ++i) {
-        shape[shape_index_][i].point.x -= shape_center[shape_index_].x;
-        shape[shape_index_][i].point.y -= shape_center[shape_index_].y;
+    if (!selection_.empty()) {
+        document_.move_to_center(selection_.shapes(), &pool_);
+        commit_selection();
+        return;
     }
 
+    document_.move_to_center(shape_index_);
+    commit_transform(shape_index_);
+
     update_center();
 }
 
 void write_shape() {
 
-    // Print shape
-    bool once = true;
-    for(int i=0; i<MAX_SHAPE_POINTS; ++i) {
-        if (shape[shape_index_][i].valid) {
-            if (once) {
-                once = false;
-                printf("\n{");
-            } else {
-                puts(",");
-            }
-            printf("{%.3f, %.3f}", shape[shape_index_][i].point.x, shape[shape_index_][i].point.y);
-        }
+    TRACE_SCOPE("write_shape");
+
+    document_.export_shape(shape_index_, stdout);
+    document_.export_properties(shape_index_, shape_properties_.mass(shapes_, shape_index_),
+                                shape_properties_.hull(shapes_, shape_index_), stdout);
+    if (convex_enable_) {
+        update_convex_pieces();
+        document_.export_pieces(shape_index_, convex_pieces_, stdout);
     }
-    if (once == false) puts("}");
 
-    // Save shape to design.poly
-    char filename[32];
-    sprintf(filename, "design-%02d.poly", shape_index_);
-    FILE *fSave = fopen(filename, "wb");
-    if (fSave != 0) {
-        fwrite(shape[shape_index_], sizeof(shape_point), MAX_SHAPE_POINTS, fSave);
-        fclose(fSave);
+    save_library();
+}
+
+void save_library() {
+
+    TRACE_SCOPE("save_library");
+
+    // Only changed shapes are copied here; the disk work happens on the
+    // writer thread.
+    library_writer_.submit(shapes_);
+}
+
+void autosave(int) {
+
+    autosave_armed_ = false;
+    save_library();
+}
+
+// Saves a little while after an edit, so a crash loses at most the last
+// AUTOSAVE_INTERVAL milliseconds. No timer runs while nothing happens.
+void schedule_autosave() {
+
+    if (autosave_armed_) return;
+
+    autosave_armed_ = true;
+    glutTimerFunc(AUTOSAVE_INTERVAL, autosave, 0);
+}
+
+bool read_library_shape(int index) {
+
+    if (!library_.is_open() || index >= library_.shape_count()) return false;
+
+    const double* x;
+    const double* y;
+    int n;
+    if (!library_.shape(index, &x, &y, &n)) {
+        fprintf(stderr, "Shape %d in %s fails its checksum, skipped\n", index, LIBRARY_FILE);
+        return false;
+    }
+
+    while (index >= shapes_.shape_count()) {
+        add_shape();
     }
+    shapes_.assign(index, x, y, n);
+
+    return true;
 }
 
-void read_shape() {
+bool read_shape_file(int index) {
 
     char filename[32];
-    sprintf(filename, "design-%02d.poly", shape_index_);
-    FILE *fLoad = fopen(filename, "rb");
-    if (fLoad != 0) {
-        fread(shape[shape_index_], sizeof(shape_point), MAX_SHAPE_POINTS, fLoad);
-        fclose(fLoad);
+    sprintf(filename, "design-%02d.poly", index);
+    if (!document_.import_legacy(filename, index)) return false;
+
+    sync_shape_slots();
+    return true;
+}
+
+void read_shape() {
+
+    TRACE_SCOPE("read_shape");
+
+    // Saves replace the file, map the latest one.
+    library_.open(LIBRARY_FILE);
+
+    journal_.begin_rewrite(shapes_, shape_index_);
+    bool loaded;
+    if (library_.is_open()) {
+        loaded = read_library_shape(shape_index_);
+    } else {
+        loaded = read_shape_file(shape_index_);
+    }
+
+    if (loaded) {
+        journal_.end_rewrite(shapes_, shape_index_);
+        shape_modified(shape_index_);
+        clear_selection();
         update_center();
     }
 }
 
-void quit_application() {
+void undo_edit(bool redo) {
+
+    TRACE_SCOPE("undo_edit");
+
+    // A gesture in progress is finished first, it becomes the last step.
+    end_shape_gesture();
 
-    for (int i=0; i<MAX_SHAPES; ++i) {
-        shape_index_ = i;
-        write_shape();
+    // A group, such as a commit of picked shapes, goes as a whole.
+    journal_change change;
+    do {
+        change = redo ? journal_.redo(shapes_) : journal_.undo(shapes_);
+        if (change.shape == -1) return;
+
+        if (change.count >= 0) {
+            for (int i=change.first; i<change.first+change.count; ++i) {
+                vertex_index_.move_point(change.shape, i, shapes_.point(change.shape, i));
+            }
+            int at = change.first + change.count;
+            for (int i=0; i<change.delta; ++i) {
+                vertex_index_.insert_point(shapes_, change.shape, at + i);
+            }
+            for (int i=0; i<-change.delta; ++i) {
+                vertex_index_.erase_point(change.shape, at);
+            }
+        } else {
+            vertex_index_.update_shape(shapes_, change.shape);
+        }
+        shape_index_ = change.shape;
+        clear_selection();
+        update_center();
+    } while (change.joined);
+}
+
+void toggle_tracing() {
+
+    trace_enable(!trace_enabled_.load());
+}
+
+// Everything still in the ring, whether or not tracing is on now.
+void dump_trace() {
+
+    if (trace_write_chrome(TRACE_FILE)) {
+        fprintf(stderr, "Trace written to %s\n", TRACE_FILE);
+    } else {
+        fprintf(stderr, "Could not write %s\n", TRACE_FILE);
     }
+}
+
+void quit_application() {
+
+    save_library();
+    library_writer_.flush();
 
     exit(0);
 }
 
+// Every library shape is copied into shapes_ and checked against its CRC.
 void load_shapes() {
-    for (int i=0; i<MAX_SHAPES; ++i) {
-        shape_index_ = i;
-        read_shape();
+    // The first MIN_SHAPES slots always exist.
+    while (shapes_.shape_count() < MIN_SHAPES) {
+        add_shape();
+    }
+
+    if (library_.open(LIBRARY_FILE)) {
+        for (int i=0; i<library_.shape_count(); ++i) {
+            read_library_shape(i);
+        }
+    } else {
+        // No library yet, import design-NN.poly files up to the first gap
+        // past MIN_SHAPES.
+        for (int i=0; ; ++i) {
+            if (!read_shape_file(i) && i >= MIN_SHAPES) {
+                break;
+            }
+        }
     }
+    vertex_index_.build(shapes_);
+
+    // Imported shapes go into a new library right away.
+    library_writer_.start(LIBRARY_FILE, shapes_, library_.is_open());
+    save_library();
+
+    shape_index_ = 0;
+    update_center();
 }
 
 void flip_x_values() {
-    grid_point* p;
-    for (int i=0; i<MAX_SHAPES; ++i) {
-        p = &shape[shape_index_][i].point;
-        p->x = 2.0 * shape_center[shape_index_].x - p->x;
+    if (!selection_.empty()) {
+        document_.mirror(selection_.shapes(), true, false, &pool_);
+        commit_selection();
+        return;
     }
+    document_.mirror(shape_index_, true, false);
+    commit_transform(shape_index_);
+    update_center();
 }
 
 void flip_y_values() {
-    grid_point* p;
-    for (int i=0; i<MAX_SHAPES; ++i) {
-        p = &shape[shape_index_][i].point;
-        p->y = 2.0 * shape_center[shape_index_].y - p->y;
+    if (!selection_.empty()) {
+        document_.mirror(selection_.shapes(), false, true, &pool_);
+        commit_selection();
+        return;
     }
-
+    document_.mirror(shape_index_, false, true);
+    commit_transform(shape_index_);
+    update_center();
 }
 
 void paste_copied_shape(bool at_target) {
 
     if (copy_shape_index_ == -1 || copy_shape_index_ == shape_index_) return;
 
-    double ox, oy;
-    if (at_target) {
-        ox = shape_center[shape_index_].x - shape_center[copy_shape_index_].x;
-        oy = shape_center[shape_index_].y - shape_center[copy_shape_index_].y;
-    } else {
-        ox = oy = 0.0;
-    }
+    journal_.begin_rewrite(shapes_, shape_index_);
+    document_.paste(shape_index_, copy_shape_index_, at_target);
+    journal_.end_rewrite(shapes_, shape_index_);
+    shape_modified(shape_index_);
+    clear_selection();
+
+    copy_shape_index_ = -1;
+}
+
+// The current shape becomes its union, intersection or difference with the
+// copied one. The largest piece of the result stays in the current shape,
+// any others go to new shapes.
+void combine_with_copied_shape(boolean_op op) {
+
+    if (copy_shape_index_ == -1 || copy_shape_index_ == shape_index_) return;
+
+    TRACE_SCOPE("combine_with_copied_shape");
+
+    commit_transform(shape_index_);
+    commit_transform(copy_shape_index_);
+    polygon_loops loops;
+    document_.combine(shape_index_, copy_shape_index_, op, loops);
 
-    for (int i=0; i<MAX_SHAPE_POINTS; ++i) {
-        shape[shape_index_][i].point.x = shape[copy_shape_index_][i].point.x + ox;
-        shape[shape_index_][i].point.y = shape[copy_shape_index_][i].point.y + oy;
-        shape[shape_index_][i].valid = shape[copy_shape_index_][i].valid;
+    // An empty result empties the current shape.
+    int count = std::max(loops.count(), 1);
+    for (int k=0; k<count; ++k) {
+        int shape = (k == 0) ? shape_index_ : add_shape();
+        int first = (k < loops.count()) ? loops.first[k] : 0;
+        int n = (k < loops.count()) ? loops.size(k) : 0;
+
+        journal_.begin_rewrite(shapes_, shape);
+        shapes_.assign(shape, loops.x.data() + first, loops.y.data() + first, n);
+        journal_.end_rewrite(shapes_, shape);
+        shape_modified(shape);
     }
+    clear_selection();
+    update_center();
 
     copy_shape_index_ = -1;
 }
 
-void move_shape_with_mouse() {
-
-    grid_point pC = shape_center[shape_index_];
-    grid_point *p;
-    for (int i=0; i<MAX_SHAPE_POINTS; ++i) {
-        p = &shape[shape_index_][i].point;
-        p->x = (p->x - pC.x) + cursor_on_grid.x;
-        p->y = (p->y - pC.y) + cursor_on_grid.y;
+void begin_shape_gesture() {
+
+    if (!selection_.empty()) {
+        commit_selection();
+        shape_buffers_.sync(shapes_);
+        const std::vector<int>& picked = selection_.shapes();
+        grid_box box = { cursor_on_grid, cursor_on_grid };
+        bool first = true;
+        for (size_t i=0; i<picked.size(); ++i) {
+            if (shapes_.size(picked[i]) == 0) continue;
+            grid_box b = shape_buffers_.bounds(shapes_, picked[i]);
+            if (first) box = b;
+            first = false;
+            box.min.x = std::min(box.min.x, b.min.x);
+            box.min.y = std::min(box.min.y, b.min.y);
+            box.max.x = std::max(box.max.x, b.max.x);
+            box.max.y = std::max(box.max.y, b.max.y);
+        }
+        gesture_selection_ = true;
+        gesture_center_.x = 0.5 * (box.min.x + box.max.x);
+        gesture_center_.y = 0.5 * (box.min.y + box.max.y);
+        gesture_anchor_ = cursor_on_grid;
+        return;
     }
+
+    // Anything still pending on the shape is committed first, the gesture
+    // replaces the transform as a whole.
+    commit_transform(shape_index_);
     update_center();
+
+    gesture_shape_ = shape_index_;
+    gesture_center_ = shape_center[shape_index_];
+}
+
+void end_shape_gesture() {
+
+    if (gesture_selection_) {
+        gesture_selection_ = false;
+        commit_selection();
+        return;
+    }
+
+    if (gesture_shape_ == -1) return;
+
+    commit_transform(gesture_shape_);
+    gesture_shape_ = -1;
 }
 
-grid_point rotate_point(grid_point& r1, double angle) {
+void commit_transform(int shape) {
 
-    grid_point r2;
+    if (!shapes_.has_transform(shape)) return;
 
-    r2.x = r1.x * cos(angle) - r1.y * sin(angle);
-    r2.y = r1.x * sin(angle) + r1.y * cos(angle);
+    journal_.record_transform(shape, shapes_.pending_transform(shape));
+    shapes_.apply_transform(shape);
+    vertex_index_.update_shape(shapes_, shape);
+}
 
-    return r2;
+// Every picked shape gets the same transform, set in O(1) each; the
+// vertices only change when the gesture ends.
+void set_selection_transform(const affine& t) {
+
+    const std::vector<int>& picked = selection_.shapes();
+    for (size_t i=0; i<picked.size(); ++i) {
+        shapes_.set_transform(picked[i], t);
+    }
+    update_center();
+}
+
+void move_shape_with_mouse() {
+
+    if (gesture_selection_) {
+        set_selection_transform(affine_translate(cursor_on_grid.x - gesture_anchor_.x,
+                                                 cursor_on_grid.y - gesture_anchor_.y));
+        return;
+    }
+
+    // Offset from where the gesture started, so nothing accumulates.
+    double dx = cursor_on_grid.x - gesture_center_.x;
+    double dy = cursor_on_grid.y - gesture_center_.y;
+    shapes_.set_transform(gesture_shape_, affine_translate(dx, dy));
+    update_center();
 }
 
 void rotate_shape_with_mouse() {
-    double dy = cursor_on_grid.y - shape_center[shape_index_].y;
-    double dx = cursor_on_grid.x - shape_center[shape_index_].x;
+    double dy = cursor_on_grid.y - gesture_center_.y;
+    double dx = cursor_on_grid.x - gesture_center_.x;
     rotate_angle_ = atan2(dy, dx);
-    double delta_angle = rotate_angle_ - start_angle_;
 
-    grid_point c = shape_center[shape_index_];
-    grid_point *p;
-    grid_point r1, r2;
-    for (int i=0; i<MAX_SHAPE_POINTS; ++i) {
-        p = &shape[shape_index_][i].point;
-        r1.x = p->x - c.x;
-        r1.y = p->y - c.y;
-        r2 = rotate_point(r1, delta_angle);
-        p->x = c.x + r2.x;
-        p->y = c.y + r2.y;
+    // Total angle of the gesture, not the step since the last event.
+    affine t = affine_rotate(gesture_center_, rotate_angle_ - start_angle_);
+    if (gesture_selection_) {
+        set_selection_transform(t);
+        return;
     }
-
-    start_angle_ = rotate_angle_;
+    shapes_.set_transform(gesture_shape_, t);
 }
 
 void rotate_shape_start_angle() {
 
-    double dy = cursor_on_grid.y - shape_center[shape_index_].y;
-    double dx = cursor_on_grid.x - shape_center[shape_index_].x;
+    double dy = cursor_on_grid.y - gesture_center_.y;
+    double dx = cursor_on_grid.x - gesture_center_.x;
     start_angle_ = atan2(dy, dx);
     rotate_angle_ = 0.0;
 }
 
 void rotate_shape_by(double angle) {
     double r_angle = angle * M_PI / 180.0;
-    double dy = cursor_on_grid.y - shape_center[shape_index_].y;
-    double dx = cursor_on_grid.x - shape_center[shape_index_].x;
 
-    grid_point c = shape_center[shape_index_];
-    grid_point *p;
-    grid_point r1, r2;
-    for (int i=0; i<MAX_SHAPE_POINTS; ++i) {
-        p = &shape[shape_index_][i].point;
-        r1.x = p->x - c.x;
-        r1.y = p->y - c.y;
-        r2 = rotate_point(r1, r_angle);
-        p->x = c.x + r2.x;
-        p->y = c.y + r2.y;
+    if (!selection_.empty()) {
+        document_.rotate(selection_.shapes(), r_angle, &pool_);
+        commit_selection();
+        return;
+    }
+
+    document_.rotate(shape_index_, r_angle);
+    commit_transform(shape_index_);
+}
+
+// Even-odd test against the outline as drawn, pending transform included.
+static bool shape_contains(int shape, const grid_point& p) {
+
+    int n = shapes_.size(shape);
+    bool inside = false;
+    grid_point a = shapes_.point(shape, n - 1);
+    for (int i=0; i<n; ++i) {
+        grid_point b = shapes_.point(shape, i);
+        if ((a.y > p.y) != (b.y > p.y)
+            && p.x < a.x + (p.y - a.y) * (b.x - a.x) / (b.y - a.y)) {
+            inside = !inside;
+        }
+        a = b;
+    }
+    return inside;
+}
+
+// The shape with a vertex nearest p within picking distance, else the last
+// one whose outline holds p, else -1.
+int shape_at(const grid_point& p) {
+
+    double radius = SELECT_DISTANCE_PIXELS * view_.pixel_size();
+    int shape, index;
+    if (vertex_index_.nearest(p, radius * radius, -1, &shape, &index)) return shape;
+
+    grid_box at = { p, p };
+    shape_buffers_.sync(shapes_);
+    for (int k=shapes_.shape_count()-1; k>=0; --k) {
+        if (shapes_.size(k) < 3 || !shape_buffers_.bounds(shapes_, k).overlaps(at)) continue;
+        if (shape_contains(k, p)) return k;
     }
+    return -1;
 }
 
+// A band no bigger than the picking distance is a click: it toggles the
+// shape under the cursor, or clears the selection off any shape. A larger
+// band adds every shape lying wholly inside it.
+void finish_selection_band() {
+
+    TRACE_SCOPE("finish_selection_band");
+
+    band_enable_ = false;
+    grid_box band;
+    band.min.x = std::min(band_start_.x, cursor_on_grid.x);
+    band.min.y = std::min(band_start_.y, cursor_on_grid.y);
+    band.max.x = std::max(band_start_.x, cursor_on_grid.x);
+    band.max.y = std::max(band_start_.y, cursor_on_grid.y);
+
+    double click = SELECT_DISTANCE_PIXELS * view_.pixel_size();
+    if (band.max.x - band.min.x < click && band.max.y - band.min.y < click) {
+        int shape = shape_at(cursor_on_grid);
+        if (shape == -1) {
+            selection_.clear();
+        } else {
+            selection_.toggle(shape);
+        }
+        return;
+    }
+
+    shape_buffers_.sync(shapes_);
+    for (int k=0; k<shapes_.shape_count(); ++k) {
+        if (shapes_.size(k) > 0 && band.contains(shape_buffers_.bounds(shapes_, k))) {
+            selection_.add(k);
+        }
+    }
+}
+
+// Pending transforms of the picked shapes go into their vertices on the
+// pool, recorded as one undo step.
+void commit_selection() {
+
+    TRACE_SCOPE("commit_selection");
+
+    double start = now_ms();
+    const std::vector<int>& picked = selection_.shapes();
+    std::vector<int> moved;
+    journal_.begin_group();
+    for (size_t i=0; i<picked.size(); ++i) {
+        if (!shapes_.has_transform(picked[i])) continue;
+        journal_.record_transform(picked[i], shapes_.pending_transform(picked[i]));
+        moved.push_back(picked[i]);
+    }
+    journal_.end_group();
+
+    document_.apply_transforms(moved, &pool_);
+    for (size_t i=0; i<moved.size(); ++i) {
+        vertex_index_.update_shape(shapes_, moved[i]);
+    }
+    update_center();
+    selection_ms_ = now_ms() - start;
+}
+
+// The outlines are simplified on the pool, and written back here, where
+// the store may have to grow.
+void simplify_selection() {
+
+    TRACE_SCOPE("simplify_selection");
+
+    commit_selection();
+
+    double start = now_ms();
+    const std::vector<int>& picked = selection_.shapes();
+    simplify_method method = (simplify_mode_ == 2) ? SIMPLIFY_DOUGLAS_PEUCKER : SIMPLIFY_VISVALINGAM;
+    int target = (simplify_mode_ == 3) ? simplify_target_ : 0;
+    std::vector<std::vector<double> > x, y;
+    document_.simplified(picked, method, simplify_tolerance_, target, x, y, &pool_);
+
+    journal_.begin_group();
+    for (size_t i=0; i<picked.size(); ++i) {
+        journal_.begin_rewrite(shapes_, picked[i]);
+        shapes_.assign(picked[i], x[i].data(), y[i].data(), static_cast<int>(x[i].size()));
+        journal_.end_rewrite(shapes_, picked[i]);
+        shape_modified(picked[i]);
+    }
+    journal_.end_group();
+    selection_ms_ = now_ms() - start;
+}
@@ -0,0 +1,182 @@
+#include <math.h>
+
+#include <algorithm>
+
+#include "mass_properties.h"
+
+void compute_mass_properties(const double* x, const double* y, int n, mass_properties& m) {
+
+    mass_properties zero = { 0.0, { 0.0, 0.0 }, 0.0, 0.0, 0.0, { 0.0, 0.0 }, { 0.0, 0.0 } };
+    m = zero;
+    if (n == 0) return;
+
+    // Green's theorem edge by edge, relative to the first vertex so large
+    // offsets do not eat the precision of the second moments.
+    double ox = x[0];
+    double oy = y[0];
+    double a2 = 0.0;
+    double cx = 0.0;
+    double cy = 0.0;
+    double xx = 0.0;
+    double yy = 0.0;
+    double xy = 0.0;
+    double min_x = x[0], max_x = x[0];
+    double min_y = y[0], max_y = y[0];
+    double px = x[n - 1] - ox;
+    double py = y[n - 1] - oy;
+    for (int i=0; i<n; ++i) {
+        double qx = x[i] - ox;
+        double qy = y[i] - oy;
+        double c = px * qy - qx * py;
+        double sx = px + qx;
+        double sy = py + qy;
+        a2 += c;
+        cx += sx * c;
+        cy += sy * c;
+        // px^2 + px qx + qx^2, and px qy + qx py + 2 (px py + qx qy) with
+        // the cross product already at hand.
+        xx += (px * sx + qx * qx) * c;
+        yy += (py * sy + qy * qy) * c;
+        xy += (c + 2.0 * (py * sx + qx * qy)) * c;
+        min_x = std::min(min_x, x[i]);
+        max_x = std::max(max_x, x[i]);
+        min_y = std::min(min_y, y[i]);
+        max_y = std::max(max_y, y[i]);
+        px = qx;
+        py = qy;
+    }
+
+    m.min.x = min_x;
+    m.min.y = min_y;
+    m.max.x = max_x;
+    m.max.y = max_y;
+    if (a2 == 0.0) {
+        m.centroid.x = 0.5 * (min_x + max_x);
+        m.centroid.y = 0.5 * (min_y + max_y);
+        return;
+    }
+
+    // From the first vertex to the centroid, parallel axis theorem.
+    m.area = 0.5 * a2;
+    double gx = cx / (3.0 * a2);
+    double gy = cy / (3.0 * a2);
+    m.centroid.x = ox + gx;
+    m.centroid.y = oy + gy;
+    m.xx = xx / 12.0 - m.area * gx * gx;
+    m.yy = yy / 12.0 - m.area * gy * gy;
+    m.xy = xy / 24.0 - m.area * gx * gy;
+}
+
+mass_properties transform_mass_properties(const mass_properties& m, const affine& t,
+                                          const double* x, const double* y, const std::vector<int>& hull) {
+
+    mass_properties r = m;
+    double det = t.det();
+    r.area = m.area * det;
+    r.centroid = t.apply(m.centroid);
+
+    // Second moments as a matrix S go to det M S M^T.
+    r.xx = det * (t.a * t.a * m.xx + 2.0 * t.a * t.b * m.xy + t.b * t.b * m.yy);
+    r.yy = det * (t.c * t.c * m.xx + 2.0 * t.c * t.d * m.xy + t.d * t.d * m.yy);
+    r.xy = det * (t.a * t.c * m.xx + (t.a * t.d + t.b * t.c) * m.xy + t.b * t.d * m.yy);
+
+    for (size_t k=0; k<hull.size(); ++k) {
+        grid_point p = { x[hull[k]], y[hull[k]] };
+        p = t.apply(p);
+        if (k == 0) {
+            r.min = p;
+            r.max = p;
+            continue;
+        }
+        r.min.x = std::min(r.min.x, p.x);
+        r.min.y = std::min(r.min.y, p.y);
+        r.max.x = std::max(r.max.x, p.x);
+        r.max.y = std::max(r.max.y, p.y);
+    }
+    if (hull.empty()) {
+        r.min = r.centroid;
+        r.max = r.centroid;
+    }
+    return r;
+}
+
+struct hull_order {
+    bool operator()(int l, int r) const {
+        if (x[l] != x[r]) return x[l] < x[r];
+        return y[l] < y[r];
+    }
+
+    const double* x;
+    const double* y;
+};
+
+static double turn(const double* x, const double* y, int a, int b, int c) {
+
+    return (x[b] - x[a]) * (y[c] - y[a]) - (x[c] - x[a]) * (y[b] - y[a]);
+}
+
+void convex_hull(const double* x, const double* y, int n, std::vector<int>& hull) {
+
+    hull.clear();
+    if (n == 0) return;
+
+    std::vector<int> order(n);
+    for (int i=0; i<n; ++i) {
+        order[i] = i;
+    }
+    hull_order by_position = { x, y };
+    std::sort(order.begin(), order.end(), by_position);
+
+    // Lower chain left to right, then the upper chain back. Each chain ends
+    // where the other starts, so that vertex is dropped once.
+    hull.resize(2 * n);
+    int k = 0;
+    for (int i=0; i<n; ++i) {
+        while (k >= 2 && turn(x, y, hull[k - 2], hull[k - 1], order[i]) <= 0.0) k--;
+        hull[k++] = order[i];
+    }
+    for (int i=n-2, lower=k+1; i>=0; --i) {
+        while (k >= lower && turn(x, y, hull[k - 2], hull[k - 1], order[i]) <= 0.0) k--;
+        hull[k++] = order[i];
+    }
+    hull.resize(k > 1 ? k - 1 : k);
+}
+
+shape_properties::entry& shape_properties::slot(const shape_store& store, int shape) {
+
+    if (static_cast<int>(entries_.size()) < store.shape_count()) {
+        entries_.resize(store.shape_count());
+    }
+    entry& e = entries_[shape];
+    if (e.version != store.version(shape)) {
+        e.version = store.version(shape);
+        e.mass_valid = false;
+        e.hull_valid = false;
+    }
+    return e;
+}
+
+const std::vector<int>& shape_properties::hull(const shape_store& store, int shape) {
+
+    entry& e = slot(store, shape);
+    if (!e.hull_valid) {
+        convex_hull(store.xs(shape), store.ys(shape), store.size(shape), e.hull);
+        e.hull_valid = true;
+    }
+    return e.hull;
+}
+
+const mass_properties& shape_properties::mass(const shape_store& store, int shape) {
+
+    entry& e = slot(store, shape);
+    if (!e.mass_valid) {
+        compute_mass_properties(store.xs(shape), store.ys(shape), store.size(shape), e.committed);
+        e.mass_valid = true;
+    }
+    if (!store.has_transform(shape)) return e.committed;
+
+    const std::vector<int>& h = hull(store, shape);
+    e.current = transform_mass_properties(e.committed, store.pending_transform(shape),
+                                          store.xs(shape), store.ys(shape), h);
+    return e.current;
+}
@@ -0,0 +1,65 @@
+#ifndef MASS_PROPERTIES_H_
+#define MASS_PROPERTIES_H_
+
+#include <math.h>
+#include <vector>
+
+#include "affine.h"
+#include "geometry.h"
+#include "shape_store.h"
+
+// Area and moments of the region inside an outline, for unit density. The
+// second moments xx, yy and xy integrate (x - cx)^2, (y - cy)^2 and
+// (x - cx)(y - cy) over the region. They are signed like the area, negative
+// for clockwise outlines.
+struct mass_properties {
+    double polar_inertia() const { return fabs(xx + yy); }
+
+    double area;
+    grid_point centroid;
+    double xx;
+    double yy;
+    double xy;
+    grid_point min;
+    grid_point max;
+};
+
+// Everything in one pass over the vertices. Outlines without area get the
+// middle of their bounds as centroid and no inertia.
+void compute_mass_properties(const double* x, const double* y, int n, mass_properties& m);
+
+// The properties after the outline went through t. The bounds are those of
+// the hull vertices, which are the only ones that can end up outermost.
+mass_properties transform_mass_properties(const mass_properties& m, const affine& t,
+                                          const double* x, const double* y, const std::vector<int>& hull);
+
+// Andrew's monotone chain. Fills hull with vertex indices of the convex
+// hull, counter-clockwise from the lowest leftmost vertex, without vertices
+// lying straight between their neighbors.
+void convex_hull(const double* x, const double* y, int n, std::vector<int>& hull);
+
+// Mass properties and hull of every shape, recomputed when its version
+// changed. A pending transform is applied to the cached values instead of
+// going over the vertices again.
+struct shape_properties {
+    const mass_properties& mass(const shape_store& store, int shape);
+    const std::vector<int>& hull(const shape_store& store, int shape);
+
+private:
+    struct entry {
+        entry() : version(0), mass_valid(false), hull_valid(false) {}
+
+        unsigned version;
+        bool mass_valid;
+        bool hull_valid;
+        mass_properties committed;
+        mass_properties current;
+        std::vector<int> hull;
+    };
+
+    entry& slot(const shape_store& store, int shape);
+
+    std::vector<entry> entries_;
+};
+
+#endif // MASS_PROPERTIES_H_
@@ -0,0 +1,617 @@
+#include <math.h>
+
+#include <algorithm>
+#include <queue>
+#include <set>
+
+#include "geometry.h"
+#include "polygon_boolean.h"
+
+// Part of an input edge, start before end in sweep order. Bit k of toggles
+// is set when the edge is on the border of outline k; overlapping edges of
+// both outlines merge into one with both bits. below has a bit for each
+// outline covering the side before the edge in the sweep, which is below it
+// or, for vertical edges, right of it. done is set once the sweep passed
+// the segment, or it merged into another one.
+struct boolean_segment {
+    grid_point start;
+    grid_point end;
+    int toggles;
+    int below;
+    bool done;
+};
+
+// Splitting a segment moves its end closer, the end event queued for the
+// old end is then stale and skipped.
+struct boolean_event {
+    grid_point p;
+    int segment;
+    bool start;
+};
+
+struct boolean_sweep;
+
+// Earliest event on top of the queue. Along the sweep: by x, then y; ends
+// before starts at the same point, and starts from lowest to highest.
+struct boolean_later_event {
+    explicit boolean_later_event(const boolean_sweep* w) : w(w) {}
+    bool operator()(const boolean_event& l, const boolean_event& r) const;
+
+    const boolean_sweep* w;
+};
+
+// Bottom to top. Segments in the sweep never cross, they are split where
+// they would, so comparing against the line of the other one is enough.
+struct boolean_status_order {
+    explicit boolean_status_order(const boolean_sweep* w) : w(w) {}
+    bool operator()(int l, int r) const;
+
+    const boolean_sweep* w;
+};
+
+typedef std::set<int, boolean_status_order> boolean_status;
+
+struct boolean_sweep {
+    boolean_sweep();
+
+    std::vector<boolean_segment> segments;
+    // Endpoints of the input edges are sorted once, only events of split
+    // segments are queued as they come.
+    std::vector<boolean_event> endpoints;
+    size_t next_endpoint;
+    std::priority_queue<boolean_event, std::vector<boolean_event>, boolean_later_event> queued;
+    boolean_status status;
+    // Slot of each segment while it is in the sweep.
+    std::vector<boolean_status::iterator> where;
+};
+
+boolean_sweep::boolean_sweep()
+: next_endpoint(0)
+, queued(boolean_later_event(this))
+, status(boolean_status_order(this))
+{
+}
+
+static bool before(const grid_point& p, const grid_point& q) {
+
+    return p.x < q.x || (p.x == q.x && p.y < q.y);
+}
+
+static bool same(const grid_point& p, const grid_point& q) {
+
+    return p.distance_square(q) <= BOOLEAN_EPSILON * BOOLEAN_EPSILON;
+}
+
+static double orient(const grid_point& a, const grid_point& b, const grid_point& c) {
+
+    return (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+}
+
+// 1 if p is left of the line through a and b, -1 if right, 0 if on it.
+static int side(const grid_point& p, const grid_point& a, const grid_point& b) {
+
+    double o = orient(a, b, p);
+    if (o * o <= BOOLEAN_EPSILON * BOOLEAN_EPSILON * a.distance_square(b)) return 0;
+    return o < 0.0 ? -1 : 1;
+}
+
+// Where t, a fraction along an edge of the given length, falls: -2 before
+// it, -1 at its start, 0 inside, 1 at its end and 2 past it.
+static int along(double t, double length) {
+
+    double e = BOOLEAN_EPSILON / length;
+    if (t < -e) return -2;
+    if (t <= e) return -1;
+    if (t < 1.0 - e) return 0;
+    if (t <= 1.0 + e) return 1;
+    return 2;
+}
+
+static bool earlier(const boolean_sweep& w, const boolean_event& l, const boolean_event& r) {
+
+    if (l.p.x != r.p.x) return l.p.x < r.p.x;
+    if (l.p.y != r.p.y) return l.p.y < r.p.y;
+    if (l.start != r.start) return !l.start;
+    if (l.segment == r.segment) return false;
+    if (l.start) {
+        double o = orient(l.p, w.segments[r.segment].end, w.segments[l.segment].end);
+        if (o != 0.0) return o < 0.0;
+    }
+    return l.segment < r.segment;
+}
+
+bool boolean_later_event::operator()(const boolean_event& l, const boolean_event& r) const {
+
+    return earlier(*w, r, l);
+}
+
+// -1 if a is below b, 1 if above, 0 if they lie on the same line. a starts
+// at or after the start of b, so its start is over b.
+static int compare_later(const boolean_segment& a, const boolean_segment& b) {
+
+    int o = side(a.start, b.start, b.end);
+    if (o == 0) o = side(a.end, b.start, b.end);
+    return o;
+}
+
+bool boolean_status_order::operator()(int l, int r) const {
+
+    if (l == r) return false;
+    const boolean_segment& a = w->segments[l];
+    const boolean_segment& b = w->segments[r];
+    int c = before(a.start, b.start) ? -compare_later(b, a) : compare_later(a, b);
+    if (c == 0) return l < r;
+    return c < 0;
+}
+
+// Events of the new segment go to events, or to the queue if null.
+static void add_segment(boolean_sweep& w, const grid_point& p, const grid_point& q, int toggles,
+                        std::vector<boolean_event>* events) {
+
+    boolean_segment s;
+    s.start = before(p, q) ? p : q;
+    s.end = before(p, q) ? q : p;
+    s.toggles = toggles;
+    s.below = 0;
+    s.done = false;
+    int k = static_cast<int>(w.segments.size());
+    w.segments.push_back(s);
+
+    boolean_event start = { s.start, k, true };
+    boolean_event end = { s.end, k, false };
+    if (events) {
+        events->push_back(start);
+        events->push_back(end);
+    } else {
+        w.queued.push(start);
+        w.queued.push(end);
+    }
+}
+
+// Segment k ends at p, a new one continues from p to its old end.
+static void divide(boolean_sweep& w, int k, const grid_point& p) {
+
+    grid_point old_end = w.segments[k].end;
+    w.segments[k].end = p;
+    boolean_event end = { p, k, false };
+    w.queued.push(end);
+
+    add_segment(w, p, old_end, w.segments[k].toggles, 0);
+}
+
+// Strictly inside the segment from a to b, p known to be on its line.
+static bool inside_segment(const grid_point& p, const grid_point& a, const grid_point& b) {
+
+    double dx = b.x - a.x;
+    double dy = b.y - a.y;
+    double length_sq = dx * dx + dy * dy;
+    double t = ((p.x - a.x) * dx + (p.y - a.y) * dy) / length_sq;
+    return along(t, sqrt(length_sq)) == 0;
+}
+
+// Splits segments s and t where they cross or touch. Returns true when they
+// overlap, after splitting, along their whole length.
+static bool intersect(boolean_sweep& w, int s, int t) {
+
+    grid_point a1 = w.segments[s].start;
+    grid_point a2 = w.segments[s].end;
+    grid_point b1 = w.segments[t].start;
+    grid_point b2 = w.segments[t].end;
+
+    if (side(b1, a1, a2) == 0 && side(b2, a1, a2) == 0) {
+        // On one line: make s the one starting later.
+        if (before(a1, b1) && !same(a1, b1)) {
+            std::swap(s, t);
+            std::swap(a1, b1);
+            std::swap(a2, b2);
+        }
+        if (same(a1, b2) || same(a2, b1)) return false;
+
+        bool same_start = same(a1, b1);
+        bool same_end = same(a2, b2);
+        if (same_start && same_end) return true;
+
+        bool a2_inside = !same_end && inside_segment(a2, b1, b2);
+        if (same_start) {
+            if (a2_inside) {
+                divide(w, t, a2);
+            } else {
+                divide(w, s, b2);
+            }
+            return true;
+        }
+        if (inside_segment(a1, b1, b2)) {
+            if (!same_end) {
+                if (a2_inside) {
+                    divide(w, t, a2);
+                } else {
+                    divide(w, s, b2);
+                }
+            }
+            divide(w, t, a1);
+        }
+        return false;
+    }
+
+    double dax = a2.x - a1.x;
+    double day = a2.y - a1.y;
+    double dbx = b2.x - b1.x;
+    double dby = b2.y - b1.y;
+    double d = dax * dby - day * dbx;
+    if (d == 0.0) return false;
+
+    double ta = ((b1.x - a1.x) * dby - (b1.y - a1.y) * dbx) / d;
+    double tb = ((b1.x - a1.x) * day - (b1.y - a1.y) * dax) / d;
+    int on_a = along(ta, sqrt(dax * dax + day * day));
+    int on_b = along(tb, sqrt(dbx * dbx + dby * dby));
+    if (on_a == -2 || on_a == 2 || on_b == -2 || on_b == 2) return false;
+
+    // Touching endpoints are reused, so both sides of a split agree exactly.
+    grid_point p = { a1.x + ta * dax, a1.y + ta * day };
+    if (on_a == 0) {
+        if (on_b == -1) {
+            divide(w, s, b1);
+        } else if (on_b == 0) {
+            divide(w, s, p);
+        } else {
+            divide(w, s, b2);
+        }
+    }
+    if (on_b == 0) {
+        if (on_a == -1) {
+            divide(w, t, a1);
+        } else if (on_a == 0) {
+            divide(w, t, p);
+        } else {
+            divide(w, t, a2);
+        }
+    }
+    return false;
+}
+
+static void add_outline(boolean_sweep& w, const double* x, const double* y, int n, int toggles) {
+
+    for (int i=0, j=n-1; i<n; j=i++) {
+        grid_point p = { x[j], y[j] };
+        grid_point q = { x[i], y[i] };
+        if (p.x == q.x && p.y == q.y) continue;
+        add_segment(w, p, q, toggles, &w.endpoints);
+    }
+}
+
+// The earliest event, from the sorted endpoints or the queue.
+static bool peek_event(const boolean_sweep& w, boolean_event* e, bool* queued) {
+
+    bool has_endpoint = w.next_endpoint < w.endpoints.size();
+    if (w.queued.empty() && !has_endpoint) return false;
+
+    *queued = !w.queued.empty()
+        && (!has_endpoint || earlier(w, w.queued.top(), w.endpoints[w.next_endpoint]));
+    *e = *queued ? w.queued.top() : w.endpoints[w.next_endpoint];
+    return true;
+}
+
+static void pop_event(boolean_sweep& w, bool queued) {
+
+    if (queued) {
+        w.queued.pop();
+    } else {
+        w.next_endpoint++;
+    }
+}
+
+static bool same_event(const boolean_event& l, const boolean_event& r) {
+
+    return l.segment == r.segment && l.start == r.start && l.p.x == r.p.x && l.p.y == r.p.y;
+}
+
+static void run_sweep(boolean_sweep& w) {
+
+    boolean_event e;
+    bool queued;
+    while (peek_event(w, &e, &queued)) {
+        int s = e.segment;
+        if (w.where.size() < w.segments.size()) {
+            w.where.resize(w.segments.size(), w.status.end());
+        }
+
+        if (!e.start) {
+            boolean_segment& seg = w.segments[s];
+            bool stale = seg.done || seg.end.x != e.p.x || seg.end.y != e.p.y;
+            pop_event(w, queued);
+            if (stale) continue;
+
+            boolean_status::iterator it = w.where[s];
+            boolean_status::iterator next = it;
+            ++next;
+            if (it != w.status.begin() && next != w.status.end()) {
+                boolean_status::iterator prev = it;
+                --prev;
+                intersect(w, *prev, *next);
+            }
+            w.status.erase(it);
+            w.where[s] = w.status.end();
+            w.segments[s].done = true;
+            continue;
+        }
+
+        boolean_status::iterator above = w.status.lower_bound(s);
+        boolean_status::iterator below = above;
+        bool has_below = (below != w.status.begin());
+        if (has_below) --below;
+
+        int overlap = -1;
+        if (above != w.status.end() && intersect(w, s, *above)) {
+            overlap = *above;
+        } else if (has_below && intersect(w, s, *below)) {
+            overlap = *below;
+        }
+        if (overlap != -1) {
+            // The other segment is in the sweep already, it takes both borders.
+            w.segments[overlap].toggles ^= w.segments[s].toggles;
+            w.segments[s].toggles = 0;
+            w.segments[s].done = true;
+            peek_event(w, &e, &queued);
+            pop_event(w, queued);
+            continue;
+        }
+        // A split may have queued events before this one.
+        boolean_event head;
+        peek_event(w, &head, &queued);
+        if (!same_event(head, e)) continue;
+
+        if (has_below) {
+            const boolean_segment& b = w.segments[*below];
+            w.segments[s].below = b.below ^ b.toggles;
+        }
+        w.where[s] = w.status.insert(s).first;
+        pop_event(w, queued);
+    }
+}
+
+static bool inside(boolean_op op, int cover) {
+
+    switch (op) {
+    case BOOLEAN_UNION:
+        return cover != 0;
+    case BOOLEAN_INTERSECTION:
+        return cover == 3;
+    case BOOLEAN_DIFFERENCE:
+        return cover == 1;
+    }
+    return false;
+}
+
+struct boolean_edge {
+    grid_point from;
+    grid_point to;
+};
+
+static bool edge_before(const boolean_edge& l, const boolean_edge& r) {
+
+    return before(l.from, r.from);
+}
+
+static double loop_area2(const std::vector<grid_point>& loop) {
+
+    double area2 = 0.0;
+    for (size_t i=0, j=loop.size()-1; i<loop.size(); j=i++) {
+        area2 += loop[j].x * loop[i].y - loop[i].x * loop[j].y;
+    }
+    return area2;
+}
+
+// Follows result edges into loops. Where several leave one point, the
+// sharpest left turn is taken, so regions touching at a corner come out
+// as loops of their own.
+static void chain_edges(std::vector<boolean_edge>& edges, std::vector<std::vector<grid_point> >& loops) {
+
+    std::sort(edges.begin(), edges.end(), edge_before);
+    std::vector<char> used(edges.size(), 0);
+
+    for (size_t first=0; first<edges.size(); ++first) {
+        if (used[first]) continue;
+
+        std::vector<grid_point> loop;
+        size_t e = first;
+        while (!used[e]) {
+            used[e] = 1;
+            loop.push_back(edges[e].from);
+            const grid_point& at = edges[e].to;
+            double dx = at.x - edges[e].from.x;
+            double dy = at.y - edges[e].from.y;
+
+            boolean_edge key = { at, at };
+            size_t k = std::lower_bound(edges.begin(), edges.end(), key, edge_before) - edges.begin();
+            size_t best = edges.size();
+            double best_turn = -HUGE_VAL;
+            for (; k<edges.size() && edges[k].from.x == at.x && edges[k].from.y == at.y; ++k) {
+                if (used[k] && k != first) continue;
+                double ex = edges[k].to.x - at.x;
+                double ey = edges[k].to.y - at.y;
+                double turn = atan2(dx * ey - dy * ex, dx * ex + dy * ey);
+                if (turn > best_turn) {
+                    best_turn = turn;
+                    best = k;
+                }
+            }
+            if (best == edges.size() || best == first) break;
+            e = best;
+        }
+        if (loop.size() >= 3) loops.push_back(loop);
+    }
+}
+
+// Drops vertices lying straight between their neighbors, splits leave them.
+static void drop_collinear(std::vector<grid_point>& loop) {
+
+    bool dropped = true;
+    while (dropped && loop.size() >= 3) {
+        dropped = false;
+        std::vector<grid_point> kept;
+        size_t n = loop.size();
+        for (size_t i=0; i<n; ++i) {
+            const grid_point& p = kept.empty() ? loop[n - 1] : kept.back();
+            const grid_point& q = loop[(i + 1) % n];
+            const grid_point& v = loop[i];
+            double forward = (v.x - p.x) * (q.x - v.x) + (v.y - p.y) * (q.y - v.y);
+            if (forward > 0.0 && side(v, p, q) == 0) {
+                dropped = true;
+                continue;
+            }
+            kept.push_back(v);
+        }
+        loop.swap(kept);
+    }
+}
+
+// Joins hole to one of the outer loops through a cut to its rightmost
+// vertex, which must see the vertex of the outer loop it is cut to. The
+// ray to the right of that vertex hits the loop right around the hole
+// first; the end of the hit edge further right is seen unless vertices
+// in the triangle between them are in the way, then the one closest in
+// angle to the ray is.
+static bool bridge_hole(std::vector<std::vector<grid_point> >& outers, const std::vector<grid_point>& hole) {
+
+    size_t m = 0;
+    for (size_t i=1; i<hole.size(); ++i) {
+        if (hole[i].x > hole[m].x) m = i;
+    }
+    const grid_point& mp = hole[m];
+
+    size_t hit_loop = outers.size();
+    size_t hit_vertex = 0;
+    double hit_x = HUGE_VAL;
+    for (size_t l=0; l<outers.size(); ++l) {
+        const std::vector<grid_point>& o = outers[l];
+        for (size_t i=0, j=o.size()-1; i<o.size(); j=i++) {
+            const grid_point& p = o[j];
+            const grid_point& q = o[i];
+            if ((p.y > mp.y) == (q.y > mp.y)) continue;
+            double x = p.x + (mp.y - p.y) * (q.x - p.x) / (q.y - p.y);
+            if (x < mp.x || x >= hit_x) continue;
+            hit_x = x;
+            hit_loop = l;
+            hit_vertex = p.x > q.x ? j : i;
+        }
+    }
+    if (hit_loop == outers.size()) return false;
+
+    std::vector<grid_point>& o = outers[hit_loop];
+    grid_point hit = { hit_x, mp.y };
+    size_t edge_vertex = hit_vertex;
+    grid_point pv = o[edge_vertex];
+    double best_angle = HUGE_VAL;
+    for (size_t i=0; i<o.size(); ++i) {
+        const grid_point& v = o[i];
+        if (i == edge_vertex || v.x < mp.x) continue;
+        // Inside the triangle mp, hit, pv in either winding.
+        double o1 = orient(mp, hit, v);
+        double o2 = orient(hit, pv, v);
+        double o3 = orient(pv, mp, v);
+        bool in = (o1 >= 0.0 && o2 >= 0.0 && o3 >= 0.0) || (o1 <= 0.0 && o2 <= 0.0 && o3 <= 0.0);
+        if (!in) continue;
+        double angle = fabs(atan2(v.y - mp.y, v.x - mp.x));
+        if (angle < best_angle) {
+            best_angle = angle;
+            hit_vertex = i;
+        }
+    }
+
+    std::vector<grid_point> joined;
+    joined.reserve(o.size() + hole.size() + 2);
+    joined.insert(joined.end(), o.begin(), o.begin() + hit_vertex + 1);
+    for (size_t i=0; i<=hole.size(); ++i) {
+        joined.push_back(hole[(m + i) % hole.size()]);
+    }
+    joined.insert(joined.end(), o.begin() + hit_vertex, o.end());
+    o.swap(joined);
+    return true;
+}
+
+// A loop's place in an order, and the loop.
+struct ranked_loop {
+    double rank;
+    size_t loop;
+};
+
+static bool higher_rank(const ranked_loop& l, const ranked_loop& r) {
+
+    return l.rank > r.rank;
+}
+
+void polygon_boolean(const double* ax, const double* ay, int an,
+                     const double* bx, const double* by, int bn,
+                     boolean_op op, polygon_loops& loops) {
+
+    loops.first.clear();
+    loops.x.clear();
+    loops.y.clear();
+
+    boolean_sweep w;
+    w.segments.reserve(2 * (an + bn));
+    w.endpoints.reserve(2 * (an + bn));
+    add_outline(w, ax, ay, an, 1);
+    add_outline(w, bx, by, bn, 2);
+    std::sort(w.endpoints.begin(), w.endpoints.end(), [&w](const boolean_event& l, const boolean_event& r) {
+        return earlier(w, l, r);
+    });
+    run_sweep(w);
+
+    // The result on the left of every edge.
+    std::vector<boolean_edge> edges;
+    for (size_t k=0; k<w.segments.size(); ++k) {
+        const boolean_segment& s = w.segments[k];
+        if (!s.done) continue;
+        bool in_below = inside(op, s.below);
+        bool in_above = inside(op, s.below ^ s.toggles);
+        if (in_below == in_above) continue;
+        boolean_edge e = { in_above ? s.start : s.end, in_above ? s.end : s.start };
+        edges.push_back(e);
+    }
+
+    std::vector<std::vector<grid_point> > chained;
+    chain_edges(edges, chained);
+
+    std::vector<std::vector<grid_point> > outers;
+    std::vector<ranked_loop> holes;
+    for (size_t l=0; l<chained.size(); ++l) {
+        drop_collinear(chained[l]);
+        if (chained[l].size() < 3) continue;
+        double area2 = loop_area2(chained[l]);
+        if (area2 > 0.0) {
+            outers.push_back(std::vector<grid_point>());
+            outers.back().swap(chained[l]);
+        } else if (area2 < 0.0) {
+            ranked_loop h = { -HUGE_VAL, l };
+            for (size_t i=0; i<chained[l].size(); ++i) {
+                h.rank = std::max(h.rank, chained[l][i].x);
+            }
+            holes.push_back(h);
+        }
+    }
+
+    // Right to left, a hole joined to its loop may be the one the next
+    // hole is cut to.
+    std::sort(holes.begin(), holes.end(), higher_rank);
+    for (size_t h=0; h<holes.size(); ++h) {
+        bridge_hole(outers, chained[holes[h].loop]);
+    }
+
+    std::vector<ranked_loop> order(outers.size());
+    for (size_t l=0; l<outers.size(); ++l) {
+        order[l].rank = loop_area2(outers[l]);
+        order[l].loop = l;
+    }
+    std::sort(order.begin(), order.end(), higher_rank);
+
+    loops.first.push_back(0);
+    for (size_t k=0; k<order.size(); ++k) {
+        const std::vector<grid_point>& o = outers[order[k].loop];
+        for (size_t i=0; i<o.size(); ++i) {
+            loops.x.push_back(o[i].x);
+            loops.y.push_back(o[i].y);
+        }
+        loops.first.push_back(static_cast<int>(loops.x.size()));
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef POLYGON_BOOLEAN_H_
+#define POLYGON_BOOLEAN_H_
+
+#include <vector>
+
+// Points closer than this, in grid units, are taken to be the same point,
+// and a point this close to an edge to lie on it.
+#define BOOLEAN_EPSILON 1e-9
+
+enum boolean_op {
+    BOOLEAN_UNION = 0,
+    BOOLEAN_INTERSECTION,
+    // The first outline minus the second.
+    BOOLEAN_DIFFERENCE
+};
+
+// Closed outlines, loop k is x, y[first[k]] .. [first[k+1] - 1].
+struct polygon_loops {
+    int count() const { return first.empty() ? 0 : static_cast<int>(first.size()) - 1; }
+    int size(int loop) const { return first[loop + 1] - first[loop]; }
+
+    std::vector<int> first;
+    std::vector<double> x;
+    std::vector<double> y;
+};
+
+// Union, intersection or difference of two closed outlines, each filled by
+// the even-odd rule, so either winding and crossing edges are fine.
+//
+// One sweep over both outlines, O((n + k) log n) for k edge crossings:
+// edges are split where they cross or touch, overlapping pieces merge into
+// one edge, and each edge learns from its neighbor below which outlines
+// cover either side of it. Edges with the result on one side only are
+// chained into loops.
+//
+// Fills loops with the result, largest first, each counter-clockwise and
+// without collinear vertices. A hole is joined to the loop around it
+// through a cut from its rightmost vertex, so every loop stands on its own
+// as a shape.
+void polygon_boolean(const double* ax, const double* ay, int an,
+                     const double* bx, const double* by, int bn,
+                     boolean_op op, polygon_loops& loops);
+
+#endif // POLYGON_BOOLEAN_H_
@@ -0,0 +1,404 @@
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "raster.h"
+#include "shape_library.h"
+
+raster_canvas::raster_canvas(int width, int height)
+: width_(width)
+, height_(height)
+, rgb_(3 * width * height, 0.0f)
+, cover_((width + 2) * height, 0.0f)
+, min_x_(width)
+, max_x_(0)
+, min_y_(height)
+, max_y_(0)
+{
+}
+
+void raster_canvas::clear(const raster_color& c) {
+
+    for (size_t i=0; i<rgb_.size(); i+=3) {
+        rgb_[i] = c.r;
+        rgb_[i+1] = c.g;
+        rgb_[i+2] = c.b;
+    }
+}
+
+void raster_canvas::path_line(double x0, double y0, double x1, double y1) {
+
+    // Split where the line leaves the image sideways. Pieces on the left
+    // still cover everything to their right, so they move onto the left
+    // border; pieces on the right cover nothing.
+    double w = width_;
+    double t[4];
+    int count = 0;
+    t[count++] = 0.0;
+    if ((x0 < 0.0) != (x1 < 0.0)) t[count++] = -x0 / (x1 - x0);
+    if ((x0 < w) != (x1 < w)) t[count++] = (w - x0) / (x1 - x0);
+    if (count == 3 && t[1] > t[2]) std::swap(t[1], t[2]);
+    t[count++] = 1.0;
+
+    for (int k=0; k+1<count; ++k) {
+        double xa = x0 + t[k] * (x1 - x0);
+        double ya = y0 + t[k] * (y1 - y0);
+        double xb = x0 + t[k+1] * (x1 - x0);
+        double yb = y0 + t[k+1] * (y1 - y0);
+        double mid = 0.5 * (xa + xb);
+        if (mid > w) {
+            // Coverage of the edges on the left then runs to the border.
+            max_x_ = width_ + 1;
+            continue;
+        }
+        if (mid < 0.0) {
+            xa = 0.0;
+            xb = 0.0;
+        }
+        add_line(std::min(std::max(xa, 0.0), w), ya, std::min(std::max(xb, 0.0), w), yb);
+    }
+}
+
+void raster_canvas::add_line(double x0, double y0, double x1, double y1) {
+
+    if (y0 == y1) return;
+
+    float dir = 1.0f;
+    if (y0 > y1) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+        dir = -1.0f;
+    }
+    double dxdy = (x1 - x0) / (y1 - y0);
+    int first = std::max(0, static_cast<int>(floor(y0)));
+    int last = std::min(height_, static_cast<int>(ceil(y1)));
+    if (first >= last) return;
+
+    min_y_ = std::min(min_y_, first);
+    max_y_ = std::max(max_y_, last);
+    min_x_ = std::min(min_x_, static_cast<int>(std::min(x0, x1)));
+    max_x_ = std::max(max_x_, static_cast<int>(ceil(std::max(x0, x1))) + 1);
+
+    int stride = width_ + 2;
+    for (int y=first; y<last; ++y) {
+        double top = std::max(static_cast<double>(y), y0);
+        double bottom = std::min(y + 1.0, y1);
+        if (bottom <= top) continue;
+
+        float* row = &cover_[y * stride];
+        float d = static_cast<float>(bottom - top) * dir;
+        double xa = x0 + (top - y0) * dxdy;
+        double xb = x0 + (bottom - y0) * dxdy;
+        double left = std::min(xa, xb);
+        double right = std::max(xa, xb);
+        double left_floor = floor(left);
+        int li = static_cast<int>(left_floor);
+        int ri = static_cast<int>(ceil(right));
+
+        if (ri <= li + 1) {
+            // Within one column: the part right of the crossing is
+            // covered here, the rest starts at the next pixel.
+            float f = static_cast<float>(0.5 * (xa + xb) - left_floor);
+            row[li] += d - d * f;
+            row[li + 1] += d * f;
+            continue;
+        }
+
+        // Across several columns the covered area grows linearly from
+        // the first column to the last.
+        float s = static_cast<float>(1.0 / (right - left));
+        float lf = static_cast<float>(left - left_floor);
+        float a0 = 0.5f * s * (1.0f - lf) * (1.0f - lf);
+        float rf = static_cast<float>(right - ri + 1);
+        float am = 0.5f * s * rf * rf;
+        row[li] += d * a0;
+        if (ri == li + 2) {
+            row[li + 1] += d * (1.0f - a0 - am);
+        } else {
+            float a1 = s * (1.5f - lf);
+            row[li + 1] += d * (a1 - a0);
+            for (int x=li+2; x<ri-1; ++x) {
+                row[x] += d * s;
+            }
+            float a2 = a1 + (ri - li - 3) * s;
+            row[ri - 1] += d * (1.0f - a2 - am);
+        }
+        row[ri] += d * am;
+    }
+}
+
+void raster_canvas::path_polygon(const double* x, const double* y, int n) {
+
+    for (int i=0; i<n; ++i) {
+        int j = (i + 1 == n) ? 0 : i + 1;
+        path_line(x[i], y[i], x[j], y[j]);
+    }
+}
+
+void raster_canvas::path_stroke(double x0, double y0, double x1, double y1, double width) {
+
+    double dx = x1 - x0;
+    double dy = y1 - y0;
+    double length = sqrt(dx * dx + dy * dy);
+    if (length == 0.0) return;
+
+    double nx = -dy / length * 0.5 * width;
+    double ny = dx / length * 0.5 * width;
+    double qx[4] = { x0 + nx, x1 + nx, x1 - nx, x0 - nx };
+    double qy[4] = { y0 + ny, y1 + ny, y1 - ny, y0 - ny };
+    path_polygon(qx, qy, 4);
+}
+
+void raster_canvas::fill(const raster_color& c, float alpha) {
+
+    int stride = width_ + 2;
+    int end_x = std::min(max_x_, width_ + 1);
+    for (int y=min_y_; y<max_y_; ++y) {
+        float* row = &cover_[y * stride];
+        float* pixel = &rgb_[3 * (y * width_ + min_x_)];
+        float sum = 0.0f;
+        for (int x=min_x_; x<=end_x; ++x) {
+            sum += row[x];
+            row[x] = 0.0f;
+            if (x >= width_) continue;
+
+            float a = std::min(fabsf(sum), 1.0f) * alpha;
+            pixel[0] += (c.r - pixel[0]) * a;
+            pixel[1] += (c.g - pixel[1]) * a;
+            pixel[2] += (c.b - pixel[2]) * a;
+            pixel += 3;
+        }
+    }
+
+    min_x_ = width_;
+    max_x_ = 0;
+    min_y_ = height_;
+    max_y_ = 0;
+}
+
+void raster_canvas::copy_to(raster_image& image, int x, int y) const {
+
+    // The part of the canvas that lands inside the image.
+    int first_row = std::max(0, -y);
+    int last_row = std::min(height_, image.height - y);
+    int first_col = std::max(0, -x);
+    int last_col = std::min(width_, image.width - x);
+    if (first_row >= last_row || first_col >= last_col) return;
+
+    int count = 3 * (last_col - first_col);
+    for (int row=first_row; row<last_row; ++row) {
+        const float* src = &rgb_[3 * (row * width_ + first_col)];
+        uint8_t* dst = &image.rgb[3 * ((y + row) * image.width + x + first_col)];
+        for (int k=0; k<count; ++k) {
+            float v = std::min(std::max(src[k], 0.0f), 1.0f);
+            dst[k] = static_cast<uint8_t>(v * 255.0f + 0.5f);
+        }
+    }
+}
+
+bool raster_write_ppm(const raster_image& image, const char* path) {
+
+    FILE *fSave = fopen(path, "wb");
+    if (fSave == 0) return false;
+
+    fprintf(fSave, "P6\n%d %d\n255\n", image.width, image.height);
+    fwrite(image.rgb.data(), 1, image.rgb.size(), fSave);
+
+    bool ok = (ferror(fSave) == 0);
+    return (fclose(fSave) == 0) && ok;
+}
+
+static void put_u32(std::vector<uint8_t>& out, uint32_t v) {
+
+    out.push_back(static_cast<uint8_t>(v >> 24));
+    out.push_back(static_cast<uint8_t>(v >> 16));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+// Length, type, data and the CRC over type and data.
+static void put_chunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+
+    put_u32(out, static_cast<uint32_t>(data.size()));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put_u32(out, library_crc32(0, &out[start], out.size() - start));
+}
+
+// Deflate output, bits filled from the least significant end.
+struct bit_writer {
+    explicit bit_writer(std::vector<uint8_t>& out) : out(out), bits(0), count(0) {}
+
+    void put(uint32_t value, int n) {
+        bits |= value << count;
+        count += n;
+        while (count >= 8) {
+            out.push_back(static_cast<uint8_t>(bits));
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+    // Huffman codes go most significant bit first.
+    void put_code(uint32_t code, int n) {
+        uint32_t reversed = 0;
+        for (int i=0; i<n; ++i) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        put(reversed, n);
+    }
+    void flush() {
+        if (count > 0) out.push_back(static_cast<uint8_t>(bits));
+        bits = 0;
+        count = 0;
+    }
+
+    std::vector<uint8_t>& out;
+    uint32_t bits;
+    int count;
+};
+
+static const int kLengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const int kLengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const int kDistanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const int kDistanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Literal/length symbol with the fixed Huffman code of RFC 1951.
+static void put_symbol(bit_writer& w, int symbol) {
+
+    if (symbol < 144) {
+        w.put_code(0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        w.put_code(0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        w.put_code(symbol - 256, 7);
+    } else {
+        w.put_code(0xc0 + symbol - 280, 8);
+    }
+}
+
+static void put_match(bit_writer& w, int length, int distance) {
+
+    int l = 28;
+    while (kLengthBase[l] > length) l--;
+    put_symbol(w, 257 + l);
+    w.put(length - kLengthBase[l], kLengthExtra[l]);
+
+    int d = 29;
+    while (kDistanceBase[d] > distance) d--;
+    w.put_code(d, 5);
+    w.put(distance - kDistanceBase[d], kDistanceExtra[d]);
+}
+
+#define DEFLATE_WINDOW 32768
+#define DEFLATE_HASH_BITS 15
+
+// One block with the fixed codes, greedy matches against the last
+// position each 3-byte prefix was seen at. Thumbnails are mostly runs of
+// background, which this already shrinks well, without zlib.
+static void deflate_fixed(const std::vector<uint8_t>& raw, std::vector<uint8_t>& out) {
+
+    bit_writer w(out);
+    w.put(1, 1);    // last block
+    w.put(1, 2);    // fixed Huffman codes
+
+    std::vector<int> last(1 << DEFLATE_HASH_BITS, -1);
+    int n = static_cast<int>(raw.size());
+    int i = 0;
+    while (i < n) {
+        int length = 0;
+        int distance = 0;
+        if (i + 3 <= n) {
+            uint32_t h = (raw[i] << 16 | raw[i+1] << 8 | raw[i+2]) * 2654435761u >> (32 - DEFLATE_HASH_BITS);
+            int candidate = last[h];
+            last[h] = i;
+            if (candidate >= 0 && i - candidate <= DEFLATE_WINDOW) {
+                int limit = std::min(258, n - i);
+                while (length < limit && raw[candidate + length] == raw[i + length]) length++;
+                distance = i - candidate;
+            }
+        }
+        if (length < 3) {
+            put_symbol(w, raw[i]);
+            i++;
+            continue;
+        }
+        put_match(w, length, distance);
+        i += length;
+    }
+    put_symbol(w, 256);
+    w.flush();
+}
+
+static uint32_t adler32(const std::vector<uint8_t>& data) {
+
+    uint32_t a = 1;
+    uint32_t b = 0;
+    // 5552 bytes are the most the sums take before they can overflow.
+    for (size_t i=0; i<data.size(); ) {
+        size_t end = std::min(data.size(), i + 5552);
+        for (; i<end; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+bool raster_write_png(const raster_image& image, const char* path) {
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    std::vector<uint8_t> png(signature, signature + 8);
+
+    std::vector<uint8_t> header;
+    put_u32(header, image.width);
+    put_u32(header, image.height);
+    header.push_back(8);    // bits per channel
+    header.push_back(2);    // RGB
+    header.push_back(0);    // deflate
+    header.push_back(0);    // adaptive filtering
+    header.push_back(0);    // not interlaced
+    put_chunk(png, "IHDR", header);
+
+    // Every row behind a filter byte of 0, none.
+    size_t row_size = 3 * image.width;
+    std::vector<uint8_t> raw;
+    raw.reserve(image.height * (row_size + 1));
+    for (int y=0; y<image.height; ++y) {
+        raw.push_back(0);
+        raw.insert(raw.end(), image.rgb.begin() + y * row_size, image.rgb.begin() + (y + 1) * row_size);
+    }
+
+    // zlib stream: header, one deflate block, Adler-32 of the raw data.
+    std::vector<uint8_t> data;
+    data.reserve(raw.size() / 4 + 64);
+    data.push_back(0x78);
+    data.push_back(0x01);
+    deflate_fixed(raw, data);
+    put_u32(data, adler32(raw));
+    put_chunk(png, "IDAT", data);
+    put_chunk(png, "IEND", std::vector<uint8_t>());
+
+    FILE *fSave = fopen(path, "wb");
+    if (fSave == 0) return false;
+
+    fwrite(png.data(), 1, png.size(), fSave);
+
+    bool ok = (ferror(fSave) == 0);
+    return (fclose(fSave) == 0) && ok;
+}
@@ -0,0 +1,67 @@
+#ifndef RASTER_H_
+#define RASTER_H_
+
+#include <stdint.h>
+#include <vector>
+
+// 8-bit RGB pixels, rows top to bottom.
+struct raster_image {
+    raster_image() : width(0), height(0) {}
+    raster_image(int w, int h) : width(w), height(h), rgb(3 * w * h, 0) {}
+
+    int width;
+    int height;
+    std::vector<uint8_t> rgb;
+};
+
+struct raster_color {
+    float r;
+    float g;
+    float b;
+};
+
+// Software drawing without GL. Paths are closed outlines in pixel
+// coordinates, y down. Filling accumulates the signed area every edge
+// covers in each pixel, so edges come out anti-aliased with exact
+// coverage. Overlapping outlines of the same orientation add up, and
+// coverage is clamped to one, which makes a stroke drawn as one quad per
+// segment look like a single shape.
+//
+// Not thread safe; use one canvas per thread.
+struct raster_canvas {
+    raster_canvas(int width, int height);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    void clear(const raster_color& c);
+
+    void path_line(double x0, double y0, double x1, double y1);
+    void path_polygon(const double* x, const double* y, int n);
+    // A segment width pixels wide, as a quad with the orientation every
+    // other stroke gets, so a whole polyline can be filled at once.
+    void path_stroke(double x0, double y0, double x1, double y1, double width);
+    // Blends color over the pixels the path covers and clears the path.
+    void fill(const raster_color& c, float alpha);
+
+    // Copies the canvas into image with its top left corner at x, y.
+    void copy_to(raster_image& image, int x, int y) const;
+
+private:
+    void add_line(double x0, double y0, double x1, double y1);
+
+    int width_;
+    int height_;
+    std::vector<float> rgb_;
+    // Per pixel area deltas, width_ + 2 per row; the running sum along a
+    // row is the coverage.
+    std::vector<float> cover_;
+    // Rows and columns the current path touched.
+    int min_x_, max_x_;
+    int min_y_, max_y_;
+};
+
+bool raster_write_ppm(const raster_image& image, const char* path);
+bool raster_write_png(const raster_image& image, const char* path);
+
+#endif // RASTER_H_
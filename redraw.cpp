@@ -0,0 +1,136 @@
+#include <GL/glut.h>
+
+#include <algorithm>
+
+#include "redraw.h"
+
+static unsigned dirty_layers_ = 0;
+static bool frame_pending_ = false;
+
+static bool animate_enable_ = false;
+static bool timer_armed_ = false;
+static void (*animate_tick_)() = 0;
+static int animate_interval_ = 0;
+
+static bool motion_pending_ = false;
+static int motion_x_ = 0;
+static int motion_y_ = 0;
+
+static int window_start_ = 0;
+static int window_frames_ = 0;
+static int window_coalesced_ = 0;
+static int window_received_ = 0;
+static int window_processed_ = 0;
+static int frames_per_second_ = 0;
+static int skipped_per_second_ = 0;
+static int coalesced_per_second_ = 0;
+static int received_per_second_ = 0;
+static int processed_per_second_ = 0;
+
+void redraw_request(unsigned layers) {
+
+    dirty_layers_ |= layers;
+    if (frame_pending_) {
+        // Folded into the frame that is already on its way.
+        window_coalesced_++;
+        return;
+    }
+
+    frame_pending_ = true;
+    glutPostRedisplay();
+}
+
+unsigned redraw_begin_frame() {
+
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    int elapsed = now - window_start_;
+    if (elapsed >= 1000) {
+        frames_per_second_ = window_frames_ * 1000 / elapsed;
+        coalesced_per_second_ = window_coalesced_ * 1000 / elapsed;
+        // Refresh intervals that went by without a frame.
+        skipped_per_second_ = std::max(0, REDRAW_REFRESH_HZ - frames_per_second_);
+        received_per_second_ = window_received_ * 1000 / elapsed;
+        processed_per_second_ = window_processed_ * 1000 / elapsed;
+        window_start_ = now;
+        window_frames_ = 0;
+        window_coalesced_ = 0;
+        window_received_ = 0;
+        window_processed_ = 0;
+    }
+    window_frames_++;
+
+    // Expose and reshape redraws come from GLUT without a request.
+    unsigned layers = dirty_layers_ != 0 ? dirty_layers_ : static_cast<unsigned>(REDRAW_ALL);
+    dirty_layers_ = 0;
+    frame_pending_ = false;
+
+    return layers;
+}
+
+void redraw_queue_motion(int x, int y) {
+
+    motion_x_ = x;
+    motion_y_ = y;
+    motion_pending_ = true;
+    window_received_++;
+}
+
+bool redraw_take_motion(int* x, int* y) {
+
+    if (!motion_pending_) return false;
+
+    *x = motion_x_;
+    *y = motion_y_;
+    motion_pending_ = false;
+    window_processed_++;
+    return true;
+}
+
+static void animate_timer(int) {
+
+    if (!animate_enable_) {
+        timer_armed_ = false;
+        return;
+    }
+
+    animate_tick_();
+    redraw_request(REDRAW_ANIMATION);
+    glutTimerFunc(animate_interval_, animate_timer, 0);
+}
+
+void redraw_animate(bool enable, void (*tick)(), int interval_ms) {
+
+    animate_enable_ = enable;
+    animate_tick_ = tick;
+    animate_interval_ = interval_ms;
+
+    if (enable && !timer_armed_) {
+        timer_armed_ = true;
+        glutTimerFunc(animate_interval_, animate_timer, 0);
+    }
+}
+
+int redraw_frames_per_second() {
+
+    return frames_per_second_;
+}
+
+int redraw_skipped_per_second() {
+
+    return skipped_per_second_;
+}
+
+int redraw_coalesced_per_second() {
+
+    return coalesced_per_second_;
+}
+
+int redraw_motion_received_per_second() {
+
+    return received_per_second_;
+}
+
+int redraw_motion_processed_per_second() {
+
+    return processed_per_second_;
+}
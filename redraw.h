@@ -0,0 +1,43 @@
+#ifndef REDRAW_H_
+#define REDRAW_H_
+
+// Layers an event can damage. The back buffer is undefined after a swap, so
+// every frame is drawn whole, but a frame that left the scene and its
+// animation clean puts back a copy of the scene instead of drawing it.
+enum {
+    REDRAW_SCENE = 1 << 0,
+    REDRAW_HUD = 1 << 1,
+    REDRAW_ANIMATION = 1 << 2,
+    REDRAW_ALL = REDRAW_SCENE | REDRAW_HUD | REDRAW_ANIMATION
+};
+
+// Marks layers dirty and schedules one frame for all requests that arrive
+// before it is drawn.
+void redraw_request(unsigned layers);
+// Called at the top of display(), returns the dirty layers and clears them.
+// Frames GLUT asks for without a request, on expose or reshape, get all.
+unsigned redraw_begin_frame();
+// Runs tick every interval_ms while enabled, requesting an animation frame
+// each time. Disabled, no timer is armed and the editor sleeps in GLUT.
+void redraw_animate(bool enable, void (*tick)(), int interval_ms);
+
+// Pointer motion waits for the frame instead of being handled per event:
+// a queued position replaces the one not yet taken, and the frame takes
+// the latest once. Returns false when nothing moved since the last take.
+void redraw_queue_motion(int x, int y);
+bool redraw_take_motion(int* x, int* y);
+
+// A display refreshing this often would show a frame each time if the
+// editor redrew continuously.
+#define REDRAW_REFRESH_HZ 60
+
+// Statistics of the last full second. Skipped frames are refreshes that
+// showed no new frame because nothing was dirty; coalesced requests were
+// folded into a frame already scheduled.
+int redraw_frames_per_second();
+int redraw_skipped_per_second();
+int redraw_coalesced_per_second();
+int redraw_motion_received_per_second();
+int redraw_motion_processed_per_second();
+
+#endif // REDRAW_H_
@@ -0,0 +1,460 @@
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <math.h>
+
+#include <algorithm>
+
+#include "render_cache.h"
+
+// Decimated outlines are only worth it for shapes with more than
+// SHAPE_LOD_MIN_VERTICES vertices and more than SHAPE_LOD_PER_PIXEL per
+// pixel around their bounds.
+#define SHAPE_LOD_MIN_VERTICES 256
+#define SHAPE_LOD_PER_PIXEL 2.0
+
+vertex_buffer::vertex_buffer()
+: id_(0)
+, size_(0)
+, capacity_(0)
+{
+}
+
+void vertex_buffer::stage(const double* x, const double* y, int n) {
+
+    staging_.resize(2 * n);
+    for (int i=0; i<n; ++i) {
+        staging_[2*i] = static_cast<GLfloat>(x[i]);
+        staging_[2*i+1] = static_cast<GLfloat>(y[i]);
+    }
+}
+
+void vertex_buffer::upload(const double* x, const double* y, int n) {
+
+    if (id_ == 0) {
+        glGenBuffers(1, &id_);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, id_);
+    if (n > capacity_) {
+        capacity_ = n;
+        glBufferData(GL_ARRAY_BUFFER, capacity_ * 2 * sizeof(GLfloat), 0, GL_DYNAMIC_DRAW);
+    }
+    if (n > 0) {
+        stage(x, y, n);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, n * 2 * sizeof(GLfloat), staging_.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    size_ = n;
+}
+
+void vertex_buffer::update(int first, const double* x, const double* y, int n) {
+
+    if (n <= 0) return;
+
+    stage(x, y, n);
+    glBindBuffer(GL_ARRAY_BUFFER, id_);
+    glBufferSubData(GL_ARRAY_BUFFER, first * 2 * sizeof(GLfloat), n * 2 * sizeof(GLfloat), staging_.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void vertex_buffer::bind() const {
+
+    glBindBuffer(GL_ARRAY_BUFFER, id_);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, 0);
+}
+
+void vertex_buffer::unbind() const {
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Pending transform of a shape as the modelview matrix.
+void push_shape_transform(const shape_store& store, int shape) {
+
+    const affine& t = store.pending_transform(shape);
+    GLdouble m[16] = {
+        t.a,  t.c,  0.0, 0.0,
+        t.b,  t.d,  0.0, 0.0,
+        0.0,  0.0,  1.0, 0.0,
+        t.tx, t.ty, 0.0, 1.0
+    };
+    glPushMatrix();
+    glMultMatrixd(m);
+}
+
+shape_buffers::shape_buffers()
+: layout_version_(0)
+{
+    stats_.drawn = 0;
+    stats_.culled = 0;
+    stats_.decimated = 0;
+}
+
+void shape_buffers::update_bounds(const shape_store& store, int shape) {
+
+    const double* x = store.xs(shape);
+    const double* y = store.ys(shape);
+    int n = store.size(shape);
+    grid_box& b = bounds_[shape];
+    if (n == 0) {
+        b.min.x = b.min.y = b.max.x = b.max.y = 0.0;
+        return;
+    }
+    b.min.x = b.max.x = x[0];
+    b.min.y = b.max.y = y[0];
+    for (int i=1; i<n; ++i) {
+        b.min.x = std::min(b.min.x, x[i]);
+        b.max.x = std::max(b.max.x, x[i]);
+        b.min.y = std::min(b.min.y, y[i]);
+        b.max.y = std::max(b.max.y, y[i]);
+    }
+}
+
+grid_box shape_buffers::bounds(const shape_store& store, int shape) const {
+
+    const grid_box& b = bounds_[shape];
+    if (!store.has_transform(shape)) return b;
+
+    // The box around the transformed corners holds the transformed shape.
+    const affine& t = store.pending_transform(shape);
+    grid_point corners[4] = { b.min, { b.max.x, b.min.y }, b.max, { b.min.x, b.max.y } };
+    grid_box r;
+    r.min = r.max = t.apply(corners[0]);
+    for (int k=1; k<4; ++k) {
+        grid_point p = t.apply(corners[k]);
+        r.min.x = std::min(r.min.x, p.x);
+        r.max.x = std::max(r.max.x, p.x);
+        r.min.y = std::min(r.min.y, p.y);
+        r.max.y = std::max(r.max.y, p.y);
+    }
+    return r;
+}
+
+void shape_buffers::sync(const shape_store& store) {
+
+    int slots = static_cast<int>(store.x.size());
+    int count = store.shape_count();
+
+    if (slots != buffer_.size() || store.layout_version() != layout_version_
+        || count < static_cast<int>(versions_.size())) {
+        // Shapes moved or the arrays changed size, send everything.
+        buffer_.upload(store.x.data(), store.y.data(), slots);
+        layout_version_ = store.layout_version();
+        versions_.resize(count);
+        bounds_.resize(count);
+        for (int k=0; k<count; ++k) {
+            versions_[k] = store.version(k);
+            update_bounds(store, k);
+        }
+        return;
+    }
+
+    // New shapes start empty, they only need a version to compare with.
+    while (static_cast<int>(versions_.size()) < count) {
+        versions_.push_back(store.version(static_cast<int>(versions_.size())));
+        bounds_.resize(versions_.size());
+        update_bounds(store, static_cast<int>(versions_.size()) - 1);
+    }
+
+    for (int k=0; k<count; ++k) {
+        if (versions_[k] == store.version(k)) continue;
+
+        const shape_range& r = store.ranges[k];
+        buffer_.update(static_cast<int>(r.offset), &store.x[r.offset], &store.y[r.offset], static_cast<int>(r.length));
+        versions_[k] = store.version(k);
+        update_bounds(store, k);
+    }
+}
+
+bool shape_buffers::update_lod(const shape_store& store, int shape, int level) {
+
+    lod_outline& lod = lods_[shape];
+    if (!lod.x.empty() && lod.version == store.version(shape) && lod.level == level) return false;
+
+    // At most a pixel off, the outline looks the same.
+    double tolerance = ldexp(1.0, level);
+    const double* x = store.xs(shape);
+    const double* y = store.ys(shape);
+    int n = store.size(shape);
+    lod.x.assign(1, x[0]);
+    lod.y.assign(1, y[0]);
+    for (int i=1; i<n; ++i) {
+        if (fabs(x[i] - lod.x.back()) < tolerance && fabs(y[i] - lod.y.back()) < tolerance) continue;
+        lod.x.push_back(x[i]);
+        lod.y.push_back(y[i]);
+    }
+    lod.version = store.version(shape);
+    lod.level = level;
+    return true;
+}
+
+// Outlines of other levels are dropped, the view left them behind.
+void shape_buffers::upload_lods(int level) {
+
+    std::vector<double> x;
+    std::vector<double> y;
+    for (size_t k=0; k<lods_.size(); ++k) {
+        lod_outline& lod = lods_[k];
+        if (lod.level != level) {
+            std::vector<double>().swap(lod.x);
+            std::vector<double>().swap(lod.y);
+        }
+        if (lod.x.empty()) continue;
+        lod.first = static_cast<int>(x.size());
+        x.insert(x.end(), lod.x.begin(), lod.x.end());
+        y.insert(y.end(), lod.y.begin(), lod.y.end());
+    }
+    lod_buffer_.upload(x.data(), y.data(), static_cast<int>(x.size()));
+}
+
+void shape_buffers::draw_fills(const shape_store& store, shape_triangles& triangles, const grid_box& visible) {
+
+    fills_.resize(store.shape_count());
+    buffer_.bind();
+    for (int k=0; k<store.shape_count(); ++k) {
+        if (store.size(k) < 3 || !bounds(store, k).overlaps(visible)) continue;
+
+        fill_indices& fill = fills_[k];
+        const shape_range& r = store.ranges[k];
+        if (!fill.valid || fill.version != r.version || fill.offset != r.offset) {
+            const std::vector<int>& t = triangles.triangles(store, k);
+            fill.indices.resize(t.size());
+            for (size_t i=0; i<t.size(); ++i) {
+                fill.indices[i] = static_cast<GLuint>(r.offset + t[i]);
+            }
+            fill.version = r.version;
+            fill.offset = r.offset;
+            fill.valid = true;
+        }
+        if (fill.indices.empty()) continue;
+
+        GLsizei count = static_cast<GLsizei>(fill.indices.size());
+        if (store.has_transform(k)) {
+            push_shape_transform(store, k);
+            glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, fill.indices.data());
+            glPopMatrix();
+            continue;
+        }
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, fill.indices.data());
+    }
+    buffer_.unbind();
+}
+
+void shape_buffers::draw_loops(const shape_store& store, int skip_a, int skip_b,
+                               const grid_box& visible, double pixel_size) {
+
+    listed_.clear();
+    for (int k=0; k<store.shape_count(); ++k) {
+        if (k != skip_a && k != skip_b) listed_.push_back(k);
+    }
+    stats_.drawn = 0;
+    stats_.culled = 0;
+    stats_.decimated = 0;
+    draw_list(store, listed_, visible, pixel_size, stats_);
+}
+
+void shape_buffers::draw_loops(const shape_store& store, const std::vector<int>& shapes,
+                               const grid_box& visible, double pixel_size) {
+
+    shape_draw_stats ignored = { 0, 0, 0 };
+    draw_list(store, shapes, visible, pixel_size, ignored);
+}
+
+void shape_buffers::draw_moved(const shape_store& store, const std::vector<int>& list,
+                               const std::vector<GLint>& firsts, const std::vector<GLsizei>& counts) {
+
+    size_t i = 0;
+    while (i < list.size()) {
+        const affine& t = store.pending_transform(list[i]);
+        size_t j = i + 1;
+        while (j < list.size() && store.pending_transform(list[j]) == t) j++;
+
+        push_shape_transform(store, list[i]);
+        glMultiDrawArrays(GL_LINE_LOOP, &firsts[i], &counts[i], static_cast<GLsizei>(j - i));
+        glPopMatrix();
+        i = j;
+    }
+}
+
+void shape_buffers::draw_list(const shape_store& store, const std::vector<int>& shapes,
+                              const grid_box& visible, double pixel_size, shape_draw_stats& stats) {
+
+    lods_.resize(store.shape_count());
+    int level = static_cast<int>(floor(log2(pixel_size)));
+    bool lods_changed = false;
+
+    firsts_.clear();
+    counts_.clear();
+    moved_.clear();
+    moved_firsts_.clear();
+    moved_counts_.clear();
+    lod_shapes_.clear();
+    for (size_t i=0; i<shapes.size(); ++i) {
+        int k = shapes[i];
+        int n = store.size(k);
+        if (n == 0) continue;
+
+        grid_box b = bounds(store, k);
+        if (!b.overlaps(visible)) {
+            stats.culled++;
+            continue;
+        }
+        stats.drawn++;
+
+        double around = 2.0 * ((b.max.x - b.min.x) + (b.max.y - b.min.y)) / pixel_size;
+        if (n > SHAPE_LOD_MIN_VERTICES && n > SHAPE_LOD_PER_PIXEL * around) {
+            lods_changed = update_lod(store, k, level) || lods_changed;
+            lod_shapes_.push_back(k);
+            stats.decimated++;
+            continue;
+        }
+        if (store.has_transform(k)) {
+            // Needs a matrix, cannot join the untransformed batch.
+            moved_.push_back(k);
+            moved_firsts_.push_back(static_cast<GLint>(store.ranges[k].offset));
+            moved_counts_.push_back(static_cast<GLsizei>(store.ranges[k].length));
+            continue;
+        }
+        firsts_.push_back(static_cast<GLint>(store.ranges[k].offset));
+        counts_.push_back(static_cast<GLsizei>(store.ranges[k].length));
+    }
+    if (!firsts_.empty() || !moved_.empty()) {
+        buffer_.bind();
+        if (!firsts_.empty()) {
+            glMultiDrawArrays(GL_LINE_LOOP, firsts_.data(), counts_.data(), static_cast<GLsizei>(firsts_.size()));
+        }
+        draw_moved(store, moved_, moved_firsts_, moved_counts_);
+        buffer_.unbind();
+    }
+
+    if (lod_shapes_.empty()) return;
+    if (lods_changed) upload_lods(level);
+
+    firsts_.clear();
+    counts_.clear();
+    moved_.clear();
+    moved_firsts_.clear();
+    moved_counts_.clear();
+    for (size_t i=0; i<lod_shapes_.size(); ++i) {
+        int k = lod_shapes_[i];
+        const lod_outline& lod = lods_[k];
+        if (store.has_transform(k)) {
+            moved_.push_back(k);
+            moved_firsts_.push_back(lod.first);
+            moved_counts_.push_back(static_cast<GLsizei>(lod.x.size()));
+            continue;
+        }
+        firsts_.push_back(lod.first);
+        counts_.push_back(static_cast<GLsizei>(lod.x.size()));
+    }
+    lod_buffer_.bind();
+    if (!firsts_.empty()) {
+        glMultiDrawArrays(GL_LINE_LOOP, firsts_.data(), counts_.data(), static_cast<GLsizei>(firsts_.size()));
+    }
+    draw_moved(store, moved_, moved_firsts_, moved_counts_);
+    lod_buffer_.unbind();
+}
+
+void shape_buffers::draw_loop(const shape_store& store, int shape) {
+
+    if (store.size(shape) == 0) return;
+
+    push_shape_transform(store, shape);
+    buffer_.bind();
+    glDrawArrays(GL_LINE_LOOP, static_cast<GLint>(store.ranges[shape].offset), store.size(shape));
+    buffer_.unbind();
+    glPopMatrix();
+}
+
+void shape_buffers::draw_points(const shape_store& store, int shape, int first, int count) {
+
+    if (count <= 0) return;
+
+    push_shape_transform(store, shape);
+    buffer_.bind();
+    glDrawArrays(GL_POINTS, static_cast<GLint>(store.ranges[shape].offset) + first, count);
+    buffer_.unbind();
+    glPopMatrix();
+}
+
+frame_copy::frame_copy()
+: texture_(0)
+, width_(0)
+, height_(0)
+, texture_width_(0)
+, texture_height_(0)
+, valid_(false)
+{
+}
+
+// Smallest power of two not below n, the only texture sizes GL 1.1 has.
+static int texture_size(int n) {
+
+    int size = 1;
+    while (size < n) size <<= 1;
+    return size;
+}
+
+void frame_copy::save(int width, int height) {
+
+    if (texture_ == 0) {
+        glGenTextures(1, &texture_);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    if (width > texture_width_ || height > texture_height_) {
+        texture_width_ = texture_size(width);
+        texture_height_ = texture_size(height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texture_width_, texture_height_, 0,
+                     GL_RGB, GL_UNSIGNED_BYTE, 0);
+    }
+    glReadBuffer(GL_BACK);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    width_ = width;
+    height_ = height;
+    valid_ = true;
+}
+
+bool frame_copy::restore(int width, int height) {
+
+    if (!valid_ || width != width_ || height != height_) return false;
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, width, 0, height, -1.0, 1.0);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    GLdouble s = static_cast<GLdouble>(width) / texture_width_;
+    GLdouble t = static_cast<GLdouble>(height) / texture_height_;
+
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+    glDisable(GL_BLEND);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    glBegin(GL_QUADS);
+        glTexCoord2d(0.0, 0.0); glVertex2i(0, 0);
+        glTexCoord2d(s, 0.0);   glVertex2i(width, 0);
+        glTexCoord2d(s, t);     glVertex2i(width, height);
+        glTexCoord2d(0.0, t);   glVertex2i(0, height);
+    glEnd();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPopAttrib();
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    return true;
+}
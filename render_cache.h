@@ -0,0 +1,154 @@
+#ifndef RENDER_CACHE_H_
+#define RENDER_CACHE_H_
+
+#include <GL/gl.h>
+#include <vector>
+
+#include "geometry.h"
+#include "shape_store.h"
+#include "triangulate.h"
+
+// Buffer object holding 2D vertices as interleaved floats. Only plain
+// GL 1.5 buffers and client vertex arrays are used, so this runs on
+// software rasterizers such as llvmpipe.
+struct vertex_buffer {
+    vertex_buffer();
+
+    // Replaces the contents, growing the buffer if needed.
+    void upload(const double* x, const double* y, int n);
+    // Overwrites vertices [first, first + n), which must already exist.
+    void update(int first, const double* x, const double* y, int n);
+
+    void bind() const;
+    void unbind() const;
+    int size() const { return size_; }
+
+private:
+    void stage(const double* x, const double* y, int n);
+
+    GLuint id_;
+    int size_;
+    int capacity_;
+    std::vector<GLfloat> staging_;
+};
+
+// What the last shape_buffers::draw_loops() did with the shapes it was
+// given.
+struct shape_draw_stats {
+    int drawn;
+    int culled;
+    int decimated;          // drawn from a decimated outline
+};
+
+// GPU mirror of a shape_store. The buffer follows the store layout slot for
+// slot, so a changed shape is re-uploaded in place; only a layout change
+// sends everything again. Pending shape transforms are drawn as modelview
+// matrices, a gesture in progress uploads nothing.
+//
+// Bounds of every shape are kept along with the upload, so shapes outside
+// the view are skipped without looking at their vertices. Shapes with the
+// same pending transform, such as a selection being dragged, share one
+// matrix and one draw call. Outlines with
+// far more vertices than the pixels they cover are drawn from a copy
+// decimated to about a pixel, made once per zoom level and shape version.
+struct shape_buffers {
+    shape_buffers();
+
+    void sync(const shape_store& store);
+
+    // Outlines of all shapes except skip_a and skip_b that overlap visible,
+    // in one draw call per buffer. pixel_size is in grid units.
+    void draw_loops(const shape_store& store, int skip_a, int skip_b,
+                    const grid_box& visible, double pixel_size);
+    // Outlines of the listed shapes, without touching stats().
+    void draw_loops(const shape_store& store, const std::vector<int>& shapes,
+                    const grid_box& visible, double pixel_size);
+    void draw_loop(const shape_store& store, int shape);
+    void draw_points(const shape_store& store, int shape, int first, int count);
+    // Insides of all shapes that overlap visible, from their cached
+    // triangles, in the current color.
+    void draw_fills(const shape_store& store, shape_triangles& triangles, const grid_box& visible);
+
+    // As drawn, pending transform included. Only valid after sync().
+    grid_box bounds(const shape_store& store, int shape) const;
+    const shape_draw_stats& stats() const { return stats_; }
+
+private:
+    // Committed outline with vertices closer than 2^level to the last one
+    // kept dropped, stored at first in lod_buffer_.
+    struct lod_outline {
+        lod_outline() : version(0), level(0), first(0) {}
+
+        unsigned version;
+        int level;
+        int first;
+        std::vector<double> x;
+        std::vector<double> y;
+    };
+
+    // Triangles of a shape as indices into buffer_, for its version and
+    // place in the layout.
+    struct fill_indices {
+        fill_indices() : version(0), offset(0), valid(false) {}
+
+        unsigned version;
+        size_t offset;
+        bool valid;
+        std::vector<GLuint> indices;
+    };
+
+    void update_bounds(const shape_store& store, int shape);
+    bool update_lod(const shape_store& store, int shape, int level);
+    void upload_lods(int level);
+    void draw_list(const shape_store& store, const std::vector<int>& shapes,
+                   const grid_box& visible, double pixel_size, shape_draw_stats& stats);
+    // Loops of list, from buffer at firsts, in one call per run of shapes
+    // with the same pending transform.
+    void draw_moved(const shape_store& store, const std::vector<int>& list,
+                    const std::vector<GLint>& firsts, const std::vector<GLsizei>& counts);
+
+    vertex_buffer buffer_;
+    unsigned layout_version_;
+    std::vector<unsigned> versions_;
+    std::vector<grid_box> bounds_;
+    std::vector<GLint> firsts_;
+    std::vector<GLsizei> counts_;
+    std::vector<int> listed_;
+    std::vector<int> moved_;
+    std::vector<GLint> moved_firsts_;
+    std::vector<GLsizei> moved_counts_;
+
+    std::vector<lod_outline> lods_;
+    vertex_buffer lod_buffer_;
+    std::vector<int> lod_shapes_;
+
+    std::vector<fill_indices> fills_;
+    shape_draw_stats stats_;
+};
+
+// The back buffer as a texture, so a frame whose scene did not change can
+// put it back with one quad instead of drawing every shape again.
+struct frame_copy {
+    frame_copy();
+
+    // Copies the lower left width x height pixels of the back buffer.
+    void save(int width, int height);
+    // Draws the saved pixels where they came from. False, drawing nothing,
+    // if no copy of that size was saved since the last invalidate().
+    bool restore(int width, int height);
+    void invalidate() { valid_ = false; }
+
+private:
+    GLuint texture_;
+    int width_;
+    int height_;
+    int texture_width_;
+    int texture_height_;
+    bool valid_;
+};
+
+// Multiplies the shape's pending transform onto the modelview matrix, for
+// drawing data made from its committed coordinates. Pair with glPopMatrix().
+void push_shape_transform(const shape_store& store, int shape);
+
+#endif // RENDER_CACHE_H_
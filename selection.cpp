@@ -0,0 +1,39 @@
+#include <algorithm>
+
+#include "selection.h"
+
+void shape_selection::add(int shape) {
+
+    if (contains(shape)) return;
+
+    if (shape >= static_cast<int>(picked_.size())) {
+        picked_.resize(shape + 1, 0);
+    }
+    picked_[shape] = 1;
+    shapes_.push_back(shape);
+}
+
+void shape_selection::remove(int shape) {
+
+    if (!contains(shape)) return;
+
+    picked_[shape] = 0;
+    shapes_.erase(std::find(shapes_.begin(), shapes_.end(), shape));
+}
+
+void shape_selection::toggle(int shape) {
+
+    if (contains(shape)) {
+        remove(shape);
+    } else {
+        add(shape);
+    }
+}
+
+void shape_selection::clear() {
+
+    for (size_t i=0; i<shapes_.size(); ++i) {
+        picked_[shapes_[i]] = 0;
+    }
+    shapes_.clear();
+}
@@ -0,0 +1,28 @@
+#ifndef SELECTION_H_
+#define SELECTION_H_
+
+#include <vector>
+
+// Set of picked shapes, in the order they were picked. Membership is a
+// flag per shape slot, so contains() is O(1) however many are picked.
+struct shape_selection {
+    shape_selection() {}
+
+    bool empty() const { return shapes_.empty(); }
+    int count() const { return static_cast<int>(shapes_.size()); }
+    const std::vector<int>& shapes() const { return shapes_; }
+    bool contains(int shape) const {
+        return shape < static_cast<int>(picked_.size()) && picked_[shape] != 0;
+    }
+
+    void add(int shape);
+    void remove(int shape);
+    void toggle(int shape);
+    void clear();
+
+private:
+    std::vector<int> shapes_;
+    std::vector<char> picked_;
+};
+
+#endif // SELECTION_H_
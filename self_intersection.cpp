@@ -0,0 +1,513 @@
+#include <math.h>
+
+#include <algorithm>
+#include <queue>
+#include <set>
+#include <unordered_set>
+
+#include "self_intersection.h"
+
+// Cells per side of the outline's bounding box at most, so dragging a vertex
+// far away does not make its edges cover millions of cells.
+#define CROSSING_GRID_MAX 1024
+
+enum sweep_event_type {
+    SWEEP_END = 0,
+    SWEEP_CROSS,
+    SWEEP_START
+};
+
+struct sweep_event {
+    double x;
+    double y;
+    int type;
+    int a;
+    int b;
+};
+
+// Edge with its endpoints ordered by x, then y.
+struct sweep_segment {
+    double x0;
+    double y0;
+    double x1;
+    double y1;
+};
+
+// Earliest event on top of the queue.
+struct later_event {
+    bool operator()(const sweep_event& l, const sweep_event& r) const {
+        if (l.x != r.x) return l.x > r.x;
+        if (l.y != r.y) return l.y > r.y;
+        return l.type > r.type;
+    }
+};
+
+// Slots keep their place in the tree, a crossing swaps the segments of two
+// neighboring slots instead.
+struct sweep_slot {
+    mutable int segment;
+};
+
+struct sweep;
+
+// Bottom to top by height at the sweep point.
+struct sweep_order {
+    explicit sweep_order(const sweep* w) : w(w) {}
+    bool operator()(const sweep_slot& l, const sweep_slot& r) const;
+
+    const sweep* w;
+};
+
+typedef std::multiset<sweep_slot, sweep_order> sweep_status;
+
+struct sweep {
+    sweep(const double* x, const double* y, int n, std::vector<edge_pair>& pairs);
+
+    const double* x;
+    const double* y;
+    int n;
+    double sx;
+    double sy;
+    std::vector<sweep_segment> segments;
+    sweep_status active;
+    // Slot of each segment, end() when it is not in the sweep.
+    std::vector<sweep_status::iterator> where;
+    // Segments that ended at the sweep point, before any started there.
+    std::vector<int> ended;
+    // Endpoints are known up front and sorted once, only crossings are
+    // queued as they are found.
+    std::vector<sweep_event> endpoints;
+    std::priority_queue<sweep_event, std::vector<sweep_event>, later_event> crossings;
+    std::unordered_set<uint64_t> found;
+    std::unordered_set<uint64_t> swapped;
+    std::vector<edge_pair>* pairs;
+};
+
+sweep::sweep(const double* x, const double* y, int n, std::vector<edge_pair>& pairs)
+: x(x)
+, y(y)
+, n(n)
+, sx(0.0)
+, sy(0.0)
+, segments(n)
+, active(sweep_order(this))
+, where(n, active.end())
+, pairs(&pairs)
+{
+}
+
+static double orient(double ax, double ay, double bx, double by, double cx, double cy) {
+
+    return (bx - ax) * (cy - ay) - (cx - ax) * (by - ay);
+}
+
+// c, known to lie on the line through a and b, lies between them.
+static bool between(double ax, double ay, double bx, double by, double cx, double cy) {
+
+    return std::min(ax, bx) <= cx && cx <= std::max(ax, bx)
+        && std::min(ay, by) <= cy && cy <= std::max(ay, by);
+}
+
+static bool degenerate(const double* x, const double* y, int n, int edge) {
+
+    int j = (edge + 1) % n;
+    return x[edge] == x[j] && y[edge] == y[j];
+}
+
+// Consecutive along the outline, zero-length edges in between not counting.
+static bool neighbors(const double* x, const double* y, int n, int a, int b) {
+
+    for (int k=(a + 1) % n, steps=0; steps<n; k=(k + 1) % n, ++steps) {
+        if (k == b) return true;
+        if (!degenerate(x, y, n, k)) break;
+    }
+    for (int k=(b + 1) % n, steps=0; steps<n; k=(k + 1) % n, ++steps) {
+        if (k == a) return true;
+        if (!degenerate(x, y, n, k)) break;
+    }
+    return false;
+}
+
+static bool opposite(double a, double b) {
+
+    return (a > 0.0 && b < 0.0) || (a < 0.0 && b > 0.0);
+}
+
+// Returns 0 if edges a and b are apart, 1 if they touch or overlap and 2 if
+// they cross at a point inside both.
+static int edges_meet(const double* x, const double* y, int n, int a, int b) {
+
+    int a1 = (a + 1) % n;
+    int b1 = (b + 1) % n;
+    double d1 = orient(x[a], y[a], x[a1], y[a1], x[b], y[b]);
+    double d2 = orient(x[a], y[a], x[a1], y[a1], x[b1], y[b1]);
+    double d3 = orient(x[b], y[b], x[b1], y[b1], x[a], y[a]);
+    double d4 = orient(x[b], y[b], x[b1], y[b1], x[a1], y[a1]);
+
+    if (opposite(d1, d2) && opposite(d3, d4)) return 2;
+    if (d1 == 0.0 && between(x[a], y[a], x[a1], y[a1], x[b], y[b])) return 1;
+    if (d2 == 0.0 && between(x[a], y[a], x[a1], y[a1], x[b1], y[b1])) return 1;
+    if (d3 == 0.0 && between(x[b], y[b], x[b1], y[b1], x[a], y[a])) return 1;
+    if (d4 == 0.0 && between(x[b], y[b], x[b1], y[b1], x[a1], y[a1])) return 1;
+    return 0;
+}
+
+static bool earlier(const sweep_event& l, const sweep_event& r) {
+
+    return later_event()(r, l);
+}
+
+static uint64_t pair_key(int a, int b) {
+
+    if (a > b) std::swap(a, b);
+    return (static_cast<uint64_t>(static_cast<uint32_t>(a)) << 32) | static_cast<uint32_t>(b);
+}
+
+static double height_at(const sweep_segment& s, double sx, double sy) {
+
+    if (s.x0 == s.x1) return std::min(std::max(sy, s.y0), s.y1);
+    if (sx <= s.x0) return s.y0;
+    if (sx >= s.x1) return s.y1;
+    return s.y0 + (sx - s.x0) * (s.y1 - s.y0) / (s.x1 - s.x0);
+}
+
+static double slope(const sweep_segment& s) {
+
+    if (s.x0 == s.x1) return HUGE_VAL;
+    return (s.y1 - s.y0) / (s.x1 - s.x0);
+}
+
+// Heights within rounding error of each other.
+static bool same_height(double a, double b) {
+
+    return fabs(a - b) <= 1e-12 * (fabs(a) + fabs(b));
+}
+
+// Segment t passes through the sweep point.
+static bool through(const sweep& w, int t) {
+
+    return same_height(height_at(w.segments[t], w.sx, w.sy), w.sy);
+}
+
+// Ties are decided by the slope, that is by what comes after the point.
+bool sweep_order::operator()(const sweep_slot& l, const sweep_slot& r) const {
+
+    const sweep_segment& a = w->segments[l.segment];
+    const sweep_segment& b = w->segments[r.segment];
+    double ha = height_at(a, w->sx, w->sy);
+    double hb = height_at(b, w->sx, w->sy);
+    if (!same_height(ha, hb)) return ha < hb;
+    return slope(a) < slope(b);
+}
+
+// Tests two segments next to each other in the sweep, lower one first.
+// Pairs are reported once. A crossing is scheduled every time the pair
+// becomes adjacent until it has been swapped, since other segments crossing
+// at the same point can leave earlier events stale.
+static void test_pair(sweep& w, int lower, int upper) {
+
+    if (neighbors(w.x, w.y, w.n, lower, upper)) return;
+
+    int meet = edges_meet(w.x, w.y, w.n, lower, upper);
+    if (meet == 0) return;
+
+    uint64_t key = pair_key(lower, upper);
+    if (w.found.insert(key).second) {
+        edge_pair p = { std::min(lower, upper), std::max(lower, upper) };
+        w.pairs->push_back(p);
+    }
+    if (meet != 2 || w.swapped.count(key)) return;
+
+    const sweep_segment& a = w.segments[lower];
+    const sweep_segment& b = w.segments[upper];
+    double dx = a.x1 - a.x0;
+    double dy = a.y1 - a.y0;
+    double t = ((b.x0 - a.x0) * (b.y1 - b.y0) - (b.y0 - a.y0) * (b.x1 - b.x0))
+             / (dx * (b.y1 - b.y0) - dy * (b.x1 - b.x0));
+    // Rounding may put the point just behind the sweep, it is then handled next.
+    sweep_event e = { a.x0 + t * dx, a.y0 + t * dy, SWEEP_CROSS, lower, upper };
+    w.crossings.push(e);
+}
+
+static void test_below(sweep& w, sweep_status::iterator it) {
+
+    if (it == w.active.begin() || it == w.active.end()) return;
+    sweep_status::iterator prev = it;
+    --prev;
+    test_pair(w, prev->segment, it->segment);
+}
+
+static void test_above(sweep& w, sweep_status::iterator it) {
+
+    sweep_status::iterator next = it;
+    ++next;
+    if (next == w.active.end()) return;
+    test_pair(w, it->segment, next->segment);
+}
+
+// The segment in slot it, which starts or ends at the sweep point, against
+// every other segment through the point. They are all next to it in the
+// sweep, but only the closest two would be tested otherwise.
+static void test_through(sweep& w, sweep_status::iterator it) {
+
+    int s = it->segment;
+    for (sweep_status::iterator m=it; m!=w.active.begin(); ) {
+        --m;
+        if (!through(w, m->segment)) break;
+        test_pair(w, m->segment, s);
+    }
+    sweep_status::iterator m = it;
+    for (++m; m!=w.active.end() && through(w, m->segment); ++m) {
+        test_pair(w, s, m->segment);
+    }
+}
+
+void find_crossings(const double* x, const double* y, int n, std::vector<edge_pair>& pairs) {
+
+    pairs.clear();
+    if (n < 4) return;
+
+    sweep w(x, y, n, pairs);
+
+    for (int i=0; i<n; ++i) {
+        if (degenerate(x, y, n, i)) continue;
+
+        int j = (i + 1) % n;
+        sweep_segment& s = w.segments[i];
+        bool forward = x[i] < x[j] || (x[i] == x[j] && y[i] < y[j]);
+        s.x0 = forward ? x[i] : x[j];
+        s.y0 = forward ? y[i] : y[j];
+        s.x1 = forward ? x[j] : x[i];
+        s.y1 = forward ? y[j] : y[i];
+
+        sweep_event start = { s.x0, s.y0, SWEEP_START, i, -1 };
+        sweep_event end = { s.x1, s.y1, SWEEP_END, i, -1 };
+        w.endpoints.push_back(start);
+        w.endpoints.push_back(end);
+    }
+    std::sort(w.endpoints.begin(), w.endpoints.end(), earlier);
+
+    size_t next_endpoint = 0;
+    while (next_endpoint < w.endpoints.size() || !w.crossings.empty()) {
+        sweep_event e;
+        if (w.crossings.empty()
+            || (next_endpoint < w.endpoints.size() && earlier(w.endpoints[next_endpoint], w.crossings.top()))) {
+            e = w.endpoints[next_endpoint++];
+        } else {
+            e = w.crossings.top();
+            w.crossings.pop();
+        }
+        if (e.x != w.sx || e.y != w.sy) w.ended.clear();
+        w.sx = e.x;
+        w.sy = e.y;
+
+        if (e.type == SWEEP_START) {
+            sweep_slot slot = { e.a };
+            sweep_status::iterator it = w.active.insert(slot);
+            w.where[e.a] = it;
+            for (size_t k=0; k<w.ended.size(); ++k) {
+                test_pair(w, w.ended[k], e.a);
+            }
+            test_through(w, it);
+            test_below(w, it);
+            test_above(w, it);
+        } else if (e.type == SWEEP_END) {
+            sweep_status::iterator it = w.where[e.a];
+            test_through(w, it);
+            sweep_status::iterator next = w.active.erase(it);
+            w.where[e.a] = w.active.end();
+            w.ended.push_back(e.a);
+            test_below(w, next);
+        } else {
+            // Stale if the pair was separated again since it was scheduled,
+            // or rounding put the crossing past the end of one of them.
+            sweep_status::iterator it = w.where[e.a];
+            if (it == w.active.end()) continue;
+            sweep_status::iterator next = it;
+            ++next;
+            if (next == w.active.end() || next->segment != e.b) continue;
+            it->segment = e.b;
+            next->segment = e.a;
+            w.where[e.b] = it;
+            w.where[e.a] = next;
+            w.swapped.insert(pair_key(e.a, e.b));
+            test_below(w, it);
+            test_above(w, next);
+        }
+    }
+}
+
+crossing_checker::crossing_checker()
+: inv_cell_size_(1.0)
+, crossing_count_(0)
+, stamp_(0)
+{
+}
+
+uint64_t crossing_checker::cell_key(int32_t ix, int32_t iy) const {
+
+    return (static_cast<uint64_t>(static_cast<uint32_t>(ix)) << 32) | static_cast<uint32_t>(iy);
+}
+
+void crossing_checker::check(const double* x, const double* y, int n) {
+
+    partners_.assign(n, std::vector<int>());
+    keys_.assign(n, std::vector<uint64_t>());
+    seen_.assign(n, 0);
+    cells_.clear();
+    crossing_count_ = 0;
+
+    std::vector<edge_pair> pairs;
+    find_crossings(x, y, n, pairs);
+    for (size_t k=0; k<pairs.size(); ++k) {
+        add_pair(pairs[k].a, pairs[k].b);
+    }
+
+    // Cells about as large as an average edge.
+    double length = 0.0;
+    double min_x = HUGE_VAL, max_x = -HUGE_VAL;
+    double min_y = HUGE_VAL, max_y = -HUGE_VAL;
+    for (int i=0; i<n; ++i) {
+        int j = (i + 1) % n;
+        length += hypot(x[j] - x[i], y[j] - y[i]);
+        min_x = std::min(min_x, x[i]);
+        max_x = std::max(max_x, x[i]);
+        min_y = std::min(min_y, y[i]);
+        max_y = std::max(max_y, y[i]);
+    }
+    double cell = (n > 0) ? length / n : 0.0;
+    if (n > 0) cell = std::max(cell, std::max(max_x - min_x, max_y - min_y) / CROSSING_GRID_MAX);
+    inv_cell_size_ = (cell > 0.0) ? 1.0 / cell : 1.0;
+
+    for (int i=0; i<n; ++i) {
+        grid_edge(x, y, n, i);
+    }
+}
+
+void crossing_checker::move_vertex(const double* x, const double* y, int n, int i) {
+
+    if (n != edge_count()) {
+        check(x, y, n);
+        return;
+    }
+
+    // An edge shrinking to or growing from a point changes which edges
+    // around it are neighbors, not worth tracking.
+    int edges[2] = { (i + n - 1) % n, i };
+    for (int k=0; k<2; ++k) {
+        if (keys_[edges[k]].empty() || degenerate(x, y, n, edges[k])) {
+            check(x, y, n);
+            return;
+        }
+    }
+
+    for (int k=0; k<2; ++k) {
+        drop_pairs(edges[k]);
+        ungrid_edge(edges[k]);
+        grid_edge(x, y, n, edges[k]);
+    }
+
+    for (int k=0; k<2; ++k) {
+        int e = edges[k];
+        stamp_++;
+        seen_[e] = stamp_;
+        for (size_t c=0; c<keys_[e].size(); ++c) {
+            const std::vector<int>& cell = cells_[keys_[e][c]];
+            for (size_t m=0; m<cell.size(); ++m) {
+                int other = cell[m];
+                if (seen_[other] == stamp_) continue;
+                seen_[other] = stamp_;
+                if (neighbors(x, y, n, e, other)) continue;
+                if (edges_meet(x, y, n, e, other) != 0) add_pair(e, other);
+            }
+        }
+    }
+}
+
+// Every cell the edge passes through, a column at a time, slightly padded
+// so edges meeting on a cell border share a cell.
+void crossing_checker::grid_edge(const double* x, const double* y, int n, int edge) {
+
+    if (degenerate(x, y, n, edge)) return;
+
+    const double pad = 1e-6;
+    int j = (edge + 1) % n;
+    double x0 = x[edge] * inv_cell_size_;
+    double y0 = y[edge] * inv_cell_size_;
+    double x1 = x[j] * inv_cell_size_;
+    double y1 = y[j] * inv_cell_size_;
+    if (x0 > x1) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+    }
+
+    int32_t first = static_cast<int32_t>(floor(x0 - pad));
+    int32_t last = static_cast<int32_t>(floor(x1 + pad));
+    for (int32_t ix=first; ix<=last; ++ix) {
+        double ya = y0;
+        double yb = y1;
+        if (x1 > x0) {
+            double l = std::max(x0, static_cast<double>(ix));
+            double r = std::min(x1, static_cast<double>(ix) + 1.0);
+            ya = y0 + (l - x0) * (y1 - y0) / (x1 - x0);
+            yb = y0 + (r - x0) * (y1 - y0) / (x1 - x0);
+        }
+        int32_t low = static_cast<int32_t>(floor(std::min(ya, yb) - pad));
+        int32_t high = static_cast<int32_t>(floor(std::max(ya, yb) + pad));
+        for (int32_t iy=low; iy<=high; ++iy) {
+            uint64_t key = cell_key(ix, iy);
+            cells_[key].push_back(edge);
+            keys_[edge].push_back(key);
+        }
+    }
+}
+
+void crossing_checker::ungrid_edge(int edge) {
+
+    std::vector<uint64_t>& keys = keys_[edge];
+    for (size_t k=0; k<keys.size(); ++k) {
+        std::unordered_map<uint64_t, std::vector<int> >::iterator it = cells_.find(keys[k]);
+        if (it == cells_.end()) continue;
+
+        std::vector<int>& cell = it->second;
+        for (size_t m=0; m<cell.size(); ++m) {
+            if (cell[m] == edge) {
+                cell[m] = cell.back();
+                cell.pop_back();
+                break;
+            }
+        }
+        if (cell.empty()) {
+            cells_.erase(it);
+        }
+    }
+    keys.clear();
+}
+
+void crossing_checker::add_pair(int a, int b) {
+
+    if (partners_[a].empty()) crossing_count_++;
+    if (partners_[b].empty()) crossing_count_++;
+    partners_[a].push_back(b);
+    partners_[b].push_back(a);
+}
+
+void crossing_checker::drop_pairs(int edge) {
+
+    std::vector<int>& mine = partners_[edge];
+    if (mine.empty()) return;
+
+    for (size_t k=0; k<mine.size(); ++k) {
+        std::vector<int>& theirs = partners_[mine[k]];
+        for (size_t m=0; m<theirs.size(); ++m) {
+            if (theirs[m] == edge) {
+                theirs[m] = theirs.back();
+                theirs.pop_back();
+                break;
+            }
+        }
+        if (theirs.empty()) crossing_count_--;
+    }
+    mine.clear();
+    crossing_count_--;
+}
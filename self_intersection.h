@@ -0,0 +1,52 @@
+#ifndef SELF_INTERSECTION_H_
+#define SELF_INTERSECTION_H_
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+// Edge i of a closed outline runs from vertex i to vertex i+1. Two edges
+// cross when they share any point, except neighbors sharing their common
+// vertex. Zero-length edges are ignored.
+struct edge_pair {
+    int a;
+    int b;
+};
+
+// Bentley-Ottmann sweep, O((n + k) log n) for k pairs. Fills pairs with
+// every crossing pair, a < b, in no particular order.
+void find_crossings(const double* x, const double* y, int n, std::vector<edge_pair>& pairs);
+
+// Crossing edges of one outline, kept up to date while a vertex is dragged.
+// check() runs the full sweep; move_vertex() re-tests only the two edges at
+// the moved vertex, against edges sharing cells of a uniform grid with them.
+struct crossing_checker {
+    crossing_checker();
+
+    void check(const double* x, const double* y, int n);
+    // Vertex i moved since the last call, nothing else changed.
+    void move_vertex(const double* x, const double* y, int n, int i);
+
+    bool simple() const { return crossing_count_ == 0; }
+    // Number of edges crossing at least one other edge.
+    int crossing_count() const { return crossing_count_; }
+    bool crossing(int edge) const { return !partners_[edge].empty(); }
+    int edge_count() const { return static_cast<int>(partners_.size()); }
+
+private:
+    uint64_t cell_key(int32_t ix, int32_t iy) const;
+    void grid_edge(const double* x, const double* y, int n, int edge);
+    void ungrid_edge(int edge);
+    void add_pair(int a, int b);
+    void drop_pairs(int edge);
+
+    double inv_cell_size_;
+    int crossing_count_;
+    int stamp_;
+    std::vector<std::vector<int> > partners_;
+    std::vector<std::vector<uint64_t> > keys_;
+    std::vector<int> seen_;
+    std::unordered_map<uint64_t, std::vector<int> > cells_;
+};
+
+#endif // SELF_INTERSECTION_H_
@@ -0,0 +1,411 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "mass_properties.h"
+#include "shape_export.h"
+#include "triangulate.h"
+
+#define EXPORT_BUFFER_SIZE (1 << 16)
+#define EXPORT_POINTS_PER_LINE 4
+#define EXPORT_TRIANGLES_PER_LINE 8
+
+// Output gathered in memory and handed to stdio a buffer at a time.
+struct export_buffer {
+    explicit export_buffer(FILE* out) : out(out), size(0), ok(true), data(EXPORT_BUFFER_SIZE) {}
+
+    void put(const char* s, size_t n) {
+        if (size + n > data.size()) flush();
+        if (n > data.size()) {
+            ok = (fwrite(s, 1, n, out) == n) && ok;
+            return;
+        }
+        memcpy(&data[size], s, n);
+        size += n;
+    }
+    void put(const char* s) { put(s, strlen(s)); }
+    void put(const std::string& s) { put(s.data(), s.size()); }
+    void put_char(char c) {
+        if (size == data.size()) flush();
+        data[size++] = c;
+    }
+    void put_int(long long v);
+    // q / 10^digits, trailing zeros dropped down to one decimal.
+    void put_fixed(long long q, int digits);
+    void put_u32(uint32_t v) {
+        char b[4] = { static_cast<char>(v), static_cast<char>(v >> 8),
+                      static_cast<char>(v >> 16), static_cast<char>(v >> 24) };
+        put(b, 4);
+    }
+    void put_f32(float f) {
+        uint32_t v;
+        memcpy(&v, &f, sizeof(v));
+        put_u32(v);
+    }
+    void flush() {
+        if (size > 0 && fwrite(data.data(), 1, size, out) != size) ok = false;
+        size = 0;
+    }
+
+    FILE* out;
+    size_t size;
+    bool ok;
+    std::vector<char> data;
+};
+
+void export_buffer::put_int(long long v) {
+
+    char text[24];
+    char* end = text + sizeof(text);
+    char* p = end;
+    unsigned long long u = v < 0 ? 0ull - static_cast<unsigned long long>(v) : v;
+    do {
+        *--p = static_cast<char>('0' + u % 10);
+        u /= 10;
+    } while (u > 0);
+    if (v < 0) *--p = '-';
+    put(p, end - p);
+}
+
+void export_buffer::put_fixed(long long q, int digits) {
+
+    char text[32];
+    char* end = text + sizeof(text);
+    char* p = end;
+    unsigned long long u = q < 0 ? 0ull - static_cast<unsigned long long>(q) : q;
+
+    bool significant = false;
+    for (int i=0; i<digits; ++i) {
+        char digit = static_cast<char>('0' + u % 10);
+        u /= 10;
+        if (digit == '0' && !significant && i + 1 < digits) continue;
+        significant = true;
+        *--p = digit;
+    }
+    if (digits == 0) *--p = '0';
+    *--p = '.';
+    do {
+        *--p = static_cast<char>('0' + u % 10);
+        u /= 10;
+    } while (u > 0);
+    if (q < 0) *--p = '-';
+    put(p, end - p);
+}
+
+// Everything but the points, rounded like them. Triangles are
+// index triples into the shape's own outline.
+struct export_shape {
+    int first;
+    int count;
+    int first_index;
+    int index_count;
+    long long area;
+    long long centroid_x, centroid_y;
+    long long min_x, min_y;
+    long long max_x, max_y;
+};
+
+static bool quantize(double v, double scale, long long* q) {
+
+    double s = v * scale;
+    if (!(fabs(s) < 9e18)) return false;
+    *q = llround(s);
+    return true;
+}
+
+// The outline as written, pending transform applied and rounded.
+static bool quantize_shape(const shape_store& store, int shape, double scale,
+                           std::vector<long long>& qx, std::vector<long long>& qy) {
+
+    const affine& t = store.pending_transform(shape);
+    const double* x = store.xs(shape);
+    const double* y = store.ys(shape);
+    int n = store.size(shape);
+    qx.resize(n);
+    qy.resize(n);
+    for (int i=0; i<n; ++i) {
+        grid_point p = { x[i], y[i] };
+        p = t.apply(p);
+        if (!quantize(p.x, scale, &qx[i]) || !quantize(p.y, scale, &qy[i])) return false;
+    }
+    return true;
+}
+
+static bool summarize(const shape_store& store, double scale, std::vector<export_shape>& shapes,
+                      std::vector<int>& indices) {
+
+    std::vector<long long> qx, qy;
+    std::vector<double> x, y;
+    std::vector<int> triangles;
+    int first = 0;
+    indices.clear();
+    shapes.resize(store.shape_count());
+    for (int k=0; k<store.shape_count(); ++k) {
+        if (!quantize_shape(store, k, scale, qx, qy)) return false;
+        int n = static_cast<int>(qx.size());
+        x.resize(n);
+        y.resize(n);
+        for (int i=0; i<n; ++i) {
+            x[i] = qx[i] / scale;
+            y[i] = qy[i] / scale;
+        }
+
+        export_shape& s = shapes[k];
+        s.first = first;
+        s.count = n;
+        first += n;
+        // From the rounded outline, which may have lost vertices to rounding.
+        triangulate_monotone(x.data(), y.data(), n, triangles);
+        s.first_index = static_cast<int>(indices.size());
+        s.index_count = static_cast<int>(triangles.size());
+        indices.insert(indices.end(), triangles.begin(), triangles.end());
+        if (n == 0) {
+            s.area = s.centroid_x = s.centroid_y = 0;
+            s.min_x = s.min_y = s.max_x = s.max_y = 0;
+            continue;
+        }
+        mass_properties mass;
+        compute_mass_properties(x.data(), y.data(), n, mass);
+        s.min_x = *std::min_element(qx.begin(), qx.end());
+        s.min_y = *std::min_element(qy.begin(), qy.end());
+        s.max_x = *std::max_element(qx.begin(), qx.end());
+        s.max_y = *std::max_element(qy.begin(), qy.end());
+        if (!quantize(mass.area, scale, &s.area) ||
+            !quantize(mass.centroid.x, scale, &s.centroid_x) ||
+            !quantize(mass.centroid.y, scale, &s.centroid_y)) return false;
+    }
+    return true;
+}
+
+// Letters, digits and underscores, not starting with a digit.
+static std::string identifier(const char* name) {
+
+    std::string id;
+    for (const char* c=name; *c; ++c) {
+        id += isalnum(static_cast<unsigned char>(*c)) ? *c : '_';
+    }
+    if (id.empty() || isdigit(static_cast<unsigned char>(id[0]))) id.insert(0, "shapes_");
+    return id;
+}
+
+static void put_pair(export_buffer& out, const char* open, long long x, long long y, const char* close, int digits) {
+
+    out.put(open);
+    out.put_fixed(x, digits);
+    out.put(", ");
+    out.put_fixed(y, digits);
+    out.put(close);
+}
+
+// NAME_points holds the outlines back to back, NAME_indices their
+// triangles, and NAME_shapes has per shape where both start, their counts
+// and its properties:
+//
+//   for (const polyd_shape& s : NAME_shapes) {
+//       const polyd_point* outline = NAME_points + s.first;
+//       const int* triangles = NAME_indices + s.first_index;
+//       ...
+//   }
+//
+// Arrays are never empty, C++ has no zero length arrays; a library
+// without vertices gets one zero point, without shapes one empty shape.
+static void write_header(export_buffer& out, const shape_store& store, const std::vector<export_shape>& shapes,
+                         const std::vector<int>& indices, double scale, int digits, const std::string& id) {
+
+    std::string guard = "POLYD_" + id + "_H_";
+    std::transform(guard.begin(), guard.end(), guard.begin(), ::toupper);
+
+    out.put("// Generated by polyd --batch, do not edit.\n");
+    out.put("#ifndef " + guard + "\n#define " + guard + "\n\n");
+    out.put(
+        "#ifndef POLYD_SHAPE_TYPES_\n"
+        "#define POLYD_SHAPE_TYPES_\n"
+        "struct polyd_point {\n"
+        "    double x;\n"
+        "    double y;\n"
+        "};\n"
+        "\n"
+        "// Outline points[first] to points[first + count - 1], counter-clockwise\n"
+        "// when area is positive. Its triangles are indices[first_index] to\n"
+        "// indices[first_index + index_count - 1], counter-clockwise triples\n"
+        "// counted from points[first].\n"
+        "struct polyd_shape {\n"
+        "    int first;\n"
+        "    int count;\n"
+        "    int first_index;\n"
+        "    int index_count;\n"
+        "    double area;\n"
+        "    polyd_point centroid;\n"
+        "    polyd_point min;\n"
+        "    polyd_point max;\n"
+        "};\n"
+        "#endif // POLYD_SHAPE_TYPES_\n\n");
+
+    int vertex_count = shapes.empty() ? 0 : shapes.back().first + shapes.back().count;
+    out.put("constexpr int " + id + "_shape_count = ");
+    out.put_int(shapes.size());
+    out.put(";\nconstexpr int " + id + "_vertex_count = ");
+    out.put_int(vertex_count);
+    out.put(";\nconstexpr int " + id + "_index_count = ");
+    out.put_int(indices.size());
+    out.put(";\n\n");
+
+    out.put("constexpr polyd_shape " + id + "_shapes[] = {\n");
+    for (size_t k=0; k<shapes.size(); ++k) {
+        const export_shape& s = shapes[k];
+        out.put("    {");
+        out.put_int(s.first);
+        out.put(", ");
+        out.put_int(s.count);
+        out.put(", ");
+        out.put_int(s.first_index);
+        out.put(", ");
+        out.put_int(s.index_count);
+        out.put(", ");
+        out.put_fixed(s.area, digits);
+        put_pair(out, ", {", s.centroid_x, s.centroid_y, "}", digits);
+        put_pair(out, ", {", s.min_x, s.min_y, "}", digits);
+        put_pair(out, ", {", s.max_x, s.max_y, "}},\n", digits);
+    }
+    if (shapes.empty()) out.put("    {0, 0, 0, 0, 0.0, {0.0, 0.0}, {0.0, 0.0}, {0.0, 0.0}},\n");
+    out.put("};\n\n");
+
+    out.put("constexpr polyd_point " + id + "_points[] = {\n");
+    std::vector<long long> qx, qy;
+    for (size_t k=0; k<shapes.size(); ++k) {
+        if (shapes[k].count == 0) continue;
+        quantize_shape(store, static_cast<int>(k), scale, qx, qy);
+        out.put("    // shape ");
+        out.put_int(k);
+        for (size_t i=0; i<qx.size(); ++i) {
+            put_pair(out, i % EXPORT_POINTS_PER_LINE == 0 ? "\n    {" : " {", qx[i], qy[i], "},", digits);
+        }
+        out.put_char('\n');
+    }
+    if (vertex_count == 0) out.put("    {0.0, 0.0},\n");
+    out.put("};\n\n");
+
+    out.put("constexpr int " + id + "_indices[] = {\n");
+    for (size_t k=0; k<shapes.size(); ++k) {
+        const export_shape& s = shapes[k];
+        if (s.index_count == 0) continue;
+        out.put("    // shape ");
+        out.put_int(k);
+        for (int i=0; i<s.index_count; ++i) {
+            out.put(i % (3 * EXPORT_TRIANGLES_PER_LINE) == 0 ? "\n    " : i % 3 == 0 ? "  " : " ");
+            out.put_int(indices[s.first_index + i]);
+            out.put_char(',');
+        }
+        out.put_char('\n');
+    }
+    if (indices.empty()) out.put("    0,\n");
+    out.put("};\n\n#endif // " + guard + "\n");
+}
+
+static void write_json(export_buffer& out, const shape_store& store, const std::vector<export_shape>& shapes,
+                       const std::vector<int>& indices, double scale, int digits) {
+
+    out.put("{\"shapes\": [");
+    std::vector<long long> qx, qy;
+    for (size_t k=0; k<shapes.size(); ++k) {
+        const export_shape& s = shapes[k];
+        out.put(k == 0 ? "\n{\"area\": " : ",\n{\"area\": ");
+        out.put_fixed(s.area, digits);
+        put_pair(out, ", \"centroid\": [", s.centroid_x, s.centroid_y, "]", digits);
+        put_pair(out, ", \"min\": [", s.min_x, s.min_y, "]", digits);
+        put_pair(out, ", \"max\": [", s.max_x, s.max_y, "]", digits);
+        out.put(", \"points\": [");
+        quantize_shape(store, static_cast<int>(k), scale, qx, qy);
+        for (size_t i=0; i<qx.size(); ++i) {
+            put_pair(out, i == 0 ? "[" : ", [", qx[i], qy[i], "]", digits);
+        }
+        out.put("], \"triangles\": [");
+        for (int i=0; i<s.index_count; ++i) {
+            out.put(i == 0 ? "[" : i % 3 == 0 ? ", [" : ", ");
+            out.put_int(indices[s.first_index + i]);
+            if (i % 3 == 2) out.put_char(']');
+        }
+        out.put("]}");
+    }
+    out.put("\n]}\n");
+}
+
+static void write_binary(export_buffer& out, const shape_store& store, const std::vector<export_shape>& shapes,
+                         const std::vector<int>& indices, double scale) {
+
+    int vertex_count = shapes.empty() ? 0 : shapes.back().first + shapes.back().count;
+    out.put(EXPORT_BINARY_MAGIC, sizeof(EXPORT_BINARY_MAGIC));
+    out.put_u32(EXPORT_BINARY_VERSION);
+    out.put_u32(static_cast<uint32_t>(shapes.size()));
+    out.put_u32(static_cast<uint32_t>(vertex_count));
+    out.put_u32(static_cast<uint32_t>(indices.size()));
+
+    for (size_t k=0; k<shapes.size(); ++k) {
+        const export_shape& s = shapes[k];
+        out.put_u32(s.first);
+        out.put_u32(s.count);
+        out.put_u32(s.first_index);
+        out.put_u32(s.index_count);
+        out.put_f32(static_cast<float>(s.area / scale));
+        out.put_f32(static_cast<float>(s.centroid_x / scale));
+        out.put_f32(static_cast<float>(s.centroid_y / scale));
+        out.put_f32(static_cast<float>(s.min_x / scale));
+        out.put_f32(static_cast<float>(s.min_y / scale));
+        out.put_f32(static_cast<float>(s.max_x / scale));
+        out.put_f32(static_cast<float>(s.max_y / scale));
+    }
+
+    std::vector<long long> qx, qy;
+    for (size_t k=0; k<shapes.size(); ++k) {
+        quantize_shape(store, static_cast<int>(k), scale, qx, qy);
+        for (size_t i=0; i<qx.size(); ++i) {
+            out.put_f32(static_cast<float>(qx[i] / scale));
+            out.put_f32(static_cast<float>(qy[i] / scale));
+        }
+    }
+    for (size_t i=0; i<indices.size(); ++i) {
+        out.put_u32(static_cast<uint32_t>(indices[i]));
+    }
+}
+
+bool export_shapes(const char* path, const shape_store& store, export_format format,
+                   const char* name, int digits) {
+
+    digits = std::min(std::max(digits, 0), EXPORT_MAX_DIGITS);
+    double scale = 1.0;
+    for (int i=0; i<digits; ++i) {
+        scale *= 10.0;
+    }
+
+    // Rounding is checked here once; the writers quantize again the same
+    // way and cannot fail.
+    std::vector<export_shape> shapes;
+    std::vector<int> indices;
+    if (!summarize(store, scale, shapes, indices)) return false;
+
+    std::string temp_path = std::string(path) + ".tmp";
+    FILE *fSave = fopen(temp_path.c_str(), format == EXPORT_BINARY ? "wb" : "w");
+    if (fSave == 0) return false;
+
+    export_buffer out(fSave);
+    switch (format) {
+    case EXPORT_HEADER: write_header(out, store, shapes, indices, scale, digits, identifier(name)); break;
+    case EXPORT_JSON: write_json(out, store, shapes, indices, scale, digits); break;
+    case EXPORT_BINARY: write_binary(out, store, shapes, indices, scale); break;
+    }
+    out.flush();
+
+    bool ok = out.ok && (ferror(fSave) == 0);
+    ok = (fclose(fSave) == 0) && ok;
+    if (!ok || rename(temp_path.c_str(), path) != 0) {
+        remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
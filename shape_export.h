@@ -0,0 +1,43 @@
+#ifndef SHAPE_EXPORT_H_
+#define SHAPE_EXPORT_H_
+
+#include "shape_store.h"
+
+// Whole-library exports for game code. Every shape, pending transform
+// included, goes out with its area, centroid, bounds and triangles
+// precomputed, so the game neither parses nor computes anything at
+// startup. Triangles are counter-clockwise index triples counted from the
+// shape's first point, ready for an index buffer.
+//
+// Coordinates are rounded to digits decimals first, and the properties
+// are computed from the rounded outline, so they match what is written.
+// Numbers are formatted from integers without stdio or the locale, and
+// shapes keep their store order: the same library always gives the same
+// bytes.
+enum export_format {
+    // C++11 header of constexpr arrays, see write_header() for the layout.
+    EXPORT_HEADER,
+    EXPORT_JSON,
+    // Little-endian, laid out as
+    //
+    //   header | shape table, one entry per shape | points | indices
+    //
+    // header: "POLYBIN\0", u32 version, u32 shape count, u32 vertex count,
+    // u32 index count. Entry: u32 first point, u32 count, u32 first index,
+    // u32 index count, then f32 area, centroid x, y, min x, y, max x, y.
+    // Points: f32 x, y pairs. Indices: u32.
+    EXPORT_BINARY
+};
+
+#define EXPORT_DIGITS 6
+#define EXPORT_MAX_DIGITS 9
+#define EXPORT_BINARY_MAGIC "POLYBIN"
+#define EXPORT_BINARY_VERSION 2
+
+// Writes a temporary file and renames it over path. name prefixes the
+// header's identifiers. False if the file cannot be written or a value is
+// too large for digits decimals.
+bool export_shapes(const char* path, const shape_store& store, export_format format,
+                   const char* name, int digits);
+
+#endif // SHAPE_EXPORT_H_
@@ -0,0 +1,196 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shape_library.h"
+#include "trace.h"
+
+static_assert(sizeof(library_header) == 64, "library_header layout");
+static_assert(sizeof(library_entry) == 16, "library_entry layout");
+
+struct crc32_table {
+    crc32_table() {
+        for (uint32_t i=0; i<256; ++i) {
+            uint32_t c = i;
+            for (int k=0; k<8; ++k) {
+                c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+            }
+            value[i] = c;
+        }
+    }
+    uint32_t value[256];
+};
+
+uint32_t library_crc32(uint32_t crc, const void* data, size_t size) {
+
+    static const crc32_table table;
+
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i=0; i<size; ++i) {
+        crc = table.value[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static uint32_t header_crc(const library_header& header) {
+
+    library_header h = header;
+    h.header_crc = 0;
+    return library_crc32(0, &h, sizeof(h));
+}
+
+shape_library::shape_library()
+: base_(0)
+, size_(0)
+, header_(0)
+, index_(0)
+{
+}
+
+shape_library::~shape_library() {
+
+    close();
+}
+
+bool shape_library::open(const char* path) {
+
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(library_header)) {
+        ::close(fd);
+        return false;
+    }
+
+    void* p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+
+    base_ = static_cast<const uint8_t*>(p);
+    size_ = st.st_size;
+    header_ = reinterpret_cast<const library_header*>(base_);
+
+    const library_header& h = *header_;
+    bool valid = memcmp(h.magic, LIBRARY_MAGIC, sizeof(LIBRARY_MAGIC)) == 0
+        && h.version <= LIBRARY_VERSION
+        && h.header_crc == header_crc(h)
+        && h.shape_count <= size_ / sizeof(library_entry)
+        && h.vertex_count <= size_ / sizeof(double)
+        && h.index_offset + static_cast<uint64_t>(h.shape_count) * sizeof(library_entry) <= size_
+        && h.x_offset + h.vertex_count * sizeof(double) <= size_
+        && h.y_offset + h.vertex_count * sizeof(double) <= size_
+        && h.x_offset % sizeof(double) == 0
+        && h.y_offset % sizeof(double) == 0;
+    if (valid) {
+        index_ = reinterpret_cast<const library_entry*>(base_ + h.index_offset);
+        valid = library_crc32(0, index_, h.shape_count * sizeof(library_entry)) == h.index_crc;
+    }
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    checked_.assign(h.shape_count, 0);
+    return true;
+}
+
+void shape_library::close() {
+
+    if (base_ != 0) {
+        munmap(const_cast<uint8_t*>(base_), size_);
+    }
+    base_ = 0;
+    size_ = 0;
+    header_ = 0;
+    index_ = 0;
+    checked_.clear();
+}
+
+bool shape_library::shape(int k, const double** x, const double** y, int* n) {
+
+    const library_entry& e = index_[k];
+    if (e.first + e.count > header_->vertex_count) return false;
+
+    const double* px = reinterpret_cast<const double*>(base_ + header_->x_offset) + e.first;
+    const double* py = reinterpret_cast<const double*>(base_ + header_->y_offset) + e.first;
+
+    if (checked_[k] == 0) {
+        uint32_t crc = library_crc32(0, px, e.count * sizeof(double));
+        crc = library_crc32(crc, py, e.count * sizeof(double));
+        checked_[k] = (crc == e.crc) ? 1 : 2;
+    }
+    if (checked_[k] != 1) return false;
+
+    *x = px;
+    *y = py;
+    *n = static_cast<int>(e.count);
+    return true;
+}
+
+bool library_write(const char* path, shape_store& store) {
+
+    TRACE_SCOPE("library_write");
+
+    int count = store.shape_count();
+    for (int k=0; k<count; ++k) {
+        store.apply_transform(k);
+    }
+
+    std::vector<library_entry> index(count);
+    uint64_t vertex_count = 0;
+    for (int k=0; k<count; ++k) {
+        int n = store.size(k);
+        index[k].first = vertex_count;
+        index[k].count = n;
+        index[k].crc = library_crc32(0, store.xs(k), n * sizeof(double));
+        index[k].crc = library_crc32(index[k].crc, store.ys(k), n * sizeof(double));
+        vertex_count += n;
+    }
+
+    library_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, LIBRARY_MAGIC, sizeof(LIBRARY_MAGIC));
+    h.version = LIBRARY_VERSION;
+    h.shape_count = count;
+    h.index_offset = sizeof(library_header);
+    h.x_offset = h.index_offset + count * sizeof(library_entry);
+    h.y_offset = h.x_offset + vertex_count * sizeof(double);
+    h.vertex_count = vertex_count;
+    h.index_crc = library_crc32(0, index.data(), count * sizeof(library_entry));
+    h.header_crc = header_crc(h);
+
+    char temp_path[1024];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE *fSave = fopen(temp_path, "wb");
+    if (fSave == 0) return false;
+
+    bool ok = fwrite(&h, sizeof(h), 1, fSave) == 1;
+    if (ok && count > 0) {
+        ok = fwrite(index.data(), sizeof(library_entry), count, fSave) == static_cast<size_t>(count);
+    }
+    for (int k=0; ok && k<count; ++k) {
+        size_t n = store.size(k);
+        ok = fwrite(store.xs(k), sizeof(double), n, fSave) == n;
+    }
+    for (int k=0; ok && k<count; ++k) {
+        size_t n = store.size(k);
+        ok = fwrite(store.ys(k), sizeof(double), n, fSave) == n;
+    }
+    // The data has to be on disk before the rename makes it the library,
+    // or a crash could leave a renamed but empty file behind.
+    ok = ok && fflush(fSave) == 0 && fsync(fileno(fSave)) == 0;
+    ok = (fclose(fSave) == 0) && ok;
+
+    if (!ok || rename(temp_path, path) != 0) {
+        remove(temp_path);
+        return false;
+    }
+    return true;
+}
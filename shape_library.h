@@ -0,0 +1,78 @@
+#ifndef SHAPE_LIBRARY_H_
+#define SHAPE_LIBRARY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "shape_store.h"
+
+// Shape library file, laid out as
+//
+//   header | index, one entry per shape | x section | y section
+//
+// The x and y sections hold the coordinates of all shapes back to back, in
+// the same structure-of-arrays form as shape_store, so a shape is a pair of
+// plain double arrays inside the file. Header and index carry CRC-32s, and
+// each index entry carries the CRC-32 of its shape's coordinates.
+//
+// Records are in host byte order, so files move between machines of the same
+// endianness only. A file from the other kind fails the header checks: its
+// version reads as a huge number and its header CRC does not match.
+#define LIBRARY_MAGIC "POLYLIB"
+#define LIBRARY_VERSION 1
+
+struct library_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t shape_count;
+    uint64_t index_offset;
+    uint64_t x_offset;
+    uint64_t y_offset;
+    uint64_t vertex_count;
+    uint32_t index_crc;
+    uint32_t header_crc;    // over the header with this field zeroed
+    uint32_t reserved[2];
+};
+
+struct library_entry {
+    uint64_t first;         // first vertex in the x/y sections
+    uint32_t count;
+    uint32_t crc;           // over count x values, then count y values
+};
+
+// Read-only view of a library file through mmap. open() checks the header
+// and the index; shape() checks a shape's CRC the first time it is asked
+// for and points into the mapping.
+struct shape_library {
+    shape_library();
+    ~shape_library();
+
+    bool open(const char* path);
+    void close();
+    bool is_open() const { return base_ != 0; }
+
+    int shape_count() const { return static_cast<int>(header_->shape_count); }
+    // Points x/y into the mapping. False if the shape fails its checksum.
+    bool shape(int k, const double** x, const double** y, int* n);
+
+    shape_library(const shape_library&) = delete;
+    shape_library& operator=(const shape_library&) = delete;
+
+private:
+    const uint8_t* base_;
+    size_t size_;
+    const library_header* header_;
+    const library_entry* index_;
+    std::vector<uint8_t> checked_;  // 0 unchecked, 1 good, 2 bad
+};
+
+uint32_t library_crc32(uint32_t crc, const void* data, size_t size);
+
+// Writes the committed coordinates of every shape (pending transforms are
+// applied first) to a temporary file, syncs it and renames it over path.
+// The library on disk is always either the old or the new one, and readers
+// that still map the old file are not disturbed.
+bool library_write(const char* path, shape_store& store);
+
+#endif // SHAPE_LIBRARY_H_
@@ -0,0 +1,329 @@
+#include <math.h>
+#include <string.h>
+
+#include "shape_store.h"
+#include "transform_kernels.h"
+
+static const int kResumInterval = 1024;
+
+int shape_store::add_shape() {
+
+    shape_range r;
+    r.offset = x.size();
+    r.length = 0;
+    r.capacity = 0;
+    r.version = 0;
+    ranges.push_back(r);
+
+    shape_moments m = { 0.0, 0.0, 0.0, 0, false };
+    moments_.push_back(m);
+    pending_.push_back(affine_identity());
+
+    return shape_count() - 1;
+}
+
+void shape_store::reserve(int shape, int capacity) {
+
+    shape_range& r = ranges[shape];
+    size_t needed = static_cast<size_t>(capacity);
+    if (needed <= r.capacity) return;
+
+    if (dead_ > x.size() / 2) {
+        compact();
+    }
+
+    if (r.offset + r.capacity == x.size()) {
+        // Last range in the arrays, grow in place.
+        x.resize(r.offset + needed);
+        y.resize(r.offset + needed);
+        r.capacity = needed;
+        return;
+    }
+
+    // Move the shape behind everything else, leaving a hole.
+    size_t new_capacity = r.capacity * 2;
+    if (new_capacity < needed) new_capacity = needed;
+    if (new_capacity < 4) new_capacity = 4;
+
+    size_t new_offset = x.size();
+    x.resize(new_offset + new_capacity);
+    y.resize(new_offset + new_capacity);
+    if (r.length > 0) {
+        memcpy(&x[new_offset], &x[r.offset], r.length * sizeof(double));
+        memcpy(&y[new_offset], &y[r.offset], r.length * sizeof(double));
+    }
+
+    dead_ += r.capacity;
+    r.offset = new_offset;
+    r.capacity = new_capacity;
+    r.version++;
+    layout_version_++;
+}
+
+void shape_store::set_point(int shape, int i, const grid_point& p) {
+
+    flush_transform(shape);
+
+    size_t k = ranges[shape].offset + i;
+    int n = size(shape);
+    shape_moments& m = moments_[shape];
+    if (!m.stale) {
+        size_t prev = ranges[shape].offset + (i + n - 1) % n;
+        size_t next = ranges[shape].offset + (i + 1) % n;
+        add_edge(m, x[prev], y[prev], x[k], y[k], -1.0);
+        add_edge(m, x[k], y[k], x[next], y[next], -1.0);
+        add_edge(m, x[prev], y[prev], p.x, p.y, 1.0);
+        add_edge(m, p.x, p.y, x[next], y[next], 1.0);
+        count_update(m);
+    }
+
+    x[k] = p.x;
+    y[k] = p.y;
+    ranges[shape].version++;
+}
+
+void shape_store::append_point(int shape, const grid_point& p) {
+
+    insert_point(shape, size(shape), p);
+}
+
+void shape_store::insert_point(int shape, int i, const grid_point& p) {
+
+    int n = size(shape);
+    if (n + 1 > static_cast<int>(ranges[shape].capacity)) {
+        reserve(shape, n < 4 ? 4 : 2 * n);
+    }
+
+    double* px = xs(shape);
+    double* py = ys(shape);
+
+    shape_moments& m = moments_[shape];
+    if (!m.stale && n > 0) {
+        // The new vertex splits the edge prev -> next.
+        int prev = (i + n - 1) % n;
+        int next = i % n;
+        add_edge(m, px[prev], py[prev], px[next], py[next], -1.0);
+        add_edge(m, px[prev], py[prev], p.x, p.y, 1.0);
+        add_edge(m, p.x, p.y, px[next], py[next], 1.0);
+        count_update(m);
+    }
+
+    if (i < n) {
+        memmove(px + i + 1, px + i, (n - i) * sizeof(double));
+        memmove(py + i + 1, py + i, (n - i) * sizeof(double));
+    }
+    px[i] = p.x;
+    py[i] = p.y;
+    ranges[shape].length++;
+    ranges[shape].version++;
+}
+
+void shape_store::erase_point(int shape, int i) {
+
+    int n = size(shape);
+    double* px = xs(shape);
+    double* py = ys(shape);
+
+    shape_moments& m = moments_[shape];
+    if (!m.stale) {
+        int prev = (i + n - 1) % n;
+        int next = (i + 1) % n;
+        add_edge(m, px[prev], py[prev], px[i], py[i], -1.0);
+        add_edge(m, px[i], py[i], px[next], py[next], -1.0);
+        add_edge(m, px[prev], py[prev], px[next], py[next], 1.0);
+        count_update(m);
+    }
+
+    memmove(px + i, px + i + 1, (n - i - 1) * sizeof(double));
+    memmove(py + i, py + i + 1, (n - i - 1) * sizeof(double));
+    ranges[shape].length--;
+    ranges[shape].version++;
+}
+
+void shape_store::clear_shape(int shape) {
+
+    ranges[shape].length = 0;
+    ranges[shape].version++;
+
+    shape_moments m = { 0.0, 0.0, 0.0, 0, false };
+    moments_[shape] = m;
+    pending_[shape] = affine_identity();
+}
+
+void shape_store::assign(int shape, const double* sx, const double* sy, int n) {
+
+    pending_[shape] = affine_identity();
+    reserve(shape, n);
+    if (n > 0) {
+        memcpy(xs(shape), sx, n * sizeof(double));
+        memcpy(ys(shape), sy, n * sizeof(double));
+    }
+    ranges[shape].length = n;
+    ranges[shape].version++;
+    moments_[shape].stale = true;
+}
+
+void shape_store::copy_shape(int dst, int src, double ox, double oy) {
+
+    int n = size(src);
+    pending_[dst] = affine_identity();
+    // Reserve first, it may move both ranges around.
+    reserve(dst, n);
+
+    const double* sx = xs(src);
+    const double* sy = ys(src);
+    kernel_translate(sx, sy, xs(dst), ys(dst), n, ox, oy);
+    ranges[dst].length = n;
+    ranges[dst].version++;
+    moments_[dst].stale = true;
+}
+
+void shape_store::compact() {
+
+    size_t total = 0;
+    for (size_t k=0; k<ranges.size(); ++k) {
+        total += ranges[k].length;
+    }
+
+    std::vector<double> nx(total);
+    std::vector<double> ny(total);
+    size_t offset = 0;
+    for (size_t k=0; k<ranges.size(); ++k) {
+        shape_range& r = ranges[k];
+        if (r.length > 0) {
+            memcpy(&nx[offset], &x[r.offset], r.length * sizeof(double));
+            memcpy(&ny[offset], &y[r.offset], r.length * sizeof(double));
+        }
+        r.offset = offset;
+        r.capacity = r.length;
+        offset += r.length;
+    }
+
+    x.swap(nx);
+    y.swap(ny);
+    dead_ = 0;
+    layout_version_++;
+}
+
+void shape_store::add_edge(shape_moments& m, double x0, double y0, double x1, double y1, double sign) {
+
+    double cross = sign * (x0 * y1 - x1 * y0);
+    m.a2 += cross;
+    m.cx6 += (x0 + x1) * cross;
+    m.cy6 += (y0 + y1) * cross;
+}
+
+void shape_store::count_update(shape_moments& m) {
+
+    // Bound the drift of the running sums.
+    if (++m.updates >= kResumInterval) {
+        m.stale = true;
+    }
+}
+
+// Neumaier summation, the running compensation catches the low bits lost
+// when large terms of opposite sign cancel.
+struct compensated_sum {
+    compensated_sum() : sum(0.0), c(0.0) {}
+    void add(double v) {
+        double t = sum + v;
+        if (fabs(sum) >= fabs(v)) {
+            c += (sum - t) + v;
+        } else {
+            c += (v - t) + sum;
+        }
+        sum = t;
+    }
+    double value() const { return sum + c; }
+    double sum;
+    double c;
+};
+
+void shape_store::resum(int shape) const {
+
+    const double* px = xs(shape);
+    const double* py = ys(shape);
+    int n = size(shape);
+
+    compensated_sum a2, cx6, cy6;
+    for (int i=0; i<n; ++i) {
+        int j = (i + 1) % n;
+        double cross = px[i] * py[j] - px[j] * py[i];
+        a2.add(cross);
+        cx6.add((px[i] + px[j]) * cross);
+        cy6.add((py[i] + py[j]) * cross);
+    }
+
+    shape_moments& m = moments_[shape];
+    m.a2 = a2.value();
+    m.cx6 = cx6.value();
+    m.cy6 = cy6.value();
+    m.updates = 0;
+    m.stale = false;
+}
+
+double shape_store::area(int shape) const {
+
+    if (moments_[shape].stale) {
+        resum(shape);
+    }
+    return 0.5 * moments_[shape].a2 * pending_[shape].det();
+}
+
+grid_point shape_store::centroid(int shape) const {
+
+    if (moments_[shape].stale) {
+        resum(shape);
+    }
+    const shape_moments& m = moments_[shape];
+    grid_point c;
+    c.x = m.cx6 / (3.0 * m.a2);
+    c.y = m.cy6 / (3.0 * m.a2);
+    return pending_[shape].apply(c);
+}
+
+void shape_store::transform(int shape, const affine& t) {
+
+    pending_[shape] = pending_[shape].then(t);
+}
+
+void shape_store::set_transform(int shape, const affine& t) {
+
+    pending_[shape] = t;
+}
+
+void shape_store::apply_transform(int shape) {
+
+    const affine t = pending_[shape];
+    if (t.is_identity()) return;
+
+    // Committed moments, before the vertices change under them.
+    shape_moments& m = moments_[shape];
+    if (m.stale) {
+        resum(shape);
+    }
+    bool exact = (m.a2 != 0.0);
+    grid_point c;
+    if (exact) {
+        c.x = m.cx6 / (3.0 * m.a2);
+        c.y = m.cy6 / (3.0 * m.a2);
+    }
+
+    double* px = x.data() + ranges[shape].offset;
+    double* py = y.data() + ranges[shape].offset;
+    kernel_affine(px, py, px, py, size(shape), t);
+
+    // Area scales with the determinant and the centroid follows the map.
+    if (exact) {
+        c = t.apply(c);
+        m.a2 *= t.det();
+        m.cx6 = 3.0 * m.a2 * c.x;
+        m.cy6 = 3.0 * m.a2 * c.y;
+        count_update(m);
+    } else {
+        m.stale = true;
+    }
+
+    pending_[shape] = affine_identity();
+    ranges[shape].version++;
+}
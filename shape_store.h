@@ -0,0 +1,122 @@
+#ifndef SHAPE_STORE_H_
+#define SHAPE_STORE_H_
+
+#include <stddef.h>
+#include <vector>
+
+#include "affine.h"
+#include "geometry.h"
+
+// Vertex storage for the whole document. Coordinates of all shapes live in
+// two contiguous arrays; each shape owns the dense range
+// [offset, offset + length) and may keep spare capacity behind it so it can
+// grow in place. A shape that outgrows its capacity is moved to the end of
+// the arrays, and the abandoned slots are reclaimed by compact().
+//
+// Every change to a shape bumps its version, so caches derived from a shape
+// can tell when they are stale. Whoever writes through xs()/ys() calls
+// touch() afterwards. layout_version() changes whenever shapes move inside
+// the arrays.
+//
+// Signed area and centroid are kept as running sums of the per-edge shoelace
+// terms. Moving, inserting or erasing a vertex only swaps the terms of its
+// neighboring edges. Bulk writes, and every kResumInterval incremental
+// updates, mark the sums stale and they are re-summed exactly on next use.
+//
+// A shape can carry a pending affine transform, which gestures compose or
+// replace in O(1) without touching the vertices. It is baked into the
+// coordinates in one pass by apply_transform(), and implicitly by anything
+// that writes the shape or asks for writable pointers. The const xs()/ys()
+// return the committed coordinates; readers that go through them, such as
+// renderers, apply pending_transform() themselves. point(), area() and
+// centroid() already include it.
+struct shape_range {
+    size_t offset;
+    size_t length;
+    size_t capacity;
+    unsigned version;
+};
+
+struct shape_store {
+    shape_store() : dead_(0), layout_version_(0) {}
+
+    int shape_count() const { return static_cast<int>(ranges.size()); }
+    int size(int shape) const { return static_cast<int>(ranges[shape].length); }
+    unsigned version(int shape) const { return ranges[shape].version; }
+    unsigned layout_version() const { return layout_version_; }
+    void touch(int shape) {
+        ranges[shape].version++;
+        moments_[shape].stale = true;
+    }
+
+    // Pointers stay valid until the next call that adds vertices or shapes.
+    double* xs(int shape) {
+        flush_transform(shape);
+        return x.data() + ranges[shape].offset;
+    }
+    double* ys(int shape) {
+        flush_transform(shape);
+        return y.data() + ranges[shape].offset;
+    }
+    const double* xs(int shape) const { return x.data() + ranges[shape].offset; }
+    const double* ys(int shape) const { return y.data() + ranges[shape].offset; }
+
+    grid_point point(int shape, int i) const {
+        size_t k = ranges[shape].offset + i;
+        grid_point p;
+        p.x = x[k];
+        p.y = y[k];
+        return pending_[shape].apply(p);
+    }
+    void set_point(int shape, int i, const grid_point& p);
+
+    bool has_transform(int shape) const { return !pending_[shape].is_identity(); }
+    const affine& pending_transform(int shape) const { return pending_[shape]; }
+    // Follows the pending transform with t.
+    void transform(int shape, const affine& t);
+    // Replaces the pending transform.
+    void set_transform(int shape, const affine& t);
+    void apply_transform(int shape);
+
+    double area(int shape) const;
+    grid_point centroid(int shape) const;
+
+    int add_shape();
+    void reserve(int shape, int capacity);
+    void append_point(int shape, const grid_point& p);
+    void insert_point(int shape, int i, const grid_point& p);
+    void erase_point(int shape, int i);
+    void clear_shape(int shape);
+    // sx/sy must not point into this store; use copy_shape() for that.
+    void assign(int shape, const double* sx, const double* sy, int n);
+    void copy_shape(int dst, int src, double ox, double oy);
+    void compact();
+
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<shape_range> ranges;
+
+private:
+    // Twice the signed area, and six times area times centroid.
+    struct shape_moments {
+        double a2;
+        double cx6;
+        double cy6;
+        int updates;
+        bool stale;
+    };
+
+    void add_edge(shape_moments& m, double x0, double y0, double x1, double y1, double sign);
+    void count_update(shape_moments& m);
+    void resum(int shape) const;
+    void flush_transform(int shape) {
+        if (has_transform(shape)) apply_transform(shape);
+    }
+
+    size_t dead_;
+    unsigned layout_version_;
+    mutable std::vector<shape_moments> moments_;
+    std::vector<affine> pending_;
+};
+
+#endif // SHAPE_STORE_H_
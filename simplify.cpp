@@ -0,0 +1,194 @@
+#include <math.h>
+
+#include <functional>
+#include <queue>
+#include <utility>
+
+#include "simplify.h"
+
+struct ranked_vertex {
+    bool operator>(const ranked_vertex& other) const { return rank > other.rank; }
+
+    double rank;
+    int index;
+};
+
+// Segment from vertex first to vertex last, running forward around the
+// ring, and the interior vertex farthest from it.
+struct ranked_segment {
+    bool operator<(const ranked_segment& other) const { return error < other.error; }
+
+    double error;
+    int first;
+    int last;
+    int farthest;
+};
+
+static double triangle_area(const double* x, const double* y, int a, int b, int c) {
+
+    return 0.5 * fabs((x[b] - x[a]) * (y[c] - y[a]) - (x[c] - x[a]) * (y[b] - y[a]));
+}
+
+static double segment_distance_sq(const double* x, const double* y, int a, int b, int p) {
+
+    double dx = x[b] - x[a];
+    double dy = y[b] - y[a];
+    double px = x[p] - x[a];
+    double py = y[p] - y[a];
+    double len_sq = dx * dx + dy * dy;
+    double t = len_sq > 0.0 ? (px * dx + py * dy) / len_sq : 0.0;
+    if (t < 0.0) t = 0.0;
+    if (t > 1.0) t = 1.0;
+    double ex = px - t * dx;
+    double ey = py - t * dy;
+    return ex * ex + ey * ey;
+}
+
+static void keep_flagged(const std::vector<char>& kept, std::vector<int>& keep) {
+
+    keep.clear();
+    for (int i=0; i<static_cast<int>(kept.size()); ++i) {
+        if (kept[i]) keep.push_back(i);
+    }
+}
+
+static void simplify_visvalingam(const double* x, const double* y, int n,
+                                 double tolerance, int target, std::vector<int>& keep) {
+
+    std::vector<int> prev(n);
+    std::vector<int> next(n);
+    std::vector<double> area(n);
+    std::vector<char> kept(n, 1);
+    std::vector<ranked_vertex> ranks(n);
+    for (int i=0; i<n; ++i) {
+        prev[i] = (i + n - 1) % n;
+        next[i] = (i + 1) % n;
+        area[i] = triangle_area(x, y, prev[i], i, next[i]);
+        ranks[i].rank = area[i];
+        ranks[i].index = i;
+    }
+    // Every drop pushes its two neighbors again.
+    ranks.reserve(3 * n);
+    std::priority_queue<ranked_vertex, std::vector<ranked_vertex>, std::greater<ranked_vertex> >
+        heap(std::greater<ranked_vertex>(), std::move(ranks));
+
+    double threshold = tolerance * tolerance;
+    int remaining = n;
+    while (remaining > 3 && !heap.empty()) {
+        ranked_vertex v = heap.top();
+        // Entries of dropped vertices, or from before a neighbor changed.
+        if (!kept[v.index] || v.rank != area[v.index]) {
+            heap.pop();
+            continue;
+        }
+        if (target > 0 ? remaining <= target : v.rank >= threshold) break;
+        heap.pop();
+
+        int i = v.index;
+        kept[i] = 0;
+        remaining--;
+        int p = prev[i];
+        int q = next[i];
+        next[p] = q;
+        prev[q] = p;
+
+        // A neighbor never ranks below the vertex dropped before it, so the
+        // order of removal stays monotone.
+        int neighbors[2] = { p, q };
+        for (int k=0; k<2; ++k) {
+            int j = neighbors[k];
+            double a = triangle_area(x, y, prev[j], j, next[j]);
+            area[j] = a > v.rank ? a : v.rank;
+            ranked_vertex u = { area[j], j };
+            heap.push(u);
+        }
+    }
+
+    keep_flagged(kept, keep);
+}
+
+static ranked_segment rank_segment(const double* x, const double* y, int n, int first, int last) {
+
+    ranked_segment s = { -1.0, first, last, -1 };
+    int end = last > first ? last : last + n;
+    for (int k=first+1; k<end; ++k) {
+        int i = k < n ? k : k - n;
+        double d = segment_distance_sq(x, y, first, last, i);
+        if (d > s.error) {
+            s.error = d;
+            s.farthest = i;
+        }
+    }
+    return s;
+}
+
+static void simplify_douglas_peucker(const double* x, const double* y, int n,
+                                     double tolerance, int target, std::vector<int>& keep) {
+
+    std::vector<char> kept(n, 0);
+
+    // A closed outline has no end points; anchor it at vertex 0 and the
+    // vertex farthest from it.
+    int far = 0;
+    double far_sq = -1.0;
+    for (int i=1; i<n; ++i) {
+        double dx = x[i] - x[0];
+        double dy = y[i] - y[0];
+        if (dx * dx + dy * dy > far_sq) {
+            far_sq = dx * dx + dy * dy;
+            far = i;
+        }
+    }
+    kept[0] = 1;
+    kept[far] = 1;
+    int count = 2;
+
+    std::priority_queue<ranked_segment> heap;
+    heap.push(rank_segment(x, y, n, 0, far));
+    heap.push(rank_segment(x, y, n, far, 0));
+
+    double threshold = tolerance * tolerance;
+    while (!heap.empty()) {
+        ranked_segment s = heap.top();
+        if (s.farthest < 0) break;
+        if (count >= 3) {
+            if (target > 0 ? count >= target : s.error <= threshold) break;
+        }
+        heap.pop();
+
+        kept[s.farthest] = 1;
+        count++;
+        heap.push(rank_segment(x, y, n, s.first, s.farthest));
+        heap.push(rank_segment(x, y, n, s.farthest, s.last));
+    }
+
+    keep_flagged(kept, keep);
+}
+
+void simplify_outline(simplify_method method, const double* x, const double* y, int n,
+                      double tolerance, int target, std::vector<int>& keep) {
+
+    if (target > 0 && target < 3) target = 3;
+
+    if (n <= 3 || (target > 0 && target >= n)) {
+        keep.resize(n);
+        for (int i=0; i<n; ++i) {
+            keep[i] = i;
+        }
+        return;
+    }
+
+    if (method == SIMPLIFY_DOUGLAS_PEUCKER) {
+        simplify_douglas_peucker(x, y, n, tolerance, target, keep);
+    } else {
+        simplify_visvalingam(x, y, n, tolerance, target, keep);
+    }
+}
+
+const char* simplify_method_name(simplify_method method) {
+
+    switch (method) {
+    case SIMPLIFY_DOUGLAS_PEUCKER: return "Douglas-Peucker";
+    default: return "Visvalingam";
+    }
+}
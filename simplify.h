@@ -0,0 +1,27 @@
+#ifndef SIMPLIFY_H_
+#define SIMPLIFY_H_
+
+#include <vector>
+
+enum simplify_method {
+    SIMPLIFY_VISVALINGAM = 0,
+    SIMPLIFY_DOUGLAS_PEUCKER
+};
+
+// Vertex reduction for closed outlines. Fills keep with the indices of the
+// surviving vertices in ascending order, never fewer than three.
+//
+// Visvalingam-Whyatt repeatedly drops the vertex whose triangle with its
+// neighbors has the smallest area, below tolerance squared; a heap keeps
+// that O(n log n). Douglas-Peucker keeps vertices farther than tolerance
+// from the outline built so far, always splitting the segment with the
+// largest error first, without recursion.
+//
+// With target > 0 both run until target vertices remain, and tolerance is
+// ignored.
+void simplify_outline(simplify_method method, const double* x, const double* y, int n,
+                      double tolerance, int target, std::vector<int>& keep);
+
+const char* simplify_method_name(simplify_method method);
+
+#endif // SIMPLIFY_H_
@@ -0,0 +1,356 @@
+#include <math.h>
+
+#include <algorithm>
+#include <functional>
+
+#include "spatial_index.h"
+
+// Cell coordinates are clamped to +-INDEX_CELL_LIMIT, so far away vertices
+// share the edge cells instead of overflowing the int32 halves of a key,
+// and a loop up to the last cell can still step past it.
+#define INDEX_CELL_LIMIT (1 << 30)
+
+// Picking starts from the finest level that covers the search square in
+// no more than about INDEX_SCAN_CELLS cells.
+#define INDEX_LEVEL_SHIFT 4
+#define INDEX_SCAN_CELLS 64
+
+static int32_t cell_coord(double v) {
+
+    double c = floor(v);
+    if (!(c > -INDEX_CELL_LIMIT)) return -INDEX_CELL_LIMIT;
+    if (c > INDEX_CELL_LIMIT) return INDEX_CELL_LIMIT;
+    return static_cast<int32_t>(c);
+}
+
+static uint64_t make_key(int32_t ix, int32_t iy) {
+
+    return (static_cast<uint64_t>(static_cast<uint32_t>(ix)) << 32) | static_cast<uint32_t>(iy);
+}
+
+static int32_t key_x(uint64_t key) {
+
+    return static_cast<int32_t>(static_cast<uint32_t>(key >> 32));
+}
+
+static int32_t key_y(uint64_t key) {
+
+    return static_cast<int32_t>(static_cast<uint32_t>(key));
+}
+
+// Each coarser level merges INDEX_LEVEL_SHIFT bits of cell coordinates,
+// 16 x 16 cells of the level below.
+static uint64_t parent_key(uint64_t key) {
+
+    return make_key(key_x(key) >> INDEX_LEVEL_SHIFT, key_y(key) >> INDEX_LEVEL_SHIFT);
+}
+
+vertex_index::vertex_index(double cell_size)
+: cell_size_(cell_size)
+, inv_cell_size_(1.0 / cell_size)
+, count_(0)
+, groups_(INDEX_LEVELS)
+{
+}
+
+uint64_t vertex_index::cell_key(double x, double y) const {
+
+    return make_key(cell_coord(x * inv_cell_size_), cell_coord(y * inv_cell_size_));
+}
+
+void vertex_index::add_entry(uint64_t key, const entry& e) {
+
+    std::vector<entry>& cell = cells_[key];
+    if (cell.empty()) {
+        link(key, 0);
+    }
+    cell.push_back(e);
+    count_++;
+}
+
+void vertex_index::link(uint64_t key, int level) {
+
+    std::vector<uint64_t>& group = groups_[level][parent_key(key)];
+    if (group.empty() && level + 1 < INDEX_LEVELS) {
+        link(parent_key(key), level + 1);
+    }
+    group.push_back(key);
+}
+
+void vertex_index::unlink(uint64_t key, int level) {
+
+    std::unordered_map<uint64_t, std::vector<uint64_t> >::iterator it = groups_[level].find(parent_key(key));
+    if (it == groups_[level].end()) return;
+
+    std::vector<uint64_t>& group = it->second;
+    for (size_t k=0; k<group.size(); ++k) {
+        if (group[k] == key) {
+            group[k] = group.back();
+            group.pop_back();
+            break;
+        }
+    }
+    if (group.empty()) {
+        groups_[level].erase(it);
+        if (level + 1 < INDEX_LEVELS) {
+            unlink(parent_key(key), level + 1);
+        }
+    }
+}
+
+vertex_index::entry* vertex_index::find_entry(uint64_t key, int shape, int index) {
+
+    std::unordered_map<uint64_t, std::vector<entry> >::iterator it = cells_.find(key);
+    if (it == cells_.end()) return 0;
+
+    std::vector<entry>& cell = it->second;
+    for (size_t k=0; k<cell.size(); ++k) {
+        if (cell[k].shape == shape && cell[k].index == index) {
+            return &cell[k];
+        }
+    }
+    return 0;
+}
+
+void vertex_index::remove_entry(uint64_t key, int shape, int index) {
+
+    std::unordered_map<uint64_t, std::vector<entry> >::iterator it = cells_.find(key);
+    if (it == cells_.end()) return;
+
+    std::vector<entry>& cell = it->second;
+    for (size_t k=0; k<cell.size(); ++k) {
+        if (cell[k].shape == shape && cell[k].index == index) {
+            cell[k] = cell.back();
+            cell.pop_back();
+            count_--;
+            break;
+        }
+    }
+    if (cell.empty()) {
+        cells_.erase(it);
+        unlink(key, 0);
+    }
+}
+
+void vertex_index::clear_shape(int shape) {
+
+    if (shape >= static_cast<int>(keys_.size())) {
+        keys_.resize(shape + 1);
+        return;
+    }
+
+    std::vector<uint64_t>& keys = keys_[shape];
+    for (size_t i=0; i<keys.size(); ++i) {
+        remove_entry(keys[i], shape, static_cast<int>(i));
+    }
+    keys.clear();
+}
+
+void vertex_index::build(const shape_store& store) {
+
+    cells_.clear();
+    for (int l=0; l<INDEX_LEVELS; ++l) {
+        groups_[l].clear();
+    }
+    keys_.clear();
+    count_ = 0;
+    for (int k=0; k<store.shape_count(); ++k) {
+        update_shape(store, k);
+    }
+}
+
+void vertex_index::update_shape(const shape_store& store, int shape) {
+
+    clear_shape(shape);
+
+    const double* px = store.xs(shape);
+    const double* py = store.ys(shape);
+    int n = store.size(shape);
+    std::vector<uint64_t>& keys = keys_[shape];
+    keys.resize(n);
+    for (int i=0; i<n; ++i) {
+        entry e = { px[i], py[i], shape, i };
+        keys[i] = cell_key(px[i], py[i]);
+        add_entry(keys[i], e);
+    }
+}
+
+void vertex_index::insert_point(const shape_store& store, int shape, int i) {
+
+    if (shape >= static_cast<int>(keys_.size())) {
+        keys_.resize(shape + 1);
+    }
+
+    std::vector<uint64_t>& keys = keys_[shape];
+    for (int j=static_cast<int>(keys.size())-1; j>=i; --j) {
+        entry* e = find_entry(keys[j], shape, j);
+        if (e != 0) e->index = j + 1;
+    }
+
+    grid_point p = store.point(shape, i);
+    entry e = { p.x, p.y, shape, i };
+    uint64_t key = cell_key(p.x, p.y);
+    keys.insert(keys.begin() + i, key);
+    add_entry(key, e);
+}
+
+void vertex_index::erase_point(int shape, int i) {
+
+    std::vector<uint64_t>& keys = keys_[shape];
+    remove_entry(keys[i], shape, i);
+    for (int j=i+1; j<static_cast<int>(keys.size()); ++j) {
+        entry* e = find_entry(keys[j], shape, j);
+        if (e != 0) e->index = j - 1;
+    }
+    keys.erase(keys.begin() + i);
+}
+
+void vertex_index::move_point(int shape, int i, const grid_point& p) {
+
+    uint64_t& key = keys_[shape][i];
+    uint64_t new_key = cell_key(p.x, p.y);
+    if (new_key == key) {
+        entry* e = find_entry(key, shape, i);
+        e->x = p.x;
+        e->y = p.y;
+        return;
+    }
+
+    remove_entry(key, shape, i);
+    entry e = { p.x, p.y, shape, i };
+    add_entry(new_key, e);
+    key = new_key;
+}
+
+void vertex_index::nearest_in_cell(const std::vector<entry>& cell, nearest_state& state) const {
+
+    state.scanned += static_cast<int>(cell.size());
+    for (size_t k=0; k<cell.size(); ++k) {
+        double dx = cell[k].x - state.p.x;
+        double dy = cell[k].y - state.p.y;
+        double d2 = dx*dx + dy*dy;
+        if (d2 > state.bound_sq) continue;
+
+        bool preferred = (cell[k].shape == state.prefer_shape);
+        if (state.best == 0
+            || (preferred && !state.preferred)
+            || (preferred == state.preferred && d2 < state.d2)) {
+            state.best = &cell[k];
+            state.d2 = d2;
+            state.preferred = preferred;
+            // Only a preferred hit, or any hit when no shape is preferred,
+            // rules out everything farther away.
+            if (preferred || state.prefer_shape < 0) {
+                state.bound_sq = d2;
+            }
+        }
+    }
+}
+
+// Gap between coordinate q and the span of cell i, both in finest cells.
+// Edge cells also hold everything clamped into them, they reach out to
+// infinity.
+static double cell_gap(int32_t i, int shift, double q) {
+
+    double size = static_cast<double>(1 << shift);
+    double lo = static_cast<double>(i) * size;
+    double hi = lo + size;
+    if (q < lo && lo > -INDEX_CELL_LIMIT) return lo - q;
+    if (q > hi && hi <= INDEX_CELL_LIMIT) return q - hi;
+    return 0.0;
+}
+
+double vertex_index::cell_distance_sq(int level, uint64_t key, const grid_point& p) const {
+
+    int shift = INDEX_LEVEL_SHIFT * level;
+    double dx = cell_gap(key_x(key), shift, p.x * inv_cell_size_) * cell_size_;
+    double dy = cell_gap(key_y(key), shift, p.y * inv_cell_size_) * cell_size_;
+    return dx*dx + dy*dy;
+}
+
+void vertex_index::push_visit(int level, uint64_t key, const nearest_state& state,
+                              std::vector<cell_visit>& visits) const {
+
+    cell_visit v = { cell_distance_sq(level, key, state.p), level, key };
+    if (v.d2 > state.bound_sq) return;
+
+    visits.push_back(v);
+    std::push_heap(visits.begin(), visits.end(), std::greater<cell_visit>());
+}
+
+bool vertex_index::nearest(const grid_point& p, double radius_sq, int prefer_shape, int* shape, int* index) const {
+
+    nearest_state state = { p, radius_sq, prefer_shape, 0, 0.0, false, 0 };
+
+    double r = sqrt(radius_sq);
+    int32_t ix0 = cell_coord((p.x - r) * inv_cell_size_);
+    int32_t ix1 = cell_coord((p.x + r) * inv_cell_size_);
+    int32_t iy0 = cell_coord((p.y - r) * inv_cell_size_);
+    int32_t iy1 = cell_coord((p.y + r) * inv_cell_size_);
+
+    // A radius of many cells, picking on a zoomed out view, starts from a
+    // coarser level.
+    int level = 0;
+    int shift = 0;
+    double square = 0.0;
+    for (;;) {
+        square = (static_cast<double>(ix1 >> shift) - (ix0 >> shift) + 1)
+            * (static_cast<double>(iy1 >> shift) - (iy0 >> shift) + 1);
+        if (square <= INDEX_SCAN_CELLS || level == INDEX_LEVELS) break;
+        level++;
+        shift += INDEX_LEVEL_SHIFT;
+    }
+
+    std::vector<cell_visit> visits;
+    if (level == 0) {
+        for (int32_t ix=ix0; ix<=ix1; ++ix) {
+            for (int32_t iy=iy0; iy<=iy1; ++iy) {
+                uint64_t key = make_key(ix, iy);
+                if (cells_.count(key) != 0) push_visit(0, key, state, visits);
+            }
+        }
+    } else if (level < INDEX_LEVELS || square <= static_cast<double>(groups_[level - 1].size())) {
+        for (int32_t ix=ix0 >> shift; ix<=(ix1 >> shift); ++ix) {
+            for (int32_t iy=iy0 >> shift; iy<=(iy1 >> shift); ++iy) {
+                uint64_t key = make_key(ix, iy);
+                if (groups_[level - 1].count(key) != 0) push_visit(level, key, state, visits);
+            }
+        }
+    } else {
+        // Even the coarsest cells can be too many to look up one by one,
+        // then the occupied ones are walked instead.
+        std::unordered_map<uint64_t, std::vector<uint64_t> >::const_iterator it;
+        for (it = groups_[level - 1].begin(); it != groups_[level - 1].end(); ++it) {
+            push_visit(level, it->first, state, visits);
+        }
+    }
+
+    // Nearest cell first. Once the nearest left is farther than the bound,
+    // so is every vertex in the rest.
+    while (!visits.empty()) {
+        std::pop_heap(visits.begin(), visits.end(), std::greater<cell_visit>());
+        cell_visit v = visits.back();
+        visits.pop_back();
+        if (v.d2 > state.bound_sq) break;
+        if (state.best != 0 && state.scanned >= INDEX_MAX_CANDIDATES) break;
+
+        if (v.level == 0) {
+            std::unordered_map<uint64_t, std::vector<entry> >::const_iterator it = cells_.find(v.key);
+            if (it != cells_.end()) nearest_in_cell(it->second, state);
+            continue;
+        }
+
+        std::unordered_map<uint64_t, std::vector<uint64_t> >::const_iterator it = groups_[v.level - 1].find(v.key);
+        if (it == groups_[v.level - 1].end()) continue;
+        const std::vector<uint64_t>& children = it->second;
+        for (size_t k=0; k<children.size(); ++k) {
+            push_visit(v.level - 1, children[k], state, visits);
+        }
+    }
+
+    if (state.best == 0) return false;
+
+    *shape = state.best->shape;
+    *index = state.best->index;
+    return true;
+}
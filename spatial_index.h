@@ -0,0 +1,91 @@
+#ifndef SPATIAL_INDEX_H_
+#define SPATIAL_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "geometry.h"
+#include "shape_store.h"
+
+#define INDEX_LEVELS 6
+#define INDEX_MAX_CANDIDATES 4096
+
+// Uniform grid over every vertex of the document, used for hit-testing.
+// Cells are hashed, so the covered area is unbounded. For each vertex the
+// index remembers its cell, which lets entries be dropped without knowing
+// the coordinates they were inserted with.
+//
+// Above the grid, INDEX_LEVELS coarser levels of 16 x 16 cells each record
+// which cells below them are occupied. A search radius of many cells starts
+// from a coarse level and visits occupied cells nearest first, so it stops
+// as soon as no cell left can hold a better hit, whatever the radius.
+struct vertex_index {
+    explicit vertex_index(double cell_size);
+
+    void build(const shape_store& store);
+    // Re-index a shape after it has been rewritten as a whole.
+    void update_shape(const shape_store& store, int shape);
+    // Call after the store inserted/erased vertex i, later vertices shift.
+    void insert_point(const shape_store& store, int shape, int i);
+    void erase_point(int shape, int i);
+    void move_point(int shape, int i, const grid_point& p);
+
+    // Nearest vertex with distance_square(p) <= radius_sq. Any hit in
+    // prefer_shape wins over closer vertices of other shapes, as long as it
+    // is among the INDEX_MAX_CANDIDATES vertices looked at first.
+    bool nearest(const grid_point& p, double radius_sq, int prefer_shape, int* shape, int* index) const;
+
+    size_t size() const { return count_; }
+
+private:
+    struct entry {
+        double x;
+        double y;
+        int shape;
+        int index;
+    };
+
+    // Best hit so far, and how far a vertex may still be to beat it.
+    struct nearest_state {
+        grid_point p;
+        double bound_sq;
+        int prefer_shape;
+        const entry* best;
+        double d2;
+        bool preferred;
+        int scanned;
+    };
+
+    // A cell waiting to be searched, by its distance from the point.
+    struct cell_visit {
+        double d2;
+        int level;
+        uint64_t key;
+
+        bool operator>(const cell_visit& other) const { return d2 > other.d2; }
+    };
+
+    void nearest_in_cell(const std::vector<entry>& cell, nearest_state& state) const;
+    double cell_distance_sq(int level, uint64_t key, const grid_point& p) const;
+    void push_visit(int level, uint64_t key, const nearest_state& state, std::vector<cell_visit>& visits) const;
+    void link(uint64_t key, int level);
+    void unlink(uint64_t key, int level);
+    uint64_t cell_key(double x, double y) const;
+    void add_entry(uint64_t key, const entry& e);
+    void remove_entry(uint64_t key, int shape, int index);
+    entry* find_entry(uint64_t key, int shape, int index);
+    void clear_shape(int shape);
+
+    double cell_size_;
+    double inv_cell_size_;
+    size_t count_;
+    std::unordered_map<uint64_t, std::vector<entry> > cells_;
+    // groups_[l] lists, for each cell of level l + 1, its cells of level l
+    // that hold vertices. Level 0 is cells_.
+    std::vector<std::unordered_map<uint64_t, std::vector<uint64_t> > > groups_;
+    std::vector<std::vector<uint64_t> > keys_;
+};
+
+#endif // SPATIAL_INDEX_H_
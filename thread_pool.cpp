@@ -0,0 +1,116 @@
+#include "thread_pool.h"
+
+static int pool_threads(int threads) {
+
+    if (threads > 0) return threads;
+
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    return cores > 0 ? cores : 1;
+}
+
+thread_pool::thread_pool(int threads)
+: queues_(pool_threads(threads))
+, generation_(0)
+, stopping_(false)
+, job_(0)
+, remaining_(0)
+{
+    // Queue 0 belongs to the thread calling run().
+    for (int i=1; i<size(); ++i) {
+        threads_.push_back(std::thread(&thread_pool::worker, this, i));
+    }
+}
+
+thread_pool::~thread_pool() {
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (size_t i=0; i<threads_.size(); ++i) {
+        threads_[i].join();
+    }
+}
+
+void thread_pool::run(int count, const std::function<void(int)>& job) {
+
+    if (count <= 0) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &job;
+        remaining_ = count;
+
+        // Contiguous blocks keep neighboring tasks on one thread.
+        int n = size();
+        for (int q=0; q<n; ++q) {
+            std::lock_guard<std::mutex> queue_lock(queues_[q].mutex);
+            int begin = static_cast<int>(static_cast<long long>(count) * q / n);
+            int end = static_cast<int>(static_cast<long long>(count) * (q + 1) / n);
+            for (int i=begin; i<end; ++i) {
+                queues_[q].tasks.push_back(i);
+            }
+        }
+        generation_++;
+    }
+    wake_.notify_all();
+
+    int task;
+    while (next_task(0, &task)) {
+        job(task);
+        if (remaining_.fetch_sub(1) == 1) break;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return remaining_ == 0; });
+}
+
+void thread_pool::worker(int self) {
+
+    unsigned long seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+            if (stopping_) return;
+            seen = generation_;
+        }
+
+        // job_ is only read after taking a task, and the run() that set it
+        // cannot return before that task is done.
+        int task;
+        while (next_task(self, &task)) {
+            (*job_)(task);
+            if (remaining_.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_.notify_all();
+            }
+        }
+    }
+}
+
+bool thread_pool::next_task(int self, int* task) {
+
+    {
+        task_queue& own = queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            *task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    int n = size();
+    for (int i=1; i<n; ++i) {
+        task_queue& victim = queues_[(self + i) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            *task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,53 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. run() deals the
+// task indices out in contiguous blocks, one deque per thread. Each thread
+// works through its own deque from the back and, once that is empty,
+// steals from the front of the others, so uneven tasks still keep every
+// core busy. The calling thread takes part as well.
+struct thread_pool {
+    // 0 threads picks one per core.
+    explicit thread_pool(int threads = 0);
+    ~thread_pool();
+
+    // Threads run() spreads over, the caller included.
+    int size() const { return static_cast<int>(queues_.size()); }
+
+    // Calls job(i) for every i in [0, count) and returns when all are done.
+    // Not reentrant: job must not call run() on the same pool.
+    void run(int count, const std::function<void(int)>& job);
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+private:
+    struct task_queue {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    void worker(int self);
+    bool next_task(int self, int* task);
+
+    std::vector<task_queue> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    unsigned long generation_;
+    bool stopping_;
+    const std::function<void(int)>* job_;
+    std::atomic<int> remaining_;
+};
+
+#endif // THREAD_POOL_H_
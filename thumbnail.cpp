@@ -0,0 +1,119 @@
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "mass_properties.h"
+#include "self_intersection.h"
+#include "thumbnail.h"
+
+// The editor's colors, see render_shape(), render_shape_center() and
+// render_vertice_order().
+static const raster_color kBackground = { 0.0f, 0.0f, 0.0f };
+static const raster_color kOutline = { 1.0f, 1.0f, 1.0f };
+static const raster_color kCenter = { 0.5f, 0.5f, 1.0f };
+static const raster_color kWinding = { 0.0f, 0.7f, 0.0f };
+static const raster_color kCrossing = { 1.0f, 0.0f, 0.0f };
+
+// Line widths are the editor's in pixels at this thumbnail size; markers
+// keep their grid sizes at THUMBNAIL_MARKER_SCALE thumbnail sizes per
+// grid unit.
+#define THUMBNAIL_LINE_SIZE 256.0
+#define THUMBNAIL_MARKER_SCALE 0.25
+#define THUMBNAIL_FILL_ALPHA 0.2f
+
+static double line_width(double editor_width, int size) {
+
+    return std::max(1.0, editor_width * size / THUMBNAIL_LINE_SIZE);
+}
+
+void draw_thumbnail(raster_canvas& canvas, const shape_store& store, int shape) {
+
+    canvas.clear(kBackground);
+
+    int n = store.size(shape);
+    if (n == 0) return;
+
+    const affine& t = store.pending_transform(shape);
+    const double* sx = store.xs(shape);
+    const double* sy = store.ys(shape);
+    std::vector<double> x(n);
+    std::vector<double> y(n);
+    for (int i=0; i<n; ++i) {
+        grid_point p = { sx[i], sy[i] };
+        p = t.apply(p);
+        x[i] = p.x;
+        y[i] = p.y;
+    }
+
+    // Computed here rather than asked from the store, whose cached sums
+    // are not safe to refresh from several threads.
+    mass_properties mass;
+    compute_mass_properties(x.data(), y.data(), n, mass);
+
+    int size = std::min(canvas.width(), canvas.height());
+    double extent = std::max(mass.max.x - mass.min.x, mass.max.y - mass.min.y);
+    double scale = extent > 0.0 ? 0.8 * size / extent : 1.0;
+    double mid_x = 0.5 * (mass.min.x + mass.max.x);
+    double mid_y = 0.5 * (mass.min.y + mass.max.y);
+    double ox = 0.5 * canvas.width();
+    double oy = 0.5 * canvas.height();
+
+    // Vertices closer than half a pixel to the last one kept would not
+    // show, huge outlines shrink to what the thumbnail can resolve.
+    std::vector<double> px;
+    std::vector<double> py;
+    for (int i=0; i<n; ++i) {
+        double qx = ox + (x[i] - mid_x) * scale;
+        double qy = oy - (y[i] - mid_y) * scale;
+        if (!px.empty() && fabs(qx - px.back()) < 0.5 && fabs(qy - py.back()) < 0.5) continue;
+        px.push_back(qx);
+        py.push_back(qy);
+    }
+    int m = static_cast<int>(px.size());
+
+    canvas.path_polygon(px.data(), py.data(), m);
+    canvas.fill(kOutline, THUMBNAIL_FILL_ALPHA);
+
+    double outline = line_width(3.0, size);
+    for (int i=0; i<m; ++i) {
+        int j = (i + 1 == m) ? 0 : i + 1;
+        canvas.path_stroke(px[i], py[i], px[j], py[j], outline);
+    }
+    canvas.fill(kOutline, 1.0f);
+
+    if (n < 3 || mass.area == 0.0) return;
+
+    double marker = size * THUMBNAIL_MARKER_SCALE;
+    double cx = ox + (mass.centroid.x - mid_x) * scale;
+    double cy = oy - (mass.centroid.y - mid_y) * scale;
+
+    double cross = 0.25 * marker;
+    double width = line_width(1.0, size);
+    canvas.path_stroke(cx - cross, cy, cx + cross, cy, width);
+    canvas.path_stroke(cx, cy - cross, cx, cy + cross, width);
+    canvas.fill(kCenter, 1.0f);
+
+    // Arc over the centroid with a head at the end the outline winds to.
+    std::vector<edge_pair> pairs;
+    find_crossings(sx, sy, n, pairs);
+    width = line_width(2.0, size);
+    double a = 0.25 * M_PI;
+    for (; a + 0.1 <= 0.75 * M_PI; a+=0.1) {
+        canvas.path_stroke(cx + 0.2 * marker * cos(a), cy - 0.2 * marker * sin(a),
+                           cx + 0.2 * marker * cos(a + 0.1), cy - 0.2 * marker * sin(a + 0.1), width);
+    }
+    double da;
+    if (mass.area < 0.0) {
+        a = 0.25 * M_PI;
+        da = 25.0 * M_PI / 180.0;
+    } else {
+        a = 0.75 * M_PI;
+        da = -25.0 * M_PI / 180.0;
+    }
+    double tip_x = cx + 0.2 * marker * cos(a);
+    double tip_y = cy - 0.2 * marker * sin(a);
+    canvas.path_stroke(cx + 0.1 * marker * cos(a + da), cy - 0.1 * marker * sin(a + da), tip_x, tip_y, width);
+    canvas.path_stroke(tip_x, tip_y, cx + 0.3 * marker * cos(a + da), cy - 0.3 * marker * sin(a + da), width);
+    canvas.fill(pairs.empty() ? kWinding : kCrossing, 1.0f);
+}
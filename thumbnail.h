@@ -0,0 +1,15 @@
+#ifndef THUMBNAIL_H_
+#define THUMBNAIL_H_
+
+#include "raster.h"
+#include "shape_store.h"
+
+// Draws a shape the way the editor draws the current one: white outline
+// over a faint fill, centroid cross, and the winding arrow, red when the
+// outline crosses itself. The shape, pending transform included, is
+// scaled to fit the canvas with y up as on the editor's grid.
+//
+// Only reads the store, so several threads may draw from one store.
+void draw_thumbnail(raster_canvas& canvas, const shape_store& store, int shape);
+
+#endif // THUMBNAIL_H_
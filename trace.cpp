@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "trace.h"
+
+// A slot's sequence is 2 i + 1 while event i is written into it and
+// 2 i + 2 once it is complete, so readers can tell a finished event from
+// one that is half written or already overwritten.
+struct trace_slot {
+    std::atomic<uint64_t> sequence;
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> begin;
+    std::atomic<uint64_t> end;
+    std::atomic<int> thread;
+};
+
+struct trace_event {
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+    int thread;
+};
+
+std::atomic<bool> trace_enabled_(false);
+
+static trace_slot ring_[TRACE_CAPACITY];
+static std::atomic<uint64_t> head_(0);
+static std::atomic<int> thread_count_(0);
+
+static float frame_ms_[TRACE_FRAMES];
+static int frame_count_ = 0;
+
+uint64_t trace_clock_ns() {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + ts.tv_nsec;
+}
+
+// Small numbers in the order threads first record, the editor's is 0 as
+// it records first.
+static int thread_number() {
+
+    static thread_local int number = -1;
+    if (number < 0) number = thread_count_.fetch_add(1, std::memory_order_relaxed);
+    return number;
+}
+
+void trace_record(const char* name, uint64_t begin_ns, uint64_t end_ns) {
+
+    uint64_t i = head_.fetch_add(1, std::memory_order_relaxed);
+    trace_slot& s = ring_[i & (TRACE_CAPACITY - 1)];
+
+    s.sequence.store(2 * i + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.name.store(name, std::memory_order_relaxed);
+    s.begin.store(begin_ns, std::memory_order_relaxed);
+    s.end.store(end_ns, std::memory_order_relaxed);
+    s.thread.store(thread_number(), std::memory_order_relaxed);
+    s.sequence.store(2 * i + 2, std::memory_order_release);
+}
+
+void trace_enable(bool enable) {
+
+    trace_enabled_.store(enable, std::memory_order_relaxed);
+}
+
+uint64_t trace_event_count() {
+
+    return head_.load(std::memory_order_relaxed);
+}
+
+static bool read_slot(uint64_t i, trace_event* e) {
+
+    const trace_slot& s = ring_[i & (TRACE_CAPACITY - 1)];
+    uint64_t sequence = s.sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * i + 2) return false;
+
+    e->name = s.name.load(std::memory_order_relaxed);
+    e->begin = s.begin.load(std::memory_order_relaxed);
+    e->end = s.end.load(std::memory_order_relaxed);
+    e->thread = s.thread.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return s.sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+bool trace_write_chrome(const char* path) {
+
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t first = head > TRACE_CAPACITY ? head - TRACE_CAPACITY : 0;
+    std::vector<trace_event> events;
+    events.reserve(head - first);
+    for (uint64_t i=first; i<head; ++i) {
+        trace_event e;
+        if (read_slot(i, &e)) events.push_back(e);
+    }
+
+    FILE *fSave = fopen(path, "w");
+    if (fSave == 0) return false;
+
+    // Times in microseconds from the earliest event kept.
+    uint64_t origin = 0;
+    for (size_t k=0; k<events.size(); ++k) {
+        if (k == 0 || events[k].begin < origin) origin = events[k].begin;
+    }
+    fprintf(fSave, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (size_t k=0; k<events.size(); ++k) {
+        const trace_event& e = events[k];
+        fprintf(fSave, "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+            k == 0 ? "" : ",", e.name, e.thread,
+            (e.begin - origin) * 1e-3, (e.end - e.begin) * 1e-3);
+    }
+    fprintf(fSave, "\n]}\n");
+
+    return fclose(fSave) == 0;
+}
+
+void trace_frame(uint64_t begin_ns, uint64_t end_ns) {
+
+    frame_ms_[frame_count_ % TRACE_FRAMES] = (end_ns - begin_ns) * 1e-6f;
+    frame_count_++;
+    if (trace_enabled_.load(std::memory_order_relaxed)) {
+        trace_record("frame", begin_ns, end_ns);
+    }
+}
+
+int trace_frame_times(float* ms, int max) {
+
+    int count = std::min(std::min(frame_count_, TRACE_FRAMES), max);
+    for (int k=0; k<count; ++k) {
+        ms[k] = frame_ms_[(frame_count_ - count + k) % TRACE_FRAMES];
+    }
+    return count;
+}
@@ -0,0 +1,58 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+#include <atomic>
+
+// Scoped timers for finding out where frame time goes. TRACE_SCOPE("name")
+// times the rest of the enclosing block and records it in a ring buffer
+// holding the last TRACE_CAPACITY events. Any thread may record; writers
+// claim slots with one atomic increment and never wait for each other or
+// for a dump. Off, a scope costs a relaxed load and a branch.
+//
+// Names are kept by pointer, so they must be string literals.
+#define TRACE_CAPACITY (1 << 16)
+#define TRACE_FRAMES 128
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name) trace_scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+extern std::atomic<bool> trace_enabled_;
+
+uint64_t trace_clock_ns();
+void trace_record(const char* name, uint64_t begin_ns, uint64_t end_ns);
+
+struct trace_scope {
+    explicit trace_scope(const char* name)
+    : name_(name)
+    , begin_(trace_enabled_.load(std::memory_order_relaxed) ? trace_clock_ns() : 0)
+    {
+    }
+    ~trace_scope() {
+        if (begin_ != 0) trace_record(name_, begin_, trace_clock_ns());
+    }
+
+    trace_scope(const trace_scope&) = delete;
+    trace_scope& operator=(const trace_scope&) = delete;
+
+private:
+    const char* name_;
+    uint64_t begin_;
+};
+
+void trace_enable(bool enable);
+// Events recorded so far, at most TRACE_CAPACITY of them are kept.
+uint64_t trace_event_count();
+
+// Writes the events in the ring as Chrome trace JSON, for chrome://tracing
+// or Perfetto. Events being written meanwhile are left out.
+bool trace_write_chrome(const char* path);
+
+// Work time of the last TRACE_FRAMES frames, kept whether or not tracing
+// is on. The editor's thread only.
+void trace_frame(uint64_t begin_ns, uint64_t end_ns);
+// Copies up to max frame times in ms into ms, oldest first; returns how many.
+int trace_frame_times(float* ms, int max);
+
+#endif // TRACE_H_
@@ -0,0 +1,248 @@
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNEL_X86 1
+#endif
+
+#include "transform_kernels.h"
+
+// A fused multiply-add rounds once where the scalar code rounds twice, which
+// would break bit-identity between the bodies.
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+static void translate_scalar(const double* sx, const double* sy, double* dx, double* dy, int n,
+                             double ox, double oy) {
+    for (int i=0; i<n; ++i) {
+        dx[i] = sx[i] + ox;
+        dy[i] = sy[i] + oy;
+    }
+}
+
+static void affine_scalar(const double* sx, const double* sy, double* dx, double* dy, int n,
+                          const affine& t) {
+    for (int i=0; i<n; ++i) {
+        double vx = sx[i];
+        double vy = sy[i];
+        dx[i] = (t.a * vx + t.b * vy) + t.tx;
+        dy[i] = (t.c * vx + t.d * vy) + t.ty;
+    }
+}
+
+static void quantize_scalar(const double* sx, const double* sy, double* dx, double* dy, int n,
+                            double factor) {
+    for (int i=0; i<n; ++i) {
+        dx[i] = round(sx[i] * factor) / factor;
+        dy[i] = round(sy[i] * factor) / factor;
+    }
+}
+
+#ifdef KERNEL_X86
+
+__attribute__((target("sse2")))
+static void translate_sse2(const double* sx, const double* sy, double* dx, double* dy, int n,
+                           double ox, double oy) {
+    __m128d vox = _mm_set1_pd(ox);
+    __m128d voy = _mm_set1_pd(oy);
+    int i = 0;
+    for (; i+2<=n; i+=2) {
+        _mm_storeu_pd(dx + i, _mm_add_pd(_mm_loadu_pd(sx + i), vox));
+        _mm_storeu_pd(dy + i, _mm_add_pd(_mm_loadu_pd(sy + i), voy));
+    }
+    translate_scalar(sx + i, sy + i, dx + i, dy + i, n - i, ox, oy);
+}
+
+__attribute__((target("sse2")))
+static void affine_sse2(const double* sx, const double* sy, double* dx, double* dy, int n,
+                        const affine& t) {
+    __m128d a = _mm_set1_pd(t.a);
+    __m128d b = _mm_set1_pd(t.b);
+    __m128d c = _mm_set1_pd(t.c);
+    __m128d d = _mm_set1_pd(t.d);
+    __m128d tx = _mm_set1_pd(t.tx);
+    __m128d ty = _mm_set1_pd(t.ty);
+    int i = 0;
+    for (; i+2<=n; i+=2) {
+        __m128d vx = _mm_loadu_pd(sx + i);
+        __m128d vy = _mm_loadu_pd(sy + i);
+        __m128d rx = _mm_add_pd(_mm_add_pd(_mm_mul_pd(a, vx), _mm_mul_pd(b, vy)), tx);
+        __m128d ry = _mm_add_pd(_mm_add_pd(_mm_mul_pd(c, vx), _mm_mul_pd(d, vy)), ty);
+        _mm_storeu_pd(dx + i, rx);
+        _mm_storeu_pd(dy + i, ry);
+    }
+    affine_scalar(sx + i, sy + i, dx + i, dy + i, n - i, t);
+}
+
+// round() without SSE4.1: below 2^52, adding and subtracting 2^52 rounds
+// to nearest even, and ties that went down are bumped up. Larger values
+// are integers already.
+__attribute__((target("sse2")))
+static inline __m128d round_sse2(__m128d v) {
+    const __m128d sign_mask = _mm_set1_pd(-0.0);
+    const __m128d two52 = _mm_set1_pd(4503599627370496.0);
+    __m128d sign = _mm_and_pd(v, sign_mask);
+    __m128d a = _mm_andnot_pd(sign_mask, v);
+    __m128d r = _mm_sub_pd(_mm_add_pd(a, two52), two52);
+    __m128d tie = _mm_cmpeq_pd(_mm_sub_pd(a, r), _mm_set1_pd(0.5));
+    r = _mm_add_pd(r, _mm_and_pd(tie, _mm_set1_pd(1.0)));
+    __m128d big = _mm_cmpge_pd(a, two52);
+    r = _mm_or_pd(_mm_and_pd(big, a), _mm_andnot_pd(big, r));
+    return _mm_or_pd(r, sign);
+}
+
+__attribute__((target("sse2")))
+static void quantize_sse2(const double* sx, const double* sy, double* dx, double* dy, int n,
+                          double factor) {
+    __m128d f = _mm_set1_pd(factor);
+    int i = 0;
+    for (; i+2<=n; i+=2) {
+        __m128d vx = round_sse2(_mm_mul_pd(_mm_loadu_pd(sx + i), f));
+        __m128d vy = round_sse2(_mm_mul_pd(_mm_loadu_pd(sy + i), f));
+        _mm_storeu_pd(dx + i, _mm_div_pd(vx, f));
+        _mm_storeu_pd(dy + i, _mm_div_pd(vy, f));
+    }
+    quantize_scalar(sx + i, sy + i, dx + i, dy + i, n - i, factor);
+}
+
+__attribute__((target("avx2")))
+static void translate_avx2(const double* sx, const double* sy, double* dx, double* dy, int n,
+                           double ox, double oy) {
+    __m256d vox = _mm256_set1_pd(ox);
+    __m256d voy = _mm256_set1_pd(oy);
+    int i = 0;
+    for (; i+4<=n; i+=4) {
+        _mm256_storeu_pd(dx + i, _mm256_add_pd(_mm256_loadu_pd(sx + i), vox));
+        _mm256_storeu_pd(dy + i, _mm256_add_pd(_mm256_loadu_pd(sy + i), voy));
+    }
+    translate_scalar(sx + i, sy + i, dx + i, dy + i, n - i, ox, oy);
+}
+
+__attribute__((target("avx2")))
+static void affine_avx2(const double* sx, const double* sy, double* dx, double* dy, int n,
+                        const affine& t) {
+    __m256d a = _mm256_set1_pd(t.a);
+    __m256d b = _mm256_set1_pd(t.b);
+    __m256d c = _mm256_set1_pd(t.c);
+    __m256d d = _mm256_set1_pd(t.d);
+    __m256d tx = _mm256_set1_pd(t.tx);
+    __m256d ty = _mm256_set1_pd(t.ty);
+    int i = 0;
+    for (; i+4<=n; i+=4) {
+        __m256d vx = _mm256_loadu_pd(sx + i);
+        __m256d vy = _mm256_loadu_pd(sy + i);
+        __m256d rx = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a, vx), _mm256_mul_pd(b, vy)), tx);
+        __m256d ry = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(c, vx), _mm256_mul_pd(d, vy)), ty);
+        _mm256_storeu_pd(dx + i, rx);
+        _mm256_storeu_pd(dy + i, ry);
+    }
+    affine_scalar(sx + i, sy + i, dx + i, dy + i, n - i, t);
+}
+
+__attribute__((target("avx2")))
+static inline __m256d round_avx2(__m256d v) {
+    const __m256d sign_mask = _mm256_set1_pd(-0.0);
+    __m256d sign = _mm256_and_pd(v, sign_mask);
+    __m256d a = _mm256_andnot_pd(sign_mask, v);
+    // Truncate, then step away from zero when the dropped part is >= 0.5.
+    __m256d r = _mm256_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m256d up = _mm256_cmp_pd(_mm256_sub_pd(a, r), _mm256_set1_pd(0.5), _CMP_GE_OQ);
+    r = _mm256_add_pd(r, _mm256_and_pd(up, _mm256_set1_pd(1.0)));
+    return _mm256_or_pd(r, sign);
+}
+
+__attribute__((target("avx2")))
+static void quantize_avx2(const double* sx, const double* sy, double* dx, double* dy, int n,
+                          double factor) {
+    __m256d f = _mm256_set1_pd(factor);
+    int i = 0;
+    for (; i+4<=n; i+=4) {
+        __m256d vx = round_avx2(_mm256_mul_pd(_mm256_loadu_pd(sx + i), f));
+        __m256d vy = round_avx2(_mm256_mul_pd(_mm256_loadu_pd(sy + i), f));
+        _mm256_storeu_pd(dx + i, _mm256_div_pd(vx, f));
+        _mm256_storeu_pd(dy + i, _mm256_div_pd(vy, f));
+    }
+    quantize_scalar(sx + i, sy + i, dx + i, dy + i, n - i, factor);
+}
+
+#endif // KERNEL_X86
+
+static kernel_isa best_isa() {
+#ifdef KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return KERNEL_AVX2;
+    if (__builtin_cpu_supports("sse2")) return KERNEL_SSE2;
+#endif
+    return KERNEL_SCALAR;
+}
+
+// Resolved once, thread-safe through static initialization.
+static kernel_isa& current_isa() {
+    static kernel_isa isa = best_isa();
+    return isa;
+}
+
+void kernel_translate(const double* sx, const double* sy, double* dx, double* dy, int n,
+                      double ox, double oy) {
+    switch (current_isa()) {
+#ifdef KERNEL_X86
+    case KERNEL_AVX2: translate_avx2(sx, sy, dx, dy, n, ox, oy); break;
+    case KERNEL_SSE2: translate_sse2(sx, sy, dx, dy, n, ox, oy); break;
+#endif
+    default: translate_scalar(sx, sy, dx, dy, n, ox, oy); break;
+    }
+}
+
+void kernel_affine(const double* sx, const double* sy, double* dx, double* dy, int n,
+                   const affine& t) {
+    // Pure translations skip the multiplies; 1*x + 0*y would also turn -0
+    // into +0.
+    if (t.a == 1.0 && t.b == 0.0 && t.c == 0.0 && t.d == 1.0) {
+        kernel_translate(sx, sy, dx, dy, n, t.tx, t.ty);
+        return;
+    }
+
+    switch (current_isa()) {
+#ifdef KERNEL_X86
+    case KERNEL_AVX2: affine_avx2(sx, sy, dx, dy, n, t); break;
+    case KERNEL_SSE2: affine_sse2(sx, sy, dx, dy, n, t); break;
+#endif
+    default: affine_scalar(sx, sy, dx, dy, n, t); break;
+    }
+}
+
+void kernel_quantize(const double* sx, const double* sy, double* dx, double* dy, int n,
+                     double factor) {
+    switch (current_isa()) {
+#ifdef KERNEL_X86
+    case KERNEL_AVX2: quantize_avx2(sx, sy, dx, dy, n, factor); break;
+    case KERNEL_SSE2: quantize_sse2(sx, sy, dx, dy, n, factor); break;
+#endif
+    default: quantize_scalar(sx, sy, dx, dy, n, factor); break;
+    }
+}
+
+bool kernel_select(kernel_isa isa) {
+
+    if (isa > best_isa()) return false;
+
+    current_isa() = isa;
+    return true;
+}
+
+kernel_isa kernel_selected() {
+
+    return current_isa();
+}
+
+const char* kernel_isa_name(kernel_isa isa) {
+
+    switch (isa) {
+    case KERNEL_AVX2: return "avx2";
+    case KERNEL_SSE2: return "sse2";
+    default: return "scalar";
+    }
+}
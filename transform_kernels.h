@@ -0,0 +1,34 @@
+#ifndef TRANSFORM_KERNELS_H_
+#define TRANSFORM_KERNELS_H_
+
+#include "affine.h"
+
+// Batch kernels over contiguous x/y coordinate arrays. Each has a scalar,
+// an SSE2 and an AVX2 body; the widest one the CPU supports is picked on
+// first use. The vector bodies do the same IEEE operations in the same
+// order as the scalar one and never fuse multiply-adds, so every ISA gives
+// bit-identical results (0 ULP). Source and destination may be the same
+// arrays.
+
+enum kernel_isa {
+    KERNEL_SCALAR = 0,
+    KERNEL_SSE2,
+    KERNEL_AVX2
+};
+
+// x' = x + dx, y' = y + dy
+void kernel_translate(const double* sx, const double* sy, double* dx, double* dy, int n,
+                      double ox, double oy);
+// x' = (a*x + b*y) + tx, y' = (c*x + d*y) + ty
+void kernel_affine(const double* sx, const double* sy, double* dx, double* dy, int n,
+                   const affine& t);
+// v' = round(v * factor) / factor, halfway cases away from zero.
+void kernel_quantize(const double* sx, const double* sy, double* dx, double* dy, int n,
+                     double factor);
+
+// Forces an ISA, for benchmarks. Returns false if the CPU lacks it.
+bool kernel_select(kernel_isa isa);
+kernel_isa kernel_selected();
+const char* kernel_isa_name(kernel_isa isa);
+
+#endif // TRANSFORM_KERNELS_H_
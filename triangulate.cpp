@@ -0,0 +1,512 @@
+#include <algorithm>
+#include <math.h>
+#include <set>
+
+#include "self_intersection.h"
+#include "triangulate.h"
+
+static double cross(const double* x, const double* y, int a, int b, int c) {
+
+    return (x[b] - x[a]) * (y[c] - y[a]) - (x[c] - x[a]) * (y[b] - y[a]);
+}
+
+// Left of or on the line through a and b, counting points within rounding
+// error of the line as on it.
+static bool left_or_on(const double* x, const double* y, int a, int b, int p) {
+
+    double l = (x[b] - x[a]) * (y[p] - y[a]);
+    double r = (x[p] - x[a]) * (y[b] - y[a]);
+    return l - r >= -1e-12 * (fabs(l) + fabs(r));
+}
+
+// Inside or on the border of the counter-clockwise triangle abc. Vertices
+// on a would-be diagonal block the ear, or it would cut through them.
+static bool in_triangle(const double* x, const double* y, int a, int b, int c, int p) {
+
+    return left_or_on(x, y, a, b, p) && left_or_on(x, y, b, c, p) && left_or_on(x, y, c, a, p);
+}
+
+bool triangulate_ears(const double* x, const double* y, int n, std::vector<int>& triangles) {
+
+    triangles.clear();
+    if (n < 3) return n == 0;
+
+    double area2 = 0.0;
+    for (int i=0, j=n-1; i<n; j=i++) {
+        area2 += x[j] * y[i] - x[i] * y[j];
+    }
+
+    // Ring of vertex indices in counter-clockwise order.
+    std::vector<int> prev(n);
+    std::vector<int> next(n);
+    for (int i=0; i<n; ++i) {
+        if (area2 >= 0.0) {
+            prev[i] = (i + n - 1) % n;
+            next[i] = (i + 1) % n;
+        } else {
+            prev[i] = (i + 1) % n;
+            next[i] = (i + n - 1) % n;
+        }
+    }
+    std::vector<char> reflex(n);
+    for (int i=0; i<n; ++i) {
+        reflex[i] = cross(x, y, prev[i], i, next[i]) <= 0.0;
+    }
+
+    bool simple = true;
+    int remaining = n;
+    int v = 0;
+    int misses = 0;
+    while (remaining > 3) {
+        int p = prev[v];
+        int q = next[v];
+        double turn = cross(x, y, p, v, q);
+
+        bool clip = false;
+        bool emit = true;
+        if (turn > 0.0) {
+            clip = true;
+            for (int r=next[q]; r!=p; r=next[r]) {
+                if (reflex[r] && in_triangle(x, y, p, v, q, r)) {
+                    clip = false;
+                    break;
+                }
+            }
+        } else if (turn == 0.0) {
+            // Straight through: v is not needed. A spike turning back is.
+            double dot = (x[v] - x[p]) * (x[q] - x[v]) + (y[v] - y[p]) * (y[q] - y[v]);
+            clip = dot >= 0.0;
+            emit = false;
+        }
+        if (!clip && misses > remaining) {
+            // No ear left, the outline crosses itself.
+            clip = true;
+            simple = false;
+        }
+
+        if (!clip) {
+            v = q;
+            misses++;
+            continue;
+        }
+
+        if (emit) {
+            triangles.push_back(p);
+            triangles.push_back(turn >= 0.0 ? v : q);
+            triangles.push_back(turn >= 0.0 ? q : v);
+        }
+        next[p] = q;
+        prev[q] = p;
+        remaining--;
+        reflex[p] = cross(x, y, prev[p], p, q) <= 0.0;
+        reflex[q] = cross(x, y, p, q, next[q]) <= 0.0;
+        v = p;
+        misses = 0;
+    }
+
+    int p = prev[v];
+    int q = next[v];
+    if (cross(x, y, p, v, q) != 0.0) {
+        triangles.push_back(p);
+        triangles.push_back(v);
+        triangles.push_back(q);
+    }
+    return simple;
+}
+
+// Monotone partition. Vertices are ordered top to bottom, those at equal
+// height left to right, as if the plane were tilted a little.
+static bool above(const double* x, const double* y, int a, int b) {
+
+    return y[a] > y[b] || (y[a] == y[b] && x[a] < x[b]);
+}
+
+// Edges of the reduced outline by their x where the sweep line meets them.
+// Edge e runs from vertex e to e+1; -1 stands for the sweep point itself.
+struct edge_order {
+    double at(int e) const {
+
+        if (e < 0) return *sx;
+        int b = e + 1 == n ? 0 : e + 1;
+        if (y[e] == y[b]) {
+            return std::max(std::min(x[e], x[b]), std::min(std::max(x[e], x[b]), *sx));
+        }
+        double t = (*sy - y[e]) / (y[b] - y[e]);
+        if (t <= 0.0) return x[e];
+        if (t >= 1.0) return x[b];
+        return x[e] + t * (x[b] - x[e]);
+    }
+
+    bool operator()(int l, int r) const {
+
+        double xl = at(l);
+        double xr = at(r);
+        if (xl != xr) return xl < xr;
+        // An edge through the sweep point counts as left of it.
+        if (l < 0 || r < 0) return r < 0 && l >= 0;
+        return l < r;
+    }
+
+    const double* x;
+    const double* y;
+    int n;
+    const double* sx;
+    const double* sy;
+};
+
+enum vertex_kind {
+    VERTEX_START,
+    VERTEX_SPLIT,
+    VERTEX_END,
+    VERTEX_MERGE,
+    VERTEX_REGULAR
+};
+
+// Diagonals splitting a counter-clockwise simple outline into pieces
+// monotone in y, found by a sweep from the top keeping the edges with the
+// inside on their right, each with the helper vertex a diagonal from below
+// would connect to.
+static void monotone_diagonals(const double* x, const double* y, int n, std::vector<int>& diagonals) {
+
+    std::vector<int> order(n);
+    for (int i=0; i<n; ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [x, y](int a, int b) { return above(x, y, a, b); });
+
+    double sx = 0.0;
+    double sy = 0.0;
+    edge_order less = { x, y, n, &sx, &sy };
+    typedef std::set<int, edge_order> status_set;
+    status_set status(less);
+    std::vector<status_set::iterator> edges(n, status.end());
+    std::vector<int> helper(n, -1);
+    std::vector<char> kind(n);
+
+    // Edge left of the sweep point.
+    auto left_of = [&status]() {
+        status_set::iterator it = status.lower_bound(-1);
+        return it == status.begin() ? -1 : *--it;
+    };
+    auto connect = [&diagonals, &helper, &kind](int e, int v, bool merge_only) {
+        if (e < 0) return;
+        int h = helper[e];
+        if (h >= 0 && (!merge_only || kind[h] == VERTEX_MERGE)) {
+            diagonals.push_back(v);
+            diagonals.push_back(h);
+        }
+    };
+
+    for (int k=0; k<n; ++k) {
+        int v = order[k];
+        int p = v == 0 ? n - 1 : v - 1;
+        int q = v + 1 == n ? 0 : v + 1;
+        sx = x[v];
+        sy = y[v];
+        bool convex = cross(x, y, p, v, q) > 0.0;
+        bool p_below = above(x, y, v, p);
+        bool q_below = above(x, y, v, q);
+
+        if (p_below && q_below) {
+            kind[v] = convex ? VERTEX_START : VERTEX_SPLIT;
+            if (!convex) {
+                int e = left_of();
+                connect(e, v, false);
+                if (e >= 0) helper[e] = v;
+            }
+            edges[v] = status.insert(v).first;
+            helper[v] = v;
+        } else if (!p_below && !q_below) {
+            kind[v] = convex ? VERTEX_END : VERTEX_MERGE;
+            if (edges[p] != status.end()) {
+                connect(p, v, true);
+                status.erase(edges[p]);
+                edges[p] = status.end();
+            }
+            if (!convex) {
+                int e = left_of();
+                connect(e, v, true);
+                if (e >= 0) helper[e] = v;
+            }
+        } else if (q_below) {
+            // Going down, the inside is on the right.
+            kind[v] = VERTEX_REGULAR;
+            if (edges[p] != status.end()) {
+                connect(p, v, true);
+                status.erase(edges[p]);
+                edges[p] = status.end();
+            }
+            edges[v] = status.insert(v).first;
+            helper[v] = v;
+        } else {
+            kind[v] = VERTEX_REGULAR;
+            int e = left_of();
+            connect(e, v, true);
+            if (e >= 0) helper[e] = v;
+        }
+    }
+}
+
+static void push_triangle(const double* x, const double* y, int a, int b, int c, std::vector<int>& triangles) {
+
+    double turn = cross(x, y, a, b, c);
+    if (turn == 0.0) return;
+    triangles.push_back(a);
+    triangles.push_back(turn > 0.0 ? b : c);
+    triangles.push_back(turn > 0.0 ? c : b);
+}
+
+// Linear time triangulation of a counter-clockwise piece monotone in y:
+// the two chains are merged top to bottom, and each vertex cuts off what
+// it can see of the vertices still waiting on the stack.
+static void triangulate_piece(const double* x, const double* y, const std::vector<int>& piece,
+                              std::vector<int>& sorted, std::vector<char>& left,
+                              std::vector<int>& stack, std::vector<int>& triangles) {
+
+    int n = static_cast<int>(piece.size());
+    if (n < 3) return;
+    int top = 0;
+    int bottom = 0;
+    for (int i=1; i<n; ++i) {
+        if (above(x, y, piece[i], piece[top])) top = i;
+        if (above(x, y, piece[bottom], piece[i])) bottom = i;
+    }
+
+    // Counter-clockwise, the left chain runs down from the top.
+    sorted.clear();
+    left.clear();
+    sorted.push_back(piece[top]);
+    left.push_back(1);
+    int l = top + 1 == n ? 0 : top + 1;
+    int r = top == 0 ? n - 1 : top - 1;
+    while (l != bottom || r != bottom) {
+        if (r == bottom || (l != bottom && above(x, y, piece[l], piece[r]))) {
+            sorted.push_back(piece[l]);
+            left.push_back(1);
+            l = l + 1 == n ? 0 : l + 1;
+        } else {
+            sorted.push_back(piece[r]);
+            left.push_back(0);
+            r = r == 0 ? n - 1 : r - 1;
+        }
+    }
+    sorted.push_back(piece[bottom]);
+    left.push_back(0);
+
+    stack.clear();
+    stack.push_back(0);
+    stack.push_back(1);
+    for (int j=2; j<n-1; ++j) {
+        int u = sorted[j];
+        if (left[j] != left[stack.back()]) {
+            // Sees the whole stack, across the piece.
+            while (stack.size() > 1) {
+                int t = stack.back();
+                stack.pop_back();
+                push_triangle(x, y, u, sorted[t], sorted[stack.back()], triangles);
+            }
+            stack.clear();
+            stack.push_back(j - 1);
+            stack.push_back(j);
+            continue;
+        }
+        int last = stack.back();
+        stack.pop_back();
+        while (!stack.empty()) {
+            int a = sorted[stack.back()];
+            int b = sorted[last];
+            double turn = left[j] ? cross(x, y, a, b, u) : cross(x, y, u, b, a);
+            if (turn <= 0.0) break;
+            push_triangle(x, y, u, b, a, triangles);
+            last = stack.back();
+            stack.pop_back();
+        }
+        stack.push_back(last);
+        stack.push_back(j);
+    }
+    int u = sorted[n - 1];
+    while (stack.size() > 1) {
+        int t = stack.back();
+        stack.pop_back();
+        push_triangle(x, y, u, sorted[t], sorted[stack.back()], triangles);
+    }
+}
+
+// Angle of the direction from a to b, for ordering edges around a.
+static double direction(const double* x, const double* y, int a, int b) {
+
+    return atan2(y[b] - y[a], x[b] - x[a]);
+}
+
+bool triangulate_monotone(const double* x, const double* y, int n, std::vector<int>& triangles) {
+
+    triangles.clear();
+    if (n < 3) return n == 0;
+
+    double area2 = 0.0;
+    for (int i=0, j=n-1; i<n; j=i++) {
+        area2 += x[j] * y[i] - x[i] * y[j];
+    }
+
+    // Ring in counter-clockwise order, then without vertices lying straight
+    // between their neighbors, repeated ones included.
+    std::vector<int> prev(n);
+    std::vector<int> next(n);
+    for (int i=0; i<n; ++i) {
+        if (area2 >= 0.0) {
+            prev[i] = (i + n - 1) % n;
+            next[i] = (i + 1) % n;
+        } else {
+            prev[i] = (i + 1) % n;
+            next[i] = (i + n - 1) % n;
+        }
+    }
+    std::vector<char> dropped(n, 0);
+    std::vector<int> work(n);
+    for (int i=0; i<n; ++i) {
+        work[i] = n - 1 - i;
+    }
+    int remaining = n;
+    while (!work.empty() && remaining > 2) {
+        int v = work.back();
+        work.pop_back();
+        if (dropped[v] || cross(x, y, prev[v], v, next[v]) != 0.0) continue;
+        dropped[v] = 1;
+        next[prev[v]] = next[v];
+        prev[next[v]] = prev[v];
+        remaining--;
+        work.push_back(next[v]);
+        work.push_back(prev[v]);
+    }
+    if (remaining < 3) return true;
+
+    std::vector<int> original;
+    original.reserve(remaining);
+    int start = 0;
+    while (dropped[start]) start++;
+    int v = start;
+    do {
+        original.push_back(v);
+        v = next[v];
+    } while (v != start);
+
+    int m = remaining;
+    std::vector<double> px(m);
+    std::vector<double> py(m);
+    for (int i=0; i<m; ++i) {
+        px[i] = x[original[i]];
+        py[i] = y[original[i]];
+    }
+
+    std::vector<edge_pair> crossings;
+    find_crossings(px.data(), py.data(), m, crossings);
+    if (!crossings.empty()) {
+        // The partition needs a simple outline, ears cope with the rest.
+        triangulate_ears(x, y, n, triangles);
+        return false;
+    }
+
+    std::vector<int> diagonals;
+    monotone_diagonals(px.data(), py.data(), m, diagonals);
+
+    // Half-edges leaving each vertex, the outline edge and both directions
+    // of every diagonal, sorted by angle where a vertex has more than one.
+    std::vector<int> first(m + 1, 0);
+    for (int i=0; i<m; ++i) {
+        first[i + 1] = 1;
+    }
+    for (size_t k=0; k<diagonals.size(); ++k) {
+        first[diagonals[k] + 1]++;
+    }
+    for (int i=0; i<m; ++i) {
+        first[i + 1] += first[i];
+    }
+    int half_edges = first[m];
+    std::vector<int> target(half_edges);
+    std::vector<double> angle(half_edges);
+    std::vector<int> fill(first.begin(), first.end() - 1);
+    for (int i=0; i<m; ++i) {
+        target[fill[i]++] = i + 1 == m ? 0 : i + 1;
+    }
+    for (size_t k=0; k<diagonals.size(); k+=2) {
+        target[fill[diagonals[k]]++] = diagonals[k + 1];
+        target[fill[diagonals[k + 1]]++] = diagonals[k];
+    }
+    std::vector<std::pair<double, int> > around;
+    for (int i=0; i<m; ++i) {
+        if (first[i + 1] - first[i] < 2) continue;
+        around.clear();
+        for (int h=first[i]; h<first[i + 1]; ++h) {
+            around.push_back(std::make_pair(direction(px.data(), py.data(), i, target[h]), target[h]));
+        }
+        std::sort(around.begin(), around.end());
+        for (int h=first[i]; h<first[i + 1]; ++h) {
+            angle[h] = around[h - first[i]].first;
+            target[h] = around[h - first[i]].second;
+        }
+    }
+
+    // Each piece lies left of its half-edges. Arriving at a vertex, the
+    // piece goes on along the first half-edge clockwise from the way back.
+    std::vector<char> used(half_edges, 0);
+    std::vector<int> piece;
+    std::vector<int> sorted;
+    std::vector<char> left;
+    std::vector<int> stack;
+    std::vector<int> local;
+    for (int s=0; s<half_edges; ++s) {
+        if (used[s]) continue;
+        piece.clear();
+        int from = static_cast<int>(std::upper_bound(first.begin(), first.end(), s) - first.begin()) - 1;
+        int h = s;
+        for (int steps=0; steps<half_edges; ++steps) {
+            used[h] = 1;
+            piece.push_back(from);
+            int to = target[h];
+            int count = first[to + 1] - first[to];
+            int next_h = first[to];
+            if (count > 1) {
+                double back = direction(px.data(), py.data(), to, from);
+                int k = static_cast<int>(std::lower_bound(angle.begin() + first[to], angle.begin() + first[to + 1], back)
+                                         - angle.begin());
+                next_h = k == first[to] ? first[to + 1] - 1 : k - 1;
+            }
+            from = to;
+            h = next_h;
+            if (h == s) break;
+        }
+        local.clear();
+        triangulate_piece(px.data(), py.data(), piece, sorted, left, stack, local);
+        for (size_t k=0; k<local.size(); ++k) {
+            triangles.push_back(original[local[k]]);
+        }
+    }
+    return true;
+}
+
+shape_triangles::entry& shape_triangles::slot(const shape_store& store, int shape) {
+
+    if (static_cast<int>(entries_.size()) < store.shape_count()) {
+        entries_.resize(store.shape_count());
+    }
+    entry& e = entries_[shape];
+    if (e.version != store.version(shape)) {
+        e.version = store.version(shape);
+        e.valid = false;
+    }
+    if (!e.valid) {
+        e.simple = triangulate_monotone(store.xs(shape), store.ys(shape), store.size(shape), e.triangles);
+        e.valid = true;
+    }
+    return e;
+}
+
+const std::vector<int>& shape_triangles::triangles(const shape_store& store, int shape) {
+
+    return slot(store, shape).triangles;
+}
+
+bool shape_triangles::simple(const shape_store& store, int shape) {
+
+    return slot(store, shape).simple;
+}
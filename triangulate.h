@@ -0,0 +1,45 @@
+#ifndef TRIANGULATE_H_
+#define TRIANGULATE_H_
+
+#include <vector>
+
+#include "shape_store.h"
+
+// Ear clipping triangulation of a closed outline with n vertices, in either
+// winding. Fills triangles with vertex index triples, each counter-clockwise.
+// Vertices lying straight between their neighbors are dropped rather than
+// turned into zero-area triangles.
+//
+// Returns false if the outline is not simple; ears are then forced so the
+// result still covers every vertex, but triangles may overlap.
+bool triangulate_ears(const double* x, const double* y, int n, std::vector<int>& triangles);
+
+// Same result in O(n log n): a sweep adds diagonals splitting the outline
+// into pieces monotone in y, and each piece is triangulated in linear time.
+// The outline is checked for crossings first; one that is not simple goes
+// to triangulate_ears() instead.
+bool triangulate_monotone(const double* x, const double* y, int n, std::vector<int>& triangles);
+
+// Triangles of every shape, recomputed when its version changed. Indices
+// are into the committed outline, so they hold under a pending transform.
+struct shape_triangles {
+    const std::vector<int>& triangles(const shape_store& store, int shape);
+    // Whether the outline was simple when last triangulated.
+    bool simple(const shape_store& store, int shape);
+
+private:
+    struct entry {
+        entry() : version(0), valid(false), simple(true) {}
+
+        unsigned version;
+        bool valid;
+        bool simple;
+        std::vector<int> triangles;
+    };
+
+    entry& slot(const shape_store& store, int shape);
+
+    std::vector<entry> entries_;
+};
+
+#endif // TRIANGULATE_H_
@@ -0,0 +1,72 @@
+#include <math.h>
+
+#include <algorithm>
+
+#include "viewport.h"
+
+viewport::viewport(int width, int height, double pixel_size)
+: pixel_size_(pixel_size)
+, width_(width)
+, height_(height)
+{
+    center_.x = 0.0;
+    center_.y = 0.0;
+}
+
+void viewport::resize(int width, int height) {
+
+    width_ = std::max(width, 1);
+    height_ = std::max(height, 1);
+}
+
+void viewport::pan(int dx, int dy) {
+
+    center_.x -= dx * pixel_size_;
+    center_.y += dy * pixel_size_;
+}
+
+void viewport::zoom_at(int x, int y, double factor) {
+
+    grid_point p = to_grid(x, y);
+    pixel_size_ = std::min(std::max(pixel_size_ / factor, VIEW_MIN_PIXEL_SIZE), VIEW_MAX_PIXEL_SIZE);
+
+    // Move the center so p is under x, y again.
+    grid_point q = to_grid(x, y);
+    center_.x += p.x - q.x;
+    center_.y += p.y - q.y;
+}
+
+void viewport::reset(double pixel_size) {
+
+    center_.x = 0.0;
+    center_.y = 0.0;
+    pixel_size_ = pixel_size;
+}
+
+grid_point viewport::to_grid(int x, int y) const {
+
+    grid_point p;
+    p.x = center_.x + (x - 0.5 * width_) * pixel_size_;
+    p.y = center_.y - (y - 0.5 * height_) * pixel_size_;
+    return p;
+}
+
+grid_box viewport::visible() const {
+
+    grid_box b;
+    b.min.x = center_.x - 0.5 * width_ * pixel_size_;
+    b.max.x = center_.x + 0.5 * width_ * pixel_size_;
+    b.min.y = center_.y - 0.5 * height_ * pixel_size_;
+    b.max.y = center_.y + 0.5 * height_ * pixel_size_;
+    return b;
+}
+
+double grid_spacing(double pixel_size, double min_pixels) {
+
+    double least = pixel_size * min_pixels;
+    double decade = pow(10.0, floor(log10(least)));
+    if (decade >= least) return decade;
+    if (2.0 * decade >= least) return 2.0 * decade;
+    if (5.0 * decade >= least) return 5.0 * decade;
+    return 10.0 * decade;
+}
@@ -0,0 +1,42 @@
+#ifndef VIEWPORT_H_
+#define VIEWPORT_H_
+
+#include "geometry.h"
+
+// Zoom limits in grid units per pixel. Vertex buffers hold floats, below
+// VIEW_MIN_PIXEL_SIZE neighboring pixels would round to the same vertex.
+#define VIEW_MIN_PIXEL_SIZE 1e-5
+#define VIEW_MAX_PIXEL_SIZE 1e4
+
+// The part of the unbounded grid the window shows: a center and a scale,
+// with y up on the grid and down in window pixels.
+struct viewport {
+    viewport(int width, int height, double pixel_size);
+
+    void resize(int width, int height);
+    // Follows the mouse dragging the grid by dx, dy pixels.
+    void pan(int dx, int dy);
+    // Scales the view by factor around pixel x, y, which keeps showing the
+    // same grid point.
+    void zoom_at(int x, int y, double factor);
+    void reset(double pixel_size);
+
+    grid_point to_grid(int x, int y) const;
+    grid_box visible() const;
+    double pixel_size() const { return pixel_size_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+private:
+    grid_point center_;
+    double pixel_size_;
+    int width_;
+    int height_;
+};
+
+// Distance of neighboring grid lines: 1, 2 or 5 times a power of ten, the
+// smallest that keeps lines at least min_pixels apart. At any zoom a
+// window then crosses at most its size over min_pixels lines per axis.
+double grid_spacing(double pixel_size, double min_pixels);
+
+#endif // VIEWPORT_H_